@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "bluetooth_ble.hpp"
+#include "bluetooth_event_queue.hpp"
 #include "../btdrv_mitm_flags.hpp"
 #include <mutex>
 #include <cstring>
@@ -22,16 +23,22 @@ namespace ams::bluetooth::ble {
 
     namespace {
 
-        os::Mutex g_event_data_lock(false);
-        bluetooth::BleEventInfo g_event_info;
-        bluetooth::BleEventType g_current_event_type;
+        constexpr size_t EventQueueSize = 8;
+
+        bluetooth::EventQueue<bluetooth::BleEventType, bluetooth::BleEventInfo, EventQueueSize> g_event_queue;
 
         os::SystemEvent g_system_event;
         os::SystemEvent g_system_event_fwd(os::EventClearMode_AutoClear, true);
         os::SystemEvent g_system_event_user_fwd(os::EventClearMode_AutoClear, true);
 
         os::Event g_init_event(os::EventClearMode_ManualClear);
-        os::Event g_data_read_event(os::EventClearMode_AutoClear);
+
+        void SignalUserForwardEvent(void) {
+            if (g_system_event_user_fwd.GetBase()->state) {
+                g_system_event_user_fwd.Signal();
+            }
+        }
+
     }
 
     bool IsInitialized() {
@@ -58,31 +65,46 @@ namespace ams::bluetooth::ble {
         return &g_system_event_user_fwd;
     }
 
-    Result GetEventInfo(bluetooth::BleEventType *type, void *buffer, size_t size) {
-        std::scoped_lock lk(g_event_data_lock); 
+    void GetEventQueueStatistics(bluetooth::EventQueueStatistics *stats) {
+        g_event_queue.GetStatistics(stats);
+    }
 
-        *type = g_current_event_type;
-        std::memcpy(buffer, &g_event_info, size);
+    Result GetEventInfo(ncm::ProgramId program_id, bluetooth::BleEventType *type, void *buffer, size_t size) {
+        // Events are consumed by btm, or by the user client while they're redirected. The other gets a copy of the last event consumed.
+        bool is_system = program_id == ncm::SystemProgramId::Btm;
+        if (is_system != g_redirect_ble_events) {
+            size_t pending;
+            if (g_event_queue.Pop(type, buffer, size, &pending)) {
+                if (!g_redirect_ble_events)
+                    SignalUserForwardEvent();
+
+                // The forward events are auto-clear, so a burst of events only wakes the consumer once. Wake it again until the queue is drained.
+                if (pending > 0) {
+                    if (!g_redirect_ble_events)
+                        g_system_event_fwd.Signal();
+                    else
+                        SignalUserForwardEvent();
+                }
+            }
+        }
+        else {
+            g_event_queue.PeekLast(type, buffer, size);
+        }
 
-        g_data_read_event.Signal();
-        
         return ams::ResultSuccess();
     }
 
     void HandleEvent(void) {
-        {
-            std::scoped_lock lk(g_event_data_lock); 
-            R_ABORT_UNLESS(btdrvGetBleManagedEventInfo(&g_event_info, sizeof(bluetooth::BleEventInfo), &g_current_event_type));
-        }
+        bluetooth::BleEventInfo event_info;
+        bluetooth::BleEventType event_type;
+        R_ABORT_UNLESS(btdrvGetBleManagedEventInfo(&event_info, sizeof(bluetooth::BleEventInfo), &event_type));
 
-        if (!g_redirect_ble_events) {
-            g_system_event_fwd.Signal();
-            g_data_read_event.Wait();
-        }
+        g_event_queue.Push(event_type, &event_info, sizeof(event_info));
 
-        if (g_system_event_user_fwd.GetBase()->state) {
-            g_system_event_user_fwd.Signal();
-        }
+        if (!g_redirect_ble_events)
+            g_system_event_fwd.Signal();
+        else
+            SignalUserForwardEvent();
     }
 
 }
@@ -17,6 +17,7 @@
 #include <switch.h>
 #include <stratosphere.hpp>
 #include "bluetooth_types.hpp"
+#include "bluetooth_event_queue.hpp"
 
 namespace ams::bluetooth::ble {
 
@@ -27,8 +28,9 @@ namespace ams::bluetooth::ble {
     os::SystemEvent *GetSystemEvent(void);
     os::SystemEvent *GetForwardEvent(void);
     os::SystemEvent *GetUserForwardEvent(void);
+    void GetEventQueueStatistics(bluetooth::EventQueueStatistics *stats);
 
-    Result GetEventInfo(bluetooth::BleEventType *type, void *buffer, size_t size);
+    Result GetEventInfo(ncm::ProgramId program_id, bluetooth::BleEventType *type, void *buffer, size_t size);
     void HandleEvent(void);
     
 }
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "bluetooth_core.hpp"
+#include "bluetooth_event_queue.hpp"
 #include "../btdrv_mitm_flags.hpp"
 #include "../../controllers/controller_management.hpp"
 #include <mutex>
@@ -23,9 +24,9 @@ namespace ams::bluetooth::core {
 
     namespace {
 
-        os::Mutex g_event_info_lock(false);
-        bluetooth::EventInfo g_event_info;
-        bluetooth::EventType g_current_event_type;
+        constexpr size_t EventQueueSize = 8;
+
+        bluetooth::EventQueue<bluetooth::EventType, bluetooth::EventInfo, EventQueueSize> g_event_queue;
 
         os::SystemEvent g_system_event;
         os::SystemEvent g_system_event_fwd(os::EventClearMode_AutoClear, true);
@@ -33,13 +34,18 @@ namespace ams::bluetooth::core {
 
         os::Event g_init_event(os::EventClearMode_ManualClear);
         os::Event g_enable_event(os::EventClearMode_ManualClear);
-        os::Event g_data_read_event(os::EventClearMode_AutoClear);
 
         bluetooth::Address ReverseBluetoothAddress(bluetooth::Address address) {
             uint64_t tmp = util::SwapBytes48(*reinterpret_cast<uint64_t *>(&address));
             return *reinterpret_cast<bluetooth::Address *>(&tmp);
         }
 
+        void SignalUserForwardEvent(void) {
+            if (g_system_event_user_fwd.GetBase()->state) {
+                g_system_event_user_fwd.Signal();
+            }
+        }
+
     }
 
     bool IsInitialized() {
@@ -74,11 +80,16 @@ namespace ams::bluetooth::core {
         return &g_system_event_user_fwd;
     }
 
-    void SignalFakeEvent(bluetooth::EventType type, const void *data, size_t size) {
-        g_current_event_type = type;
-        std::memcpy(&g_event_info, data, size);
+    void GetEventQueueStatistics(bluetooth::EventQueueStatistics *stats) {
+        g_event_queue.GetStatistics(stats);
+    }
+
+    bool SignalFakeEvent(bluetooth::EventType type, const void *data, size_t size) {
+        if (!g_event_queue.Push(type, data, size))
+            return false;
 
         g_system_event_fwd.Signal();
+        return true;
     }
 
     inline void ModifyEventInfov1(bluetooth::EventInfo *event_info, BtdrvEventType event_type) {
@@ -126,22 +137,36 @@ namespace ams::bluetooth::core {
     }
 
     Result GetEventInfo(ncm::ProgramId program_id, bluetooth::EventType *type, void *buffer, size_t size) {
-        std::scoped_lock lk(g_event_info_lock);
-
-        *type = g_current_event_type;
-        std::memcpy(buffer, &g_event_info, size);
+        // Events are consumed by btm, or by the user client while they're redirected. The other gets a copy of the last event consumed.
+        bool is_system = program_id == ncm::SystemProgramId::Btm;
+        if (is_system != g_redirect_core_events) {
+            size_t pending;
+            if (g_event_queue.Pop(type, buffer, size, &pending)) {
+                if (!g_redirect_core_events)
+                    SignalUserForwardEvent();
+
+                // The forward events are auto-clear, so a burst of events only wakes the consumer once. Wake it again until the queue is drained.
+                if (pending > 0) {
+                    if (!g_redirect_core_events)
+                        g_system_event_fwd.Signal();
+                    else
+                        SignalUserForwardEvent();
+                }
+            }
+        }
+        else {
+            g_event_queue.PeekLast(type, buffer, size);
+        }
 
-        if (program_id == ncm::SystemProgramId::Btm) {
+        if (is_system) {
             auto event_info = reinterpret_cast<bluetooth::EventInfo *>(buffer);
 
             if (hos::GetVersion() < hos::Version_12_0_0)
-                ModifyEventInfov1(event_info, g_current_event_type);
+                ModifyEventInfov1(event_info, *type);
             else
-                ModifyEventInfov12(event_info, g_current_event_type);
+                ModifyEventInfov12(event_info, *type);
         }
 
-        g_data_read_event.Signal();
-
         return ams::ResultSuccess();
     }
 
@@ -185,26 +210,25 @@ namespace ams::bluetooth::core {
     }
 
     void HandleEvent(void) {
-        {
-            std::scoped_lock lk(g_event_info_lock);
-            R_ABORT_UNLESS(btdrvGetEventInfo(&g_event_info, sizeof(bluetooth::EventInfo), &g_current_event_type));
-        }
+        bluetooth::EventInfo event_info;
+        bluetooth::EventType event_type;
+        R_ABORT_UNLESS(btdrvGetEventInfo(&event_info, sizeof(bluetooth::EventInfo), &event_type));
 
         if (!g_redirect_core_events) {
-            if ((hos::GetVersion() < hos::Version_12_0_0) && (g_current_event_type == BtdrvEventTypeOld_PairingPinCodeRequest)) {
-                HandlePinCodeRequestEventV1(&g_event_info);
+            if ((hos::GetVersion() < hos::Version_12_0_0) && (event_type == BtdrvEventTypeOld_PairingPinCodeRequest)) {
+                HandlePinCodeRequestEventV1(&event_info);
             }
-            else if ((hos::GetVersion() >= hos::Version_12_0_0) && (g_current_event_type == BtdrvEventType_PairingPinCodeRequest)) {
-                HandlePinCodeRequestEventV12(&g_event_info);
+            else if ((hos::GetVersion() >= hos::Version_12_0_0) && (event_type == BtdrvEventType_PairingPinCodeRequest)) {
+                HandlePinCodeRequestEventV12(&event_info);
             }
             else {
+                g_event_queue.Push(event_type, &event_info, sizeof(event_info));
                 g_system_event_fwd.Signal();
-                g_data_read_event.Wait();
             }
         }
-
-        if (g_system_event_user_fwd.GetBase()->state) {
-            g_system_event_user_fwd.Signal();
+        else {
+            g_event_queue.Push(event_type, &event_info, sizeof(event_info));
+            SignalUserForwardEvent();
         }
     }
 
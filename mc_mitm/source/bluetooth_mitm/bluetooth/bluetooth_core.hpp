@@ -17,6 +17,7 @@
 #include <switch.h>
 #include <stratosphere.hpp>
 #include "bluetooth_types.hpp"
+#include "bluetooth_event_queue.hpp"
 
 namespace ams::bluetooth::core {
 
@@ -29,8 +30,9 @@ namespace ams::bluetooth::core {
     os::SystemEvent *GetSystemEvent(void);
     os::SystemEvent *GetForwardEvent(void);
     os::SystemEvent *GetUserForwardEvent(void);
+    void GetEventQueueStatistics(bluetooth::EventQueueStatistics *stats);
 
-    void SignalFakeEvent(bluetooth::EventType type, const void *data, size_t size);
+    bool SignalFakeEvent(bluetooth::EventType type, const void *data, size_t size);
     Result GetEventInfo(ncm::ProgramId program_id, bluetooth::EventType *type, void *buffer, size_t size);
     void HandleEvent(void);
    
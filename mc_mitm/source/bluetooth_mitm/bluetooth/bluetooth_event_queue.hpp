@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+#include "../../mcmitm_trace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace ams::bluetooth {
+
+    struct EventQueueStatistics {
+        uint32_t capacity;
+        uint32_t depth;
+        uint32_t depth_max;
+        uint32_t pushed;
+        uint32_t popped;
+        uint32_t overflowed;
+    };
+
+    // Bounded FIFO of events copied out of the system, so that the thread handling them never has to wait on the consumer.
+    // The most recently dequeued event stays readable, for clients that read an event after it has already been taken.
+    template<typename EventTypeT, typename EventInfoT, size_t Capacity>
+    class EventQueue {
+
+        public:
+            EventQueue(void) : m_lock(false), m_head(0), m_count(0), m_last(), m_statistics{Capacity} { }
+
+            // Events arriving while the queue is full are dropped and counted, rather than holding up the producer
+            bool Push(EventTypeT type, const void *data, size_t size) {
+                std::scoped_lock lk(m_lock);
+
+                if (m_count == Capacity) {
+                    mitm::trace::Record(mitm::trace::TraceEvent_EventQueueOverflow, type, Capacity);
+                    m_statistics.overflowed++;
+                    return false;
+                }
+
+                auto entry = &m_entries[(m_head + m_count) % Capacity];
+                entry->type = type;
+                std::memcpy(&entry->info, data, std::min(size, sizeof(EventInfoT)));
+                if (size < sizeof(EventInfoT))
+                    std::memset(reinterpret_cast<uint8_t *>(&entry->info) + size, 0, sizeof(EventInfoT) - size);
+
+                ++m_count;
+
+                m_statistics.pushed++;
+                m_statistics.depth = m_count;
+                m_statistics.depth_max = std::max<uint32_t>(m_statistics.depth_max, m_count);
+
+                return true;
+            }
+
+            // Take the oldest pending event. Falls back to the last one taken if there's nothing pending.
+            // The number of events still pending is returned through pending, so the consumer can be woken again for them.
+            bool Pop(EventTypeT *type, void *buffer, size_t size, size_t *pending) {
+                std::scoped_lock lk(m_lock);
+
+                bool popped = m_count > 0;
+                if (popped) {
+                    m_last = m_entries[m_head];
+                    m_head = (m_head + 1) % Capacity;
+                    --m_count;
+
+                    m_statistics.popped++;
+                    m_statistics.depth = m_count;
+                }
+
+                this->CopyLast(type, buffer, size);
+                *pending = m_count;
+
+                return popped;
+            }
+
+            void PeekLast(EventTypeT *type, void *buffer, size_t size) {
+                std::scoped_lock lk(m_lock);
+                this->CopyLast(type, buffer, size);
+            }
+
+            void GetStatistics(EventQueueStatistics *stats) {
+                std::scoped_lock lk(m_lock);
+                *stats = m_statistics;
+            }
+
+        private:
+            void CopyLast(EventTypeT *type, void *buffer, size_t size) {
+                *type = m_last.type;
+                std::memcpy(buffer, &m_last.info, std::min(size, sizeof(EventInfoT)));
+            }
+
+            struct Entry {
+                EventTypeT type;
+                EventInfoT info;
+            };
+
+            os::Mutex m_lock;
+            Entry m_entries[Capacity];
+            size_t m_head;
+            size_t m_count;
+            Entry m_last;
+
+            EventQueueStatistics m_statistics;
+    };
+
+}
@@ -18,6 +18,7 @@
 #include "bluetooth_core.hpp"
 #include "bluetooth_hid.hpp"
 #include "bluetooth_ble.hpp"
+#include "../../mcmitm_thread_stack.hpp"
 
 namespace ams::bluetooth::events {
 
@@ -75,6 +76,7 @@ namespace ams::bluetooth::events {
     }
 
     Result Initialize(void) {
+        ams::mitm::PaintThreadStack("bt_events", g_event_handler_thread_stack, sizeof(g_event_handler_thread_stack));
         R_TRY(os::CreateThread(&g_event_handler_thread,
             EventHandlerThreadFunc,
             nullptr,
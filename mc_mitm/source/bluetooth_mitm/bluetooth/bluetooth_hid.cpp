@@ -14,8 +14,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "bluetooth_hid.hpp"
+#include "bluetooth_event_queue.hpp"
 #include "../btdrv_mitm_flags.hpp"
 #include "../../controllers/controller_management.hpp"
+#include "../../mcmitm_trace.hpp"
 #include <mutex>
 #include <cstring>
 
@@ -23,16 +25,22 @@ namespace ams::bluetooth::hid {
 
     namespace {
 
-        os::Mutex g_event_info_lock(false);
-        bluetooth::HidEventInfo g_event_info;
-        bluetooth::HidEventType g_current_event_type;
+        // Enough for every controller reconnecting at once after the console wakes
+        constexpr size_t EventQueueSize = 16;
+
+        bluetooth::EventQueue<bluetooth::HidEventType, bluetooth::HidEventInfo, EventQueueSize> g_event_queue;
 
         os::SystemEvent g_system_event;
         os::SystemEvent g_system_event_fwd(os::EventClearMode_AutoClear, true);
         os::SystemEvent g_system_event_user_fwd(os::EventClearMode_AutoClear, true);
 
         os::Event g_init_event(os::EventClearMode_ManualClear);
-        os::Event g_data_read_event(os::EventClearMode_AutoClear);
+
+        void SignalUserForwardEvent(void) {
+            if (g_system_event_user_fwd.GetBase()->state) {
+                g_system_event_user_fwd.Signal();
+            }
+        }
 
     }
 
@@ -60,20 +68,33 @@ namespace ams::bluetooth::hid {
         return &g_system_event_user_fwd;
     }
 
-    void SignalFakeEvent(bluetooth::HidEventType type, const void *data, size_t size) {
-        g_current_event_type = type;
-        std::memcpy(&g_event_info, data, size);
-
-        g_system_event_fwd.Signal();
+    void GetEventQueueStatistics(bluetooth::EventQueueStatistics *stats) {
+        g_event_queue.GetStatistics(stats);
     }
 
-    Result GetEventInfo(bluetooth::HidEventType *type, void *buffer, size_t size) {
-        std::scoped_lock lk(g_event_info_lock);
+    bool SignalFakeEvent(bluetooth::HidEventType type, const void *data, size_t size) {
+        if (!g_event_queue.Push(type, data, size))
+            return false;
 
-        *type = g_current_event_type;
-        std::memcpy(buffer, &g_event_info, size);
+        g_system_event_fwd.Signal();
+        return true;
+    }
 
-        g_data_read_event.Signal();
+    Result GetEventInfo(ncm::ProgramId program_id, bluetooth::HidEventType *type, void *buffer, size_t size) {
+        // Events are consumed by hid. Other clients get a copy of the last event consumed once it has been.
+        if (program_id == ncm::SystemProgramId::Hid) {
+            size_t pending;
+            if (g_event_queue.Pop(type, buffer, size, &pending)) {
+                SignalUserForwardEvent();
+
+                // The forward event is auto-clear, so a burst of events only wakes hid once. Wake it again until the queue is drained.
+                if (pending > 0)
+                    g_system_event_fwd.Signal();
+            }
+        }
+        else {
+            g_event_queue.PeekLast(type, buffer, size);
+        }
 
         return ams::ResultSuccess();
     }
@@ -81,9 +102,11 @@ namespace ams::bluetooth::hid {
     inline void HandleConnectionStateEventV1(bluetooth::HidEventInfo *event_info) {
         switch (event_info->connection.v1.status) {
             case BtdrvHidConnectionStatusOld_Opened:
+                mitm::trace::RecordAddress(mitm::trace::TraceEvent_HidConnectionOpened, event_info->connection.v1.addr.address);
                 controller::AttachHandler(&event_info->connection.v1.addr);
                 break;
             case BtdrvHidConnectionStatusOld_Closed:
+                mitm::trace::RecordAddress(mitm::trace::TraceEvent_HidConnectionClosed, event_info->connection.v1.addr.address);
                 controller::RemoveHandler(&event_info->connection.v1.addr);
                 break;
             default:
@@ -94,9 +117,11 @@ namespace ams::bluetooth::hid {
     inline void HandleConnectionStateEventV12(bluetooth::HidEventInfo *event_info) {
         switch (event_info->connection.v12.status) {
             case BtdrvHidConnectionStatus_Opened:
+                mitm::trace::RecordAddress(mitm::trace::TraceEvent_HidConnectionOpened, event_info->connection.v12.addr.address);
                 controller::AttachHandler(&event_info->connection.v12.addr);
                 break;
             case BtdrvHidConnectionStatus_Closed:
+                mitm::trace::RecordAddress(mitm::trace::TraceEvent_HidConnectionClosed, event_info->connection.v12.addr.address);
                 controller::RemoveHandler(&event_info->connection.v12.addr);
                 break;
             default:
@@ -105,25 +130,20 @@ namespace ams::bluetooth::hid {
     }
 
     void HandleEvent(void) {
-        {
-            std::scoped_lock lk(g_event_info_lock);
-            R_ABORT_UNLESS(btdrvGetHidEventInfo(&g_event_info, sizeof(bluetooth::HidEventInfo), &g_current_event_type));
-        }
+        bluetooth::HidEventInfo event_info;
+        bluetooth::HidEventType event_type;
+        R_ABORT_UNLESS(btdrvGetHidEventInfo(&event_info, sizeof(bluetooth::HidEventInfo), &event_type));
 
-        switch (g_current_event_type) {
+        switch (event_type) {
             case BtdrvHidEventType_Connection:
-                hos::GetVersion() < hos::Version_12_0_0 ? HandleConnectionStateEventV1(&g_event_info) : HandleConnectionStateEventV12(&g_event_info);
+                hos::GetVersion() < hos::Version_12_0_0 ? HandleConnectionStateEventV1(&event_info) : HandleConnectionStateEventV12(&event_info);
                 break;
             default:
                 break;
         }
 
+        g_event_queue.Push(event_type, &event_info, sizeof(event_info));
         g_system_event_fwd.Signal();
-        g_data_read_event.Wait();
-
-        if (g_system_event_user_fwd.GetBase()->state) {
-            g_system_event_user_fwd.Signal();
-        }
     }
 
 }
@@ -17,6 +17,7 @@
 #include <switch.h>
 #include <stratosphere.hpp>
 #include "bluetooth_types.hpp"
+#include "bluetooth_event_queue.hpp"
 
 namespace ams::bluetooth::hid {
 
@@ -27,9 +28,10 @@ namespace ams::bluetooth::hid {
     os::SystemEvent *GetSystemEvent(void);
     os::SystemEvent *GetForwardEvent(void);
     os::SystemEvent *GetUserForwardEvent(void);
+    void GetEventQueueStatistics(bluetooth::EventQueueStatistics *stats);
 
-    void SignalFakeEvent(bluetooth::HidEventType type, const void *data, size_t size);
-    Result GetEventInfo(bluetooth::HidEventType *type, void *buffer, size_t size);
+    bool SignalFakeEvent(bluetooth::HidEventType type, const void *data, size_t size);
+    Result GetEventInfo(ncm::ProgramId program_id, bluetooth::HidEventType *type, void *buffer, size_t size);
     void HandleEvent(void);
 
 }
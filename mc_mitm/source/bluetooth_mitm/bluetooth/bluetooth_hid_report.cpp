@@ -15,10 +15,15 @@
  */
 #include "bluetooth_hid_report.hpp"
 #include "bluetooth_circular_buffer.hpp"
+#include "bluetooth_report_ring.hpp"
 #include "../btdrv_shim.h"
 #include "../btdrv_mitm_flags.hpp"
 #include "../../utils.hpp"
+#include "../../mcmitm_config.hpp"
+#include "../../mcmitm_thread_stack.hpp"
+#include "../../mcmitm_trace.hpp"
 #include "../../controllers/controller_management.hpp"
+#include <algorithm>
 #include <mutex>
 #include <cstring>
 
@@ -43,12 +48,17 @@ namespace ams::bluetooth::hid::report {
         os::Event g_init_event(os::EventClearMode_ManualClear);
         os::Event g_report_read_event(os::EventClearMode_AutoClear);
 
+        os::SdkMutex g_redirect_statistics_lock;
+        RedirectStatistics g_redirect_statistics;
+
         os::SharedMemory g_real_bt_shmem;
         os::SharedMemory g_fake_bt_shmem(bluetooth_sharedmem_size, os::MemoryPermission_ReadWrite, os::MemoryPermission_ReadWrite);
 
         bluetooth::CircularBuffer *g_real_buffer;
         bluetooth::CircularBuffer *g_fake_buffer;
 
+        // Fake reports are written from both the report handler and the threads answering subcommands
+        os::Mutex g_fake_report_lock(false);
         bluetooth::HidReportEventInfo g_fake_report_event_info;
 
         Service *g_forward_service;
@@ -61,6 +71,99 @@ namespace ams::bluetooth::hid::report {
             }
         }
 
+        // Where the address and report of a data event sit in HidReportEventInfo, and the event type they arrive under
+        struct ReportLayoutV7 {
+            static constexpr bluetooth::HidEventType DataEventType = BtdrvHidEventTypeOld_Data;
+
+            static bluetooth::Address *Address(bluetooth::HidReportEventInfo *event_info) { return &event_info->data_report.v7.addr; }
+            static bluetooth::HidReport *Report(bluetooth::HidReportEventInfo *event_info) { return reinterpret_cast<bluetooth::HidReport *>(&event_info->data_report.v7.report); }
+        };
+
+        struct ReportLayoutV9 {
+            static constexpr bluetooth::HidEventType DataEventType = BtdrvHidEventTypeOld_Data;
+
+            static bluetooth::Address *Address(bluetooth::HidReportEventInfo *event_info) { return &event_info->data_report.v9.addr; }
+            static bluetooth::HidReport *Report(bluetooth::HidReportEventInfo *event_info) { return &event_info->data_report.v9.report; }
+        };
+
+        struct ReportLayoutV12 : public ReportLayoutV9 {
+            static constexpr bluetooth::HidEventType DataEventType = BtdrvHidEventType_Data;
+        };
+
+        void HandleHidReportEventV1(void) {
+            R_ABORT_UNLESS(btdrvGetHidReportEventInfo(&g_event_info, sizeof(bluetooth::HidReportEventInfo), &g_current_event_type));
+
+            switch (g_current_event_type) {
+                case BtdrvHidEventTypeOld_Data:
+                    {
+                        report_ring::Publish(report_ring::ReportRingEntryType_Raw, &g_event_info.data_report.v1.addr, reinterpret_cast<bluetooth::HidReport *>(&g_event_info.data_report.v1.report));
+
+                        auto device = controller::LocateHandler(&g_event_info.data_report.v1.addr);
+                        if (!device)
+                            return;
+
+                        device->HandleIncomingReport(reinterpret_cast<bluetooth::HidReport *>(&g_event_info.data_report.v1.report));
+                    }
+                    break;
+                default:
+                    g_fake_buffer->Write(g_current_event_type, &g_event_info.data_report.v1.report.data, g_event_info.data_report.v1.report.size);
+                    break;
+            }
+        }
+
+        template <typename Layout>
+        void HandleHidReportEvent(void) {
+            while (true) {
+                auto real_packet = g_real_buffer->Read();
+                if (!real_packet)
+                    break;
+
+                g_real_buffer->Free();
+
+                switch (real_packet->header.type) {
+                    case 0xff:
+                        continue;
+                    case Layout::DataEventType:
+                        {
+                            auto address = Layout::Address(&real_packet->data);
+                            auto report = Layout::Report(&real_packet->data);
+                            report_ring::Publish(report_ring::ReportRingEntryType_Raw, address, report);
+
+                            auto device = controller::LocateHandler(address);
+                            if (!device)
+                                continue;
+
+                            device->HandleIncomingReport(report);
+                        }
+                        break;
+                    default:
+                        g_fake_buffer->Write(real_packet->header.type, &real_packet->data, real_packet->header.size);
+                        break;
+                }
+            }
+        }
+
+        template <typename Layout>
+        void WriteFakeReport(const bluetooth::Address *address, const bluetooth::HidReport *report) {
+            *Layout::Address(&g_fake_report_event_info) = *address;
+            std::memcpy(Layout::Report(&g_fake_report_event_info), report, report->size + sizeof(report->size));
+
+            g_fake_buffer->Write(Layout::DataEventType, &g_fake_report_event_info, report->size + 0x11);
+        }
+
+        // The firmware dependent parts of the report path, so that the version only needs checking once
+        struct ReportHandlers {
+            void (*handle_event)(void);
+            void (*write_fake_report)(const bluetooth::Address *address, const bluetooth::HidReport *report);
+        };
+
+        constexpr ReportHandlers report_handlers_v1  = { HandleHidReportEventV1,               WriteFakeReport<ReportLayoutV7>  };
+        constexpr ReportHandlers report_handlers_v7  = { HandleHidReportEvent<ReportLayoutV7>,  WriteFakeReport<ReportLayoutV7>  };
+        constexpr ReportHandlers report_handlers_v9  = { HandleHidReportEvent<ReportLayoutV9>,  WriteFakeReport<ReportLayoutV9>  };
+        constexpr ReportHandlers report_handlers_v12 = { HandleHidReportEvent<ReportLayoutV12>, WriteFakeReport<ReportLayoutV12> };
+
+        const ReportHandlers *g_report_handlers = &report_handlers_v1;
+
     }
 
     bool IsInitialized() {
@@ -75,6 +178,11 @@ namespace ams::bluetooth::hid::report {
         g_report_read_event.Signal();
     }
 
+    void GetRedirectStatistics(RedirectStatistics *stats) {
+        std::scoped_lock lk(g_redirect_statistics_lock);
+        *stats = g_redirect_statistics;
+    }
+
     os::SharedMemory *GetRealSharedMemory(void) {
         if (hos::GetVersion() < hos::Version_7_0_0)
             return nullptr;
@@ -101,6 +209,8 @@ namespace ams::bluetooth::hid::report {
     Result Initialize(os::NativeHandle event_handle, Service *forward_service, os::ThreadId main_thread_id) {
         g_system_event.AttachReadableHandle(event_handle, false, os::EventClearMode_AutoClear);
 
+        ams::mitm::PaintThreadStack("hid_report", g_event_handler_thread_stack, sizeof(g_event_handler_thread_stack));
+
         R_TRY(os::CreateThread(&g_event_handler_thread,
             EventThreadFunc,
             nullptr,
@@ -132,6 +242,15 @@ namespace ams::bluetooth::hid::report {
     }
 
     Result InitializeReportBuffer(void) {
+        if (hos::GetVersion() >= hos::Version_12_0_0)
+            g_report_handlers = &report_handlers_v12;
+        else if (hos::GetVersion() >= hos::Version_9_0_0)
+            g_report_handlers = &report_handlers_v9;
+        else if (hos::GetVersion() >= hos::Version_7_0_0)
+            g_report_handlers = &report_handlers_v7;
+        else
+            g_report_handlers = &report_handlers_v1;
+
         g_fake_bt_shmem.Map(os::MemoryPermission_ReadWrite);
         g_fake_buffer = reinterpret_cast<bluetooth::CircularBuffer *>(g_fake_bt_shmem.GetMappedAddress());
         g_fake_buffer->Initialize("HID Report");
@@ -142,24 +261,13 @@ namespace ams::bluetooth::hid::report {
     }
 
     Result WriteHidReportBuffer(const bluetooth::Address *address, const bluetooth::HidReport *report) {
-        if (hos::GetVersion() < hos::Version_9_0_0) {
-            // Todo: check this may still be necessary
-            //g_fake_report_event_info.data_report.v7.size = g_fake_report_event_info.data_report.v7.report.size + 0x11;
-            g_fake_report_event_info.data_report.v7.addr = *address;
-            std::memcpy(&g_fake_report_event_info.data_report.v7.report, report, report->size + sizeof(report->size));
-        }
-        else {
-            g_fake_report_event_info.data_report.v9.addr = *address;
-            std::memcpy(&g_fake_report_event_info.data_report.v9.report, report, report->size + sizeof(report->size));
-        }
-
-        if (hos::GetVersion() >= hos::Version_12_0_0)
-            g_fake_buffer->Write(BtdrvHidEventType_Data, &g_fake_report_event_info, report->size + 0x11);
-        else
-            g_fake_buffer->Write(BtdrvHidEventTypeOld_Data, &g_fake_report_event_info, report->size + 0x11);
+        std::scoped_lock lk(g_fake_report_lock);
 
+        g_report_handlers->write_fake_report(address, report);
         g_system_event_fwd.Signal();
 
+        report_ring::Publish(report_ring::ReportRingEntryType_Translated, address, report);
+
         return ams::ResultSuccess();
     }
 
@@ -202,92 +310,41 @@ namespace ams::bluetooth::hid::report {
         return ams::ResultSuccess();
     }
 
-    inline void HandleHidReportEventV1(void) {
-        R_ABORT_UNLESS(btdrvGetHidReportEventInfo(&g_event_info, sizeof(bluetooth::HidReportEventInfo), &g_current_event_type));
+    inline void WaitReportRead(void) {
+        auto timeout = mitm::GetGlobalConfig()->misc.report_redirect_timeout;
 
-        switch (g_current_event_type) {
-            case BtdrvHidEventTypeOld_Data:
-                {
-                    auto device = controller::LocateHandler(&g_event_info.data_report.v1.addr);
-                    if (!device)
-                        return;
+        // Discard acknowledgements that arrived too late for a previous event
+        g_report_read_event.Clear();
+        g_system_event_user_fwd.Signal();
 
-                    device->HandleIncomingReport(reinterpret_cast<bluetooth::HidReport *>(&g_event_info.data_report.v1.report));
-                }
-                break;
-            default:
-                g_fake_buffer->Write(g_current_event_type, &g_event_info.data_report.v1.report.data, g_event_info.data_report.v1.report.size);
-                break;
-        }
-    }
-
-    inline void HandleHidReportEventV7(void) {
-        while (true) {
-            auto real_packet = g_real_buffer->Read();
-            if (!real_packet)
-                break;
-
-            g_real_buffer->Free();
-
-            switch (real_packet->header.type) {
-                case 0xff:
-                    continue;
-                case BtdrvHidEventTypeOld_Data:
-                    {
-                        auto device = controller::LocateHandler(hos::GetVersion() < hos::Version_9_0_0 ? &real_packet->data.data_report.v7.addr : &real_packet->data.data_report.v9.addr);
-                        if (!device)
-                            continue;
+        auto start_tick = os::GetSystemTick();
+        bool acknowledged = true;
+        if (timeout > 0)
+            acknowledged = g_report_read_event.TimedWait(TimeSpan::FromMilliSeconds(timeout));
+        else
+            g_report_read_event.Wait();
+        uint64_t wait_time = os::ConvertToTimeSpan(os::GetSystemTick() - start_tick).GetMicroSeconds();
 
-                        auto report = hos::GetVersion() < hos::Version_9_0_0 ? reinterpret_cast<bluetooth::HidReport *>(&real_packet->data.data_report.v7.report) : &real_packet->data.data_report.v9.report;
-                        device->HandleIncomingReport(report);
-                    }
-                    break;
-                default:
-                    g_fake_buffer->Write(real_packet->header.type, &real_packet->data, real_packet->header.size);
-                    break;
-            }
+        // A client that stops acknowledging reports would otherwise hold up all controller input, so the redirect is taken back from it
+        if (!acknowledged) {
+            mitm::trace::Record(mitm::trace::TraceEvent_ReportReadTimeout, timeout);
+            g_redirect_hid_report_events = false;
         }
-    }
-
-    inline void HandleHidReportEventV12(void) {
-        while (true) {
-            auto real_packet = g_real_buffer->Read();
-            if (!real_packet)
-                break;
-
-            g_real_buffer->Free();
-
-            switch (real_packet->header.type) {
-                case 0xff:
-                    continue;
-                case BtdrvHidEventType_Data:
-                    {
-                        auto device = controller::LocateHandler(&real_packet->data.data_report.v9.addr);
-                        if (!device)
-                            continue;
 
-                        device->HandleIncomingReport(&real_packet->data.data_report.v9.report);
-                    }
-                    break;
-                default:
-                    g_fake_buffer->Write(real_packet->header.type, &real_packet->data, real_packet->header.size);
-                    break;
-            }
-        }
+        std::scoped_lock lk(g_redirect_statistics_lock);
+        g_redirect_statistics.handshakes++;
+        g_redirect_statistics.wait_time_total_us += wait_time;
+        g_redirect_statistics.wait_time_max_us = std::max(g_redirect_statistics.wait_time_max_us, wait_time);
+        if (!acknowledged)
+            g_redirect_statistics.timeouts++;
     }
 
     void HandleEvent(void) {
         if (g_redirect_hid_report_events) {
-            g_system_event_user_fwd.Signal();
-            g_report_read_event.Wait();
+            WaitReportRead();
         }
 
-        if (hos::GetVersion() >= hos::Version_12_0_0)
-            HandleHidReportEventV12();
-        else if (hos::GetVersion() >= hos::Version_7_0_0)
-            HandleHidReportEventV7();
-        else
-            HandleHidReportEventV1();
+        g_report_handlers->handle_event();
     }
 
 }
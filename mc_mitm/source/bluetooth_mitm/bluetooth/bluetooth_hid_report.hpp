@@ -20,9 +20,17 @@
 
 namespace ams::bluetooth::hid::report {
 
+    struct RedirectStatistics {
+        uint32_t handshakes;
+        uint32_t timeouts;
+        uint64_t wait_time_total_us;
+        uint64_t wait_time_max_us;
+    };
+
     bool IsInitialized(void);
     void WaitInitialized(void);
     void SignalReportRead(void);
+    void GetRedirectStatistics(RedirectStatistics *stats);
 
     os::SharedMemory *GetRealSharedMemory(void);
     os::SharedMemory *GetFakeSharedMemory(void);
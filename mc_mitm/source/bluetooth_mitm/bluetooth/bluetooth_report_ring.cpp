@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bluetooth_report_ring.hpp"
+#include <algorithm>
+#include <mutex>
+#include <cstring>
+
+namespace ams::bluetooth::report_ring {
+
+    namespace {
+
+        constexpr size_t report_ring_sharedmem_size = util::AlignUp(sizeof(ReportRing), os::MemoryPageSize);
+
+        os::SharedMemory g_report_ring_shmem(report_ring_sharedmem_size, os::MemoryPermission_ReadWrite, os::MemoryPermission_ReadOnly);
+
+        // Raw reports come from the report handler, translated ones from anything writing the fake report buffer
+        os::SdkMutex g_publish_lock;
+        os::SdkMutex g_enable_lock;
+
+        ReportRing *g_report_ring;
+        std::atomic<bool> g_enabled;
+
+    }
+
+    os::SharedMemory *GetSharedMemory(void) {
+        return &g_report_ring_shmem;
+    }
+
+    // Mapping is deferred until the first reader asks for the ring, so nothing is published while nobody is listening
+    Result Enable(void) {
+        std::scoped_lock lk(g_enable_lock);
+
+        if (g_enabled)
+            return ams::ResultSuccess();
+
+        // Leave the ring disabled if mapping fails, so the next request can try again
+        void *address = g_report_ring_shmem.Map(os::MemoryPermission_ReadWrite);
+        if (address == nullptr)
+            return -1;
+
+        g_report_ring = reinterpret_cast<ReportRing *>(address);
+
+        // Freshly created shared memory is zero filled, so only the header needs setting up
+        g_report_ring->header.magic       = ReportRingMagic;
+        g_report_ring->header.version     = ReportRingVersion;
+        g_report_ring->header.entry_count = ReportRingEntryCount;
+        g_report_ring->header.entry_size  = sizeof(ReportRingEntry);
+
+        g_enabled.store(true, std::memory_order_release);
+
+        return ams::ResultSuccess();
+    }
+
+    void Publish(ReportRingEntryType type, const bluetooth::Address *address, const bluetooth::HidReport *report) {
+        if (!g_enabled.load(std::memory_order_acquire))
+            return;
+
+        std::scoped_lock lk(g_publish_lock);
+
+        uint64_t sequence = g_report_ring->header.write_sequence.load(std::memory_order_relaxed);
+        auto entry = &g_report_ring->entries[sequence % ReportRingEntryCount];
+
+        // Invalidate the slot so a reader copying it out concurrently sees its sequence change
+        entry->sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        entry->timestamp = os::GetSystemTick().GetInt64Value();
+        entry->address = *address;
+        entry->type = type;
+        entry->size = report->size;
+        std::memcpy(entry->data, report->data, std::min(static_cast<size_t>(report->size), ReportRingDataSize));
+
+        entry->sequence.store(sequence + 1, std::memory_order_release);
+        g_report_ring->header.write_sequence.store(sequence + 1, std::memory_order_release);
+    }
+
+}
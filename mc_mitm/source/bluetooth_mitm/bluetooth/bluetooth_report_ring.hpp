@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+#include <atomic>
+#include "bluetooth_types.hpp"
+
+namespace ams::bluetooth::report_ring {
+
+    // Shared memory ring of the raw and translated input reports passing through the report handler, for passive readers such as overlays and recorders.
+    // The writer never waits on readers. Readers keep their own sequence number and catch up at their own pace:
+    //  - entry n lives in slot (n % entry_count) and is valid while that slot's sequence reads n + 1 both before and after copying it out
+    //  - a reader more than entry_count behind write_sequence has been overrun and should skip ahead, counting the difference as lost
+    constexpr uint32_t ReportRingMagic     = 0x5252434d; // MCRR
+    constexpr uint16_t ReportRingVersion   = 1;
+    constexpr size_t   ReportRingEntryCount = 64;
+    constexpr size_t   ReportRingDataSize   = 0x80;
+
+    enum ReportRingEntryType : uint8_t {
+        ReportRingEntryType_Raw,
+        ReportRingEntryType_Translated
+    };
+
+    struct ReportRingEntry {
+        std::atomic<uint64_t> sequence;
+        uint64_t timestamp;
+        bluetooth::Address address;
+        uint8_t type;
+        uint8_t _pad0;
+        uint16_t size;  // Size of the report as received. Only the first ReportRingDataSize bytes are kept.
+        uint8_t _pad1[6];
+        uint8_t data[ReportRingDataSize];
+    };
+    static_assert(sizeof(ReportRingEntry) == 0xa0);
+
+    struct ReportRingHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t entry_count;
+        uint32_t entry_size;
+        uint32_t _pad0;
+        std::atomic<uint64_t> write_sequence;   // Sequence number the next entry will be published with
+        uint8_t _pad1[0x28];
+    };
+    static_assert(sizeof(ReportRingHeader) == 0x40);
+
+    struct ReportRing {
+        ReportRingHeader header;
+        ReportRingEntry entries[ReportRingEntryCount];
+    };
+
+    os::SharedMemory *GetSharedMemory(void);
+
+    Result Enable(void);
+    void Publish(ReportRingEntryType type, const bluetooth::Address *address, const bluetooth::HidReport *report);
+
+}
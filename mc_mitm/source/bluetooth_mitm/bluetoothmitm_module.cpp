@@ -16,6 +16,7 @@
 #include "bluetoothmitm_module.hpp"
 #include "btdrv_mitm_service.hpp"
 #include "../utils.hpp"
+#include "../mcmitm_thread_stack.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::mitm::bluetooth {
@@ -71,6 +72,7 @@ namespace ams::mitm::bluetooth {
     }
 
     Result Launch(void) {
+        PaintThreadStack("btdrv_mitm", g_btdrv_mitm_thread_stack, sizeof(g_btdrv_mitm_thread_stack));
         R_TRY(os::CreateThread(&g_btdrv_mitm_thread,
             BtdrvMitmThreadFunction,
             nullptr,
@@ -19,13 +19,42 @@
 #include "bluetooth/bluetooth_core.hpp"
 #include "bluetooth/bluetooth_hid.hpp"
 #include "bluetooth/bluetooth_ble.hpp"
+#include "bluetooth/bluetooth_hid_report.hpp"
+#include "bluetooth/bluetooth_report_ring.hpp"
 #include "../mcmitm_initialization.hpp"
+#include "../mcmitm_trace.hpp"
 #include "../controllers/controller_management.hpp"
 #include <switch.h>
+#include <algorithm>
 #include <cstring>
 
 namespace ams::mitm::bluetooth {
 
+    namespace {
+
+        Result DumpTraceFunction(void *data) {
+            AMS_UNUSED(data);
+            return ams::mitm::trace::Dump();
+        }
+
+        // Tell hid a connection has opened or closed for a controller that doesn't exist on the bluetooth side
+        bool SignalFakeConnectionEvent(const ams::bluetooth::Address *address, bool opened) {
+            ams::bluetooth::HidEventInfo event_info = {};
+
+            if (hos::GetVersion() < hos::Version_12_0_0) {
+                event_info.connection.v1.addr = *address;
+                event_info.connection.v1.status = opened ? BtdrvHidConnectionStatusOld_Opened : BtdrvHidConnectionStatusOld_Closed;
+            }
+            else {
+                event_info.connection.v12.addr = *address;
+                event_info.connection.v12.status = opened ? BtdrvHidConnectionStatus_Opened : BtdrvHidConnectionStatus_Closed;
+            }
+
+            return ams::bluetooth::hid::SignalFakeEvent(BtdrvHidEventType_Connection, &event_info, sizeof(event_info));
+        }
+
+    }
+
     Result BtdrvMitmService::InitializeBluetooth(sf::OutCopyHandle out_handle) {
         if (!ams::bluetooth::core::IsInitialized()) {
             // Forward to the real function to obtain the system event handle
@@ -109,7 +138,8 @@ namespace ams::mitm::bluetooth {
     }
 
     Result BtdrvMitmService::GetHidEventInfo(sf::Out<ams::bluetooth::HidEventType> out_type, const sf::OutPointerBuffer &out_buffer) {
-        R_TRY(ams::bluetooth::hid::GetEventInfo(out_type.GetPointer(),
+        R_TRY(ams::bluetooth::hid::GetEventInfo(m_client_info.program_id,
+            out_type.GetPointer(),
             static_cast<uint8_t *>(out_buffer.GetPointer()),
             static_cast<size_t>(out_buffer.GetSize())
         ));
@@ -130,7 +160,8 @@ namespace ams::mitm::bluetooth {
                 uint32_t status;
             } event_data = {tsi == 0xff ? 1u : 0u, address, {0, 0}, 0};
 
-            ams::bluetooth::hid::SignalFakeEvent(BtdrvHidEventTypeOld_Ext, &event_data, sizeof(event_data));
+            if (!ams::bluetooth::hid::SignalFakeEvent(BtdrvHidEventTypeOld_Ext, &event_data, sizeof(event_data)))
+                return -1;
         }
         else if (hos::GetVersion() < hos::Version_12_0_0) {
             const struct {
@@ -140,7 +171,8 @@ namespace ams::mitm::bluetooth {
                 uint8_t pad[2];
             } event_data = {tsi == 0xff ? 1u : 0u, 0, address, {0, 0}};
 
-            ams::bluetooth::hid::SignalFakeEvent(BtdrvHidEventTypeOld_Ext, &event_data, sizeof(event_data));
+            if (!ams::bluetooth::hid::SignalFakeEvent(BtdrvHidEventTypeOld_Ext, &event_data, sizeof(event_data)))
+                return -1;
         }
         else {
             const struct {
@@ -149,7 +181,8 @@ namespace ams::mitm::bluetooth {
                 uint8_t tsi;
             } event_data = { address, 1, tsi };
 
-            ams::bluetooth::core::SignalFakeEvent(BtdrvEventType_Tsi, &event_data, sizeof(event_data));
+            if (!ams::bluetooth::core::SignalFakeEvent(BtdrvEventType_Tsi, &event_data, sizeof(event_data)))
+                return -1;
         }
 
         return ams::ResultSuccess();
@@ -234,7 +267,8 @@ namespace ams::mitm::bluetooth {
     }
 
     Result BtdrvMitmService::GetBleManagedEventInfo(sf::Out<ams::bluetooth::BleEventType> out_type, const sf::OutPointerBuffer &out_buffer) {
-        R_TRY(ams::bluetooth::ble::GetEventInfo(out_type.GetPointer(),
+        R_TRY(ams::bluetooth::ble::GetEventInfo(m_client_info.program_id,
+            out_type.GetPointer(),
             static_cast<uint8_t *>(out_buffer.GetPointer()),
             static_cast<size_t>(out_buffer.GetSize())
         ));
@@ -272,4 +306,70 @@ namespace ams::mitm::bluetooth {
         ams::bluetooth::hid::report::SignalReportRead();
     }
 
+    void BtdrvMitmService::GetIoStatistics(sf::Out<ams::mitm::io::IoStatistics> out_stats) {
+        ams::mitm::io::GetStatistics(out_stats.GetPointer());
+    }
+
+    void BtdrvMitmService::GetEventQueueStatistics(sf::Out<ams::bluetooth::EventQueueStatistics> out_core, sf::Out<ams::bluetooth::EventQueueStatistics> out_hid, sf::Out<ams::bluetooth::EventQueueStatistics> out_ble) {
+        ams::bluetooth::core::GetEventQueueStatistics(out_core.GetPointer());
+        ams::bluetooth::hid::GetEventQueueStatistics(out_hid.GetPointer());
+        ams::bluetooth::ble::GetEventQueueStatistics(out_ble.GetPointer());
+    }
+
+    void BtdrvMitmService::GetRedirectStatistics(sf::Out<ams::bluetooth::hid::report::RedirectStatistics> out_stats) {
+        ams::bluetooth::hid::report::GetRedirectStatistics(out_stats.GetPointer());
+    }
+
+    Result BtdrvMitmService::GetReportRingSharedMemory(sf::OutCopyHandle out_handle) {
+        R_TRY(ams::bluetooth::report_ring::Enable());
+
+        out_handle.SetValue(ams::bluetooth::report_ring::GetSharedMemory()->GetHandle(), false);
+        return ams::ResultSuccess();
+    }
+
+    Result BtdrvMitmService::CreateVirtualController(sf::Out<ams::bluetooth::Address> out_address, sf::OutCopyHandle out_handle) {
+        os::NativeHandle handle = os::InvalidNativeHandle;
+        R_TRY(controller::CreateVirtualController(out_address.GetPointer(), &handle));
+
+        // hid never hears about a controller whose connection event was dropped, so don't leave it behind
+        if (!SignalFakeConnectionEvent(out_address.GetPointer(), true)) {
+            controller::DestroyVirtualController(out_address.GetPointer());
+            return -1;
+        }
+
+        out_handle.SetValue(handle, false);
+        return ams::ResultSuccess();
+    }
+
+    Result BtdrvMitmService::DestroyVirtualController(ams::bluetooth::Address address) {
+        R_TRY(controller::DestroyVirtualController(&address));
+
+        if (!SignalFakeConnectionEvent(&address, false))
+            return -1;
+
+        return ams::ResultSuccess();
+    }
+
+    void BtdrvMitmService::GetHeapStatistics(sf::Out<ams::mitm::HeapArenaStatistics> out_general, sf::Out<ams::mitm::HeapArenaStatistics> out_fs) {
+        ams::mitm::GetHeapStatistics(out_general.GetPointer(), out_fs.GetPointer());
+    }
+
+    void BtdrvMitmService::GetSlabStatistics(const sf::OutArray<ams::mitm::SlabClassStatistics> &out, sf::Out<s32> total_out) {
+        size_t count = std::min(out.GetSize(), ams::mitm::SlabClassCount);
+        ams::mitm::GetSlabStatistics(out.GetPointer(), count);
+        total_out.SetValue(count);
+    }
+
+    void BtdrvMitmService::GetThreadStackUsage(const sf::OutArray<ams::mitm::ThreadStackUsage> &out, sf::Out<s32> total_out) {
+        total_out.SetValue(ams::mitm::GetThreadStackUsage(out.GetPointer(), out.GetSize()));
+    }
+
+    Result BtdrvMitmService::DumpTrace(void) {
+        return ams::mitm::io::Execute(DumpTraceFunction, nullptr);
+    }
+
+    void BtdrvMitmService::GetReportMappingStatistics(const sf::OutArray<ams::controller::ReportMappingStatistics> &out, sf::Out<s32> total_out) {
+        total_out.SetValue(ams::controller::GetReportMappingStatistics(out.GetPointer(), out.GetSize()));
+    }
+
 }
@@ -16,6 +16,13 @@
 #pragma once
 #include <stratosphere.hpp>
 #include "bluetooth/bluetooth_types.hpp"
+#include "bluetooth/bluetooth_event_queue.hpp"
+#include "bluetooth/bluetooth_hid_report.hpp"
+#include "../mcmitm_io.hpp"
+#include "../mcmitm_heap.hpp"
+#include "../mcmitm_thread_stack.hpp"
+#include "../mcmitm_trace.hpp"
+#include "../controllers/switch_controller.hpp"
 
 #define AMS_BTDRV_MITM_INTERFACE_INFO(C, H)                                                                                                                                                                                             \
     AMS_SF_METHOD_INFO(C, H, 1,     Result, InitializeBluetooth,              (sf::OutCopyHandle out_handle),                                                           (out_handle))                                                   \
@@ -40,6 +47,17 @@
     AMS_SF_METHOD_INFO(C, H, 65004, void,   RedirectHidReportEvents,          (bool redirect),                                                                          (redirect))                                                     \
     AMS_SF_METHOD_INFO(C, H, 65005, void,   RedirectBleEvents,                (bool redirect),                                                                          (redirect))                                                     \
     AMS_SF_METHOD_INFO(C, H, 65006, void,   SignalHidReportRead,              (void),                                                                                   ())                                                             \
+    AMS_SF_METHOD_INFO(C, H, 65007, void,   GetIoStatistics,                  (sf::Out<ams::mitm::io::IoStatistics> out_stats),                                         (out_stats))                                                    \
+    AMS_SF_METHOD_INFO(C, H, 65008, void,   GetEventQueueStatistics,          (sf::Out<ams::bluetooth::EventQueueStatistics> out_core, sf::Out<ams::bluetooth::EventQueueStatistics> out_hid, sf::Out<ams::bluetooth::EventQueueStatistics> out_ble), (out_core, out_hid, out_ble)) \
+    AMS_SF_METHOD_INFO(C, H, 65009, void,   GetRedirectStatistics,            (sf::Out<ams::bluetooth::hid::report::RedirectStatistics> out_stats),                     (out_stats))                                                    \
+    AMS_SF_METHOD_INFO(C, H, 65010, Result, GetReportRingSharedMemory,        (sf::OutCopyHandle out_handle),                                                           (out_handle))                                                   \
+    AMS_SF_METHOD_INFO(C, H, 65011, Result, CreateVirtualController,          (sf::Out<ams::bluetooth::Address> out_address, sf::OutCopyHandle out_handle),             (out_address, out_handle))                                      \
+    AMS_SF_METHOD_INFO(C, H, 65012, Result, DestroyVirtualController,         (ams::bluetooth::Address address),                                                        (address))                                                      \
+    AMS_SF_METHOD_INFO(C, H, 65013, void,   GetHeapStatistics,                (sf::Out<ams::mitm::HeapArenaStatistics> out_general, sf::Out<ams::mitm::HeapArenaStatistics> out_fs), (out_general, out_fs))                     \
+    AMS_SF_METHOD_INFO(C, H, 65014, void,   GetSlabStatistics,                (const sf::OutArray<ams::mitm::SlabClassStatistics> &out, sf::Out<s32> total_out),       (out, total_out))                                               \
+    AMS_SF_METHOD_INFO(C, H, 65015, void,   GetThreadStackUsage,              (const sf::OutArray<ams::mitm::ThreadStackUsage> &out, sf::Out<s32> total_out),          (out, total_out))                                               \
+    AMS_SF_METHOD_INFO(C, H, 65016, Result, DumpTrace,                        (void),                                                                                   ())                                                             \
+    AMS_SF_METHOD_INFO(C, H, 65017, void,   GetReportMappingStatistics,       (const sf::OutArray<ams::controller::ReportMappingStatistics> &out, sf::Out<s32> total_out), (out, total_out))
 
 AMS_SF_DEFINE_MITM_INTERFACE(ams::mitm::bluetooth, IBtdrvMitmInterface, AMS_BTDRV_MITM_INTERFACE_INFO)
 
@@ -82,6 +100,17 @@ namespace ams::mitm::bluetooth {
             void RedirectHidReportEvents(bool redirect);
             void RedirectBleEvents(bool redirect);
             void SignalHidReportRead(void);
+            void GetIoStatistics(sf::Out<ams::mitm::io::IoStatistics> out_stats);
+            void GetEventQueueStatistics(sf::Out<ams::bluetooth::EventQueueStatistics> out_core, sf::Out<ams::bluetooth::EventQueueStatistics> out_hid, sf::Out<ams::bluetooth::EventQueueStatistics> out_ble);
+            void GetRedirectStatistics(sf::Out<ams::bluetooth::hid::report::RedirectStatistics> out_stats);
+            Result GetReportRingSharedMemory(sf::OutCopyHandle out_handle);
+            Result CreateVirtualController(sf::Out<ams::bluetooth::Address> out_address, sf::OutCopyHandle out_handle);
+            Result DestroyVirtualController(ams::bluetooth::Address address);
+            void GetHeapStatistics(sf::Out<ams::mitm::HeapArenaStatistics> out_general, sf::Out<ams::mitm::HeapArenaStatistics> out_fs);
+            void GetSlabStatistics(const sf::OutArray<ams::mitm::SlabClassStatistics> &out, sf::Out<s32> total_out);
+            void GetThreadStackUsage(const sf::OutArray<ams::mitm::ThreadStackUsage> &out, sf::Out<s32> total_out);
+            Result DumpTrace(void);
+            void GetReportMappingStatistics(const sf::OutArray<ams::controller::ReportMappingStatistics> &out, sf::Out<s32> total_out);
     };
     static_assert(IsIBtdrvMitmInterface<BtdrvMitmService>);
 
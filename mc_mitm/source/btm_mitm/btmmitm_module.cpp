@@ -16,7 +16,10 @@
 #include "btmmitm_module.hpp"
 #include "btm_mitm_service.hpp"
 #include "../utils.hpp"
+#include "../mcmitm_thread_stack.hpp"
 #include <stratosphere.hpp>
+#include <algorithm>
+#include <type_traits>
 
 namespace ams::mitm::btm {
 
@@ -29,15 +32,40 @@ namespace ams::mitm::btm {
 
         constexpr sm::ServiceName BtmMitmServiceName = sm::ServiceName::Encode("btm");
 
+        // Out buffers are marshalled through the pointer buffer of each session, so it only has to hold the largest reply hid asks for.
+        // From 13.0.0 the device lists are sized by the caller, but hid asks for no more entries than the fixed lists of older firmware held.
+        constexpr size_t MaxConnectedDevices = std::extent_v<decltype(BtmDeviceConditionV900::devices)>;
+        constexpr size_t MaxPairedDevices    = std::extent_v<decltype(BtmDeviceInfoList::devices)>;
+
+        constexpr size_t MinPointerBufferSize = util::AlignUp(std::max({
+            sizeof(BtmDeviceConditionV100),
+            sizeof(BtmDeviceConditionV510),
+            sizeof(BtmDeviceConditionV800),
+            sizeof(BtmDeviceConditionV900),
+            sizeof(BtmDeviceInfoList),
+            MaxConnectedDevices * sizeof(BtmConnectedDeviceV13),
+            MaxPairedDevices * sizeof(BtmDeviceInfoV13)
+        }), 0x10);
+
+        // Sizes are set from the Makefile. An empty BTM_MITM_POINTER_BUFFER_SIZE sizes the pointer buffer to the largest reply.
+#ifdef MCMITM_BTM_MITM_POINTER_BUFFER_SIZE
+        constexpr size_t SessionPointerBufferSize = MCMITM_BTM_MITM_POINTER_BUFFER_SIZE;
+#else
+        constexpr size_t SessionPointerBufferSize = MinPointerBufferSize;
+#endif
+        static_assert(SessionPointerBufferSize >= MinPointerBufferSize, "btm mitm pointer buffer can't hold the largest reply");
+
         struct ServerOptions {
-            static constexpr size_t PointerBufferSize   = 0x1000;
+            static constexpr size_t PointerBufferSize   = SessionPointerBufferSize;
             static constexpr size_t MaxDomains          = 0;
             static constexpr size_t MaxDomainObjects    = 0;
             static constexpr bool CanDeferInvokeRequest = false;
             static constexpr bool CanManageMitmServers  = true;
         };
 
-        constexpr size_t MaxSessions = 6;
+        // The mitm query session from sm takes one, and hid, the only client mitm'd, keeps a single btm session open. The default leaves one spare.
+        constexpr size_t MaxSessions = MCMITM_BTM_MITM_MAX_SESSIONS;
+        static_assert(MaxSessions >= 2, "btm mitm needs a session for the sm query and one for hid");
 
         class ServerManager final : public sf::hipc::ServerManager<PortIndex_Count, ServerOptions, MaxSessions> {
             private:
@@ -60,7 +88,9 @@ namespace ams::mitm::btm {
         }
 
         os::ThreadType g_btm_mitm_thread;
-        alignas(os::ThreadStackAlignment) u8 g_btm_mitm_thread_stack[0x2000];
+        // Check the high-water mark reported by GetThreadStackUsage before lowering BTM_MITM_STACK_SIZE
+        static_assert(util::IsAligned(MCMITM_BTM_MITM_STACK_SIZE, os::ThreadStackAlignment));
+        alignas(os::ThreadStackAlignment) u8 g_btm_mitm_thread_stack[MCMITM_BTM_MITM_STACK_SIZE];
         s32 g_btm_mitm_thread_priority = utils::ConvertToUserPriority(37);
 
         void BtmMitmThreadFunction(void *) {
@@ -71,6 +101,7 @@ namespace ams::mitm::btm {
     }
 
     Result Launch(void) {
+        PaintThreadStack("btm_mitm", g_btm_mitm_thread_stack, sizeof(g_btm_mitm_thread_stack));
         R_TRY(os::CreateThread(&g_btm_mitm_thread,
             BtmMitmThreadFunction,
             nullptr,
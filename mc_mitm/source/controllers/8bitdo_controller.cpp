@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "8bitdo_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -29,104 +30,128 @@ namespace ams::controller {
 
         switch(eightbitdo_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(eightbitdo_report, report->size == 9 ? EightBitDoReportFormat_ZeroV1 : EightBitDoReportFormat_Other);
+                if (m_input_report0x01_format.format == EightBitDoReportFormat_Unknown) {
+                    if (report->size == sizeof(EightBitDoInputReport0x01V1) + 1)
+                        m_input_report0x01_format = { EightBitDoReportFormat_ZeroV1, sizeof(EightBitDoInputReport0x01V1) + 1 };
+                    else if (report->size >= sizeof(EightBitDoInputReport0x01V2) + 1)
+                        m_input_report0x01_format = { EightBitDoReportFormat_Other, sizeof(EightBitDoInputReport0x01V2) + 1 };
+                }
+
+                if (report->size < m_input_report0x01_format.size)
+                    break;
+
+                if (m_input_report0x01_format.format == EightBitDoReportFormat_ZeroV1)
+                    this->HandleInputReport0x01V1(eightbitdo_report);
+                else
+                    this->HandleInputReport0x01V2(eightbitdo_report);
                 break;
             case 0x03:
-                this->HandleInputReport0x03(eightbitdo_report, report->size == 11 ? EightBitDoReportFormat_ZeroV1 : EightBitDoReportFormat_ZeroV2);
+                if (m_input_report0x03_format.format == EightBitDoReportFormat_Unknown) {
+                    if (report->size == sizeof(EightBitDoInputReport0x03V1) + 1)
+                        m_input_report0x03_format = { EightBitDoReportFormat_ZeroV1, sizeof(EightBitDoInputReport0x03V1) + 1 };
+                    else if (report->size >= sizeof(EightBitDoInputReport0x03V2) + 1)
+                        m_input_report0x03_format = { EightBitDoReportFormat_Other, sizeof(EightBitDoInputReport0x03V2) + 1 };
+                }
+
+                if (report->size < m_input_report0x03_format.size)
+                    break;
+
+                if (m_input_report0x03_format.format == EightBitDoReportFormat_ZeroV1)
+                    this->HandleInputReport0x03V1(eightbitdo_report);
+                else
+                    this->HandleInputReport0x03V2(eightbitdo_report);
                 break;
             default:
                 break;
         }
     }
 
-    void EightBitDoController::HandleInputReport0x01(const EightBitDoReportData *src, EightBitDoReportFormat fmt) {
-        if (fmt == EightBitDoReportFormat_ZeroV1) {
-            m_buttons.dpad_down   = (src->input0x01_v1.dpad == EightBitDoDPadV1_S)  ||
-                                    (src->input0x01_v1.dpad == EightBitDoDPadV1_SE) ||
-                                    (src->input0x01_v1.dpad == EightBitDoDPadV1_SW);
-            m_buttons.dpad_up     = (src->input0x01_v1.dpad == EightBitDoDPadV1_N)  ||
-                                    (src->input0x01_v1.dpad == EightBitDoDPadV1_NE) ||
-                                    (src->input0x01_v1.dpad == EightBitDoDPadV1_NW);
-            m_buttons.dpad_right  = (src->input0x01_v1.dpad == EightBitDoDPadV1_E)  ||
-                                    (src->input0x01_v1.dpad == EightBitDoDPadV1_NE) ||
-                                    (src->input0x01_v1.dpad == EightBitDoDPadV1_SE);
-            m_buttons.dpad_left   = (src->input0x01_v1.dpad == EightBitDoDPadV1_W)  ||
-                                    (src->input0x01_v1.dpad == EightBitDoDPadV1_NW) ||
-                                    (src->input0x01_v1.dpad == EightBitDoDPadV1_SW);
-        }
-        else {
-            m_left_stick.SetData(
-                static_cast<uint16_t>(stick_scale_factor * src->input0x01_v2.left_stick.x) & 0xfff,
-                static_cast<uint16_t>(stick_scale_factor * (UINT16_MAX - src->input0x01_v2.left_stick.y)) & 0xfff
-            );
-            m_right_stick.SetData(
-                static_cast<uint16_t>(stick_scale_factor * src->input0x01_v2.right_stick.x) & 0xfff,
-                static_cast<uint16_t>(stick_scale_factor * (UINT16_MAX - src->input0x01_v2.right_stick.y)) & 0xfff
-            );
-
-            m_buttons.dpad_down   = (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_S)  ||
-                                    (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_SE) ||
-                                    (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_SW);
-            m_buttons.dpad_up     = (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_N)  ||
-                                    (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_NE) ||
-                                    (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_NW);
-            m_buttons.dpad_right  = (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_E)  ||
-                                    (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_NE) ||
-                                    (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_SE);
-            m_buttons.dpad_left   = (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_W)  ||
-                                    (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_NW) ||
-                                    (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_SW);
-
-            m_buttons.A = src->input0x01_v2.buttons.B;
-            m_buttons.B = src->input0x01_v2.buttons.A;
-            m_buttons.X = src->input0x01_v2.buttons.Y;
-            m_buttons.Y = src->input0x01_v2.buttons.X;
-
-            m_buttons.R  = src->input0x01_v2.buttons.R1;
-            m_buttons.ZR = src->input0x01_v2.right_trigger > 0x7f;
-            m_buttons.L  = src->input0x01_v2.buttons.L1;
-            m_buttons.ZL = src->input0x01_v2.left_trigger > 0x7f;
-
-            m_buttons.minus = src->input0x01_v2.buttons.select;
-            m_buttons.plus  = src->input0x01_v2.buttons.start;
-
-            m_buttons.lstick_press = src->input0x01_v2.buttons.L3;
-            m_buttons.rstick_press = src->input0x01_v2.buttons.R3;
-
-            m_buttons.home = src->input0x01_v2.buttons.home;
-        }
+    void EightBitDoController::HandleInputReport0x01V1(const EightBitDoReportData *src) {
+        m_buttons.dpad_down   = (src->input0x01_v1.dpad == EightBitDoDPadV1_S)  ||
+                                (src->input0x01_v1.dpad == EightBitDoDPadV1_SE) ||
+                                (src->input0x01_v1.dpad == EightBitDoDPadV1_SW);
+        m_buttons.dpad_up     = (src->input0x01_v1.dpad == EightBitDoDPadV1_N)  ||
+                                (src->input0x01_v1.dpad == EightBitDoDPadV1_NE) ||
+                                (src->input0x01_v1.dpad == EightBitDoDPadV1_NW);
+        m_buttons.dpad_right  = (src->input0x01_v1.dpad == EightBitDoDPadV1_E)  ||
+                                (src->input0x01_v1.dpad == EightBitDoDPadV1_NE) ||
+                                (src->input0x01_v1.dpad == EightBitDoDPadV1_SE);
+        m_buttons.dpad_left   = (src->input0x01_v1.dpad == EightBitDoDPadV1_W)  ||
+                                (src->input0x01_v1.dpad == EightBitDoDPadV1_NW) ||
+                                (src->input0x01_v1.dpad == EightBitDoDPadV1_SW);
+    }
+
+    void EightBitDoController::HandleInputReport0x01V2(const EightBitDoReportData *src) {
+        m_left_stick.SetData(
+            static_cast<uint16_t>(stick_scale_factor * src->input0x01_v2.left_stick.x) & 0xfff,
+            static_cast<uint16_t>(stick_scale_factor * (UINT16_MAX - src->input0x01_v2.left_stick.y)) & 0xfff
+        );
+        m_right_stick.SetData(
+            static_cast<uint16_t>(stick_scale_factor * src->input0x01_v2.right_stick.x) & 0xfff,
+            static_cast<uint16_t>(stick_scale_factor * (UINT16_MAX - src->input0x01_v2.right_stick.y)) & 0xfff
+        );
+
+        m_buttons.dpad_down   = (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_S)  ||
+                                (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_SE) ||
+                                (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_SW);
+        m_buttons.dpad_up     = (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_N)  ||
+                                (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_NE) ||
+                                (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_NW);
+        m_buttons.dpad_right  = (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_E)  ||
+                                (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_NE) ||
+                                (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_SE);
+        m_buttons.dpad_left   = (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_W)  ||
+                                (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_NW) ||
+                                (src->input0x01_v2.buttons.dpad == EightBitDoDPadV2_SW);
+
+        m_buttons.A = src->input0x01_v2.buttons.B;
+        m_buttons.B = src->input0x01_v2.buttons.A;
+        m_buttons.X = src->input0x01_v2.buttons.Y;
+        m_buttons.Y = src->input0x01_v2.buttons.X;
+
+        m_buttons.R  = src->input0x01_v2.buttons.R1;
+        m_buttons.ZR = src->input0x01_v2.right_trigger > 0x7f;
+        m_buttons.L  = src->input0x01_v2.buttons.L1;
+        m_buttons.ZL = src->input0x01_v2.left_trigger > 0x7f;
+
+        m_buttons.minus = src->input0x01_v2.buttons.select;
+        m_buttons.plus  = src->input0x01_v2.buttons.start;
+
+        m_buttons.lstick_press = src->input0x01_v2.buttons.L3;
+        m_buttons.rstick_press = src->input0x01_v2.buttons.R3;
+
+        m_buttons.home = src->input0x01_v2.buttons.home;
     }
 
-    void EightBitDoController::HandleInputReport0x03(const EightBitDoReportData *src, EightBitDoReportFormat fmt) {
-        if (fmt == EightBitDoReportFormat_ZeroV1) {
-            m_buttons.A = src->input0x03_v1.buttons.B;
-            m_buttons.B = src->input0x03_v1.buttons.A;
-            m_buttons.X = src->input0x03_v1.buttons.Y;
-            m_buttons.Y = src->input0x03_v1.buttons.X;
+    void EightBitDoController::HandleInputReport0x03V1(const EightBitDoReportData *src) {
+        m_buttons.A = src->input0x03_v1.buttons.B;
+        m_buttons.B = src->input0x03_v1.buttons.A;
+        m_buttons.X = src->input0x03_v1.buttons.Y;
+        m_buttons.Y = src->input0x03_v1.buttons.X;
 
-            m_buttons.R = src->input0x03_v1.buttons.R1;
-            m_buttons.L = src->input0x03_v1.buttons.L1;
+        m_buttons.R = src->input0x03_v1.buttons.R1;
+        m_buttons.L = src->input0x03_v1.buttons.L1;
 
-            m_buttons.minus = src->input0x03_v1.buttons.select;
-            m_buttons.plus  = src->input0x03_v1.buttons.start;
-        }
-        else if (fmt == EightBitDoReportFormat_ZeroV2) {
-            m_buttons.dpad_down  = src->input0x03_v2.left_stick.y == 0xff;
-            m_buttons.dpad_up    = src->input0x03_v2.left_stick.y == 0x00;
-            m_buttons.dpad_right = src->input0x03_v2.left_stick.x == 0xff;
-            m_buttons.dpad_left  = src->input0x03_v2.left_stick.x == 0x00;
-
-            m_buttons.A = src->input0x03_v2.buttons.B;
-            m_buttons.B = src->input0x03_v2.buttons.A;
-            m_buttons.X = src->input0x03_v2.buttons.Y;
-            m_buttons.Y = src->input0x03_v2.buttons.X;
-
-            m_buttons.R = src->input0x03_v2.buttons.R1;
-            m_buttons.L = src->input0x03_v2.buttons.L1;
-
-            m_buttons.minus = src->input0x03_v2.buttons.select;
-            m_buttons.plus  = src->input0x03_v2.buttons.start;
-        }
+        m_buttons.minus = src->input0x03_v1.buttons.select;
+        m_buttons.plus  = src->input0x03_v1.buttons.start;
+    }
+
+    void EightBitDoController::HandleInputReport0x03V2(const EightBitDoReportData *src) {
+        m_buttons.dpad_down  = src->input0x03_v2.left_stick.y == 0xff;
+        m_buttons.dpad_up    = src->input0x03_v2.left_stick.y == 0x00;
+        m_buttons.dpad_right = src->input0x03_v2.left_stick.x == 0xff;
+        m_buttons.dpad_left  = src->input0x03_v2.left_stick.x == 0x00;
+
+        m_buttons.A = src->input0x03_v2.buttons.B;
+        m_buttons.B = src->input0x03_v2.buttons.A;
+        m_buttons.X = src->input0x03_v2.buttons.Y;
+        m_buttons.Y = src->input0x03_v2.buttons.X;
+
+        m_buttons.R = src->input0x03_v2.buttons.R1;
+        m_buttons.L = src->input0x03_v2.buttons.L1;
+
+        m_buttons.minus = src->input0x03_v2.buttons.select;
+        m_buttons.plus  = src->input0x03_v2.buttons.start;
     }
 
 }
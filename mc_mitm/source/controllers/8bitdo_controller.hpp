@@ -18,9 +18,9 @@
 
 namespace ams::controller {
 
-    enum EightBitDoReportFormat {
+    enum EightBitDoReportFormat : uint8_t {
+        EightBitDoReportFormat_Unknown,
         EightBitDoReportFormat_ZeroV1,
-        EightBitDoReportFormat_ZeroV2,
         EightBitDoReportFormat_Other
     };
 
@@ -100,6 +100,7 @@ namespace ams::controller {
         uint16_t dpad;
         uint8_t _unk1[4];
     } __attribute__((packed));
+    static_assert(sizeof(EightBitDoInputReport0x01V1) == 0x08);
 
     struct EightBitDoInputReport0x01V2 {
         EightBitDoButtonDataV2 buttons;
@@ -109,6 +110,7 @@ namespace ams::controller {
         uint8_t right_trigger;
         uint8_t _unk0;
     } __attribute__((packed));
+    static_assert(sizeof(EightBitDoInputReport0x01V2) == 0x0e);
 
     struct EightBitDoInputReport0x03V1 {
         uint8_t dpad;
@@ -117,6 +119,7 @@ namespace ams::controller {
         uint8_t _unk[3];
         EightBitDoButtonDataV1 buttons;
     } __attribute__((packed));
+    static_assert(sizeof(EightBitDoInputReport0x03V1) == 0x0a);
 
     struct EightBitDoInputReport0x03V2 {
         uint8_t dpad;
@@ -125,6 +128,7 @@ namespace ams::controller {
         uint8_t _unk[2];
         EightBitDoButtonDataV1 buttons;
     } __attribute__((packed));
+    static_assert(sizeof(EightBitDoInputReport0x03V2) == 0x09);
 
     struct EightBitDoReportData {
         uint8_t id;
@@ -145,15 +149,30 @@ namespace ams::controller {
             };  
 
             EightBitDoController(const bluetooth::Address *address, HardwareID id)
-            : EmulatedSwitchController(address, id) { }
+            : EmulatedSwitchController(address, id)
+            , m_input_report0x01_format{EightBitDoReportFormat_Unknown, UINT16_MAX}
+            , m_input_report0x03_format{EightBitDoReportFormat_Unknown, UINT16_MAX} { }
 
             bool SupportsSetTsiCommand(void) { return !((m_id.vid == 0x05a0) && (m_id.pid == 0x3232)); }
 
             void UpdateControllerState(const bluetooth::HidReport *report);
 
         private:
-            void HandleInputReport0x01(const EightBitDoReportData *src, EightBitDoReportFormat fmt);
-            void HandleInputReport0x03(const EightBitDoReportData *src, EightBitDoReportFormat fmt);
+            // Which format a report id is sent in is told apart by its length. This is worked out from the first report long enough for
+            // one of them and kept for the rest of the connection. Until then the size is too large for any report, so that a single
+            // length check drops what can't be decoded.
+            struct InputReportFormat {
+                EightBitDoReportFormat format;
+                uint16_t size;
+            };
+
+            void HandleInputReport0x01V1(const EightBitDoReportData *src);
+            void HandleInputReport0x01V2(const EightBitDoReportData *src);
+            void HandleInputReport0x03V1(const EightBitDoReportData *src);
+            void HandleInputReport0x03V2(const EightBitDoReportData *src);
+
+            InputReportFormat m_input_report0x01_format;
+            InputReportFormat m_input_report0x03_format;
 
     };
 
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "atgames_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -29,7 +30,8 @@ namespace ams::controller {
 
         switch(atgames_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(atgames_report);
+                if (auto src = GetReportView<AtGamesReportData, AtGamesInputReport0x01>(report))
+                    this->HandleInputReport0x01(src);
                 break;
             default:
                 break;
@@ -57,6 +57,7 @@ namespace ams::controller {
         uint8_t unk2;
 
     } __attribute__((packed));
+    static_assert(sizeof(AtGamesInputReport0x01) == 0x0a);
 
     struct AtGamesReportData {
         uint8_t id;
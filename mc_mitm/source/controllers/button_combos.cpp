@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "button_combos.hpp"
+#include "switch_controller.hpp"
+#include <cstring>
+#include <string>
+
+namespace ams::controller {
+
+    namespace {
+
+        static_assert(MaxButtonComboRules <= 8 * sizeof(uint8_t));
+
+        constexpr struct {
+            const char *name;
+            uint32_t mask;
+        } button_names[] = {
+            { "y",          SwitchButtonMask_Y           },
+            { "x",          SwitchButtonMask_X           },
+            { "b",          SwitchButtonMask_B           },
+            { "a",          SwitchButtonMask_A           },
+            { "r",          SwitchButtonMask_R           },
+            { "zr",         SwitchButtonMask_ZR          },
+            { "minus",      SwitchButtonMask_Minus       },
+            { "plus",       SwitchButtonMask_Plus        },
+            { "rstick",     SwitchButtonMask_RStickPress },
+            { "lstick",     SwitchButtonMask_LStickPress },
+            { "home",       SwitchButtonMask_Home        },
+            { "capture",    SwitchButtonMask_Capture     },
+            { "dpad_down",  SwitchButtonMask_DpadDown    },
+            { "dpad_up",    SwitchButtonMask_DpadUp      },
+            { "dpad_right", SwitchButtonMask_DpadRight   },
+            { "dpad_left",  SwitchButtonMask_DpadLeft    },
+            { "l",          SwitchButtonMask_L           },
+            { "zl",         SwitchButtonMask_ZL          },
+        };
+
+        // Parses button names joined by '+', up to the end of the string or the given terminator. Returns 0 if any name is unknown.
+        uint32_t ParseButtonChord(const char *value, char terminator) {
+            uint32_t chord = 0;
+
+            while (true) {
+                while (*value == ' ')
+                    ++value;
+
+                size_t length = 0;
+                while ((value[length] != '\0') && (value[length] != '+') && (value[length] != terminator) && (value[length] != ' '))
+                    ++length;
+
+                uint32_t mask = 0;
+                for (auto &button : button_names) {
+                    if ((std::strlen(button.name) == length) && (strncasecmp(button.name, value, length) == 0)) {
+                        mask = button.mask;
+                        break;
+                    }
+                }
+
+                if (mask == 0)
+                    return 0;
+
+                chord |= mask;
+                value += length;
+
+                while (*value == ' ')
+                    ++value;
+
+                if (*value != '+')
+                    return ((*value == '\0') || (*value == terminator)) ? chord : 0;
+
+                ++value;
+            }
+        }
+
+        // Each entry maps a chord to the buttons it produces, with an optional hold time in milliseconds, eg. "l+r = capture@500"
+        int ButtonCombosIniHandler(void *user, const char *section, const char *name, const char *value) {
+            auto combos = reinterpret_cast<ButtonCombos *>(user);
+
+            if (strcasecmp(section, "combos") != 0)
+                return 0;
+
+            uint32_t chord = ParseButtonChord(name, '\0');
+            uint32_t output = ParseButtonChord(value, '@');
+            if ((chord == 0) || (output == 0))
+                return 0;
+
+            uint32_t hold_ms = 0;
+            if (auto hold = std::strchr(value, '@')) {
+                char *end;
+                hold_ms = std::strtoul(hold + 1, &end, 10);
+                if ((end == hold + 1) || (*end != '\0'))
+                    return 0;
+            }
+
+            return combos->AddChord(chord, output, hold_ms);
+        }
+
+    }
+
+    bool ButtonCombos::AddRule(const ButtonComboRule *rule) {
+        if (m_rule_count >= MaxButtonComboRules)
+            return false;
+
+        m_rules[m_rule_count] = *rule;
+        m_held_since[m_rule_count] = 0;
+        ++m_rule_count;
+
+        return true;
+    }
+
+    bool ButtonCombos::AddChord(uint32_t chord, uint32_t output, uint32_t hold_ms) {
+        const ButtonComboRule rule = {
+            .mask = chord,
+            .match = chord,
+            .clear = chord,
+            .set = output,
+            .hold_ms = hold_ms
+        };
+
+        return this->AddRule(&rule);
+    }
+
+    void ButtonCombos::Apply(SwitchButtonData *buttons, uint32_t now_ms) {
+        uint8_t bytes[3];
+        std::memcpy(bytes, buttons, sizeof(bytes));
+        uint32_t word = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16);
+
+        // Rule outcomes are turned into all-ones or all-zeros masks rather than branched on
+        uint8_t matched_rules = 0;
+        for (size_t i = 0; i < m_rule_count; ++i) {
+            const ButtonComboRule *rule = &m_rules[i];
+
+            uint32_t matched = (word & rule->mask) == rule->match;
+            uint32_t newly_matched = matched & ~(m_matched_rules >> i) & 1;
+            m_held_since[i] = newly_matched ? now_ms : m_held_since[i];
+
+            // The cleared buttons are withheld from the moment the rule matches, so the game never sees a chord that is still being held towards its combo
+            uint32_t fire = -(matched & ((now_ms - m_held_since[i]) >= rule->hold_ms));
+            word = (word & ~(rule->clear & -matched)) | (rule->set & fire);
+
+            matched_rules |= matched << i;
+        }
+        m_matched_rules = matched_rules;
+
+        bytes[0] = word & 0xff;
+        bytes[1] = (word >> 8) & 0xff;
+        bytes[2] = (word >> 16) & 0xff;
+        std::memcpy(buttons, bytes, sizeof(bytes));
+    }
+
+    void AddDefaultButtonCombos(ButtonCombos *combos) {
+        combos->AddChord(SwitchButtonMask_Minus | SwitchButtonMask_DpadDown, SwitchButtonMask_Home, 0);
+        combos->AddChord(SwitchButtonMask_Minus | SwitchButtonMask_DpadUp, SwitchButtonMask_Capture, 0);
+    }
+
+    Result LoadButtonCombos(const bluetooth::Address *address, ButtonCombos *combos) {
+        std::string path = GetControllerDirectory(address) + "/combos.ini";
+
+        fs::FileHandle file;
+        R_TRY(fs::OpenFile(std::addressof(file), path.c_str(), fs::OpenMode_Read));
+        ON_SCOPE_EXIT { fs::CloseFile(file); };
+
+        ButtonCombos loaded;
+        util::ini::ParseFile(file, &loaded, ButtonCombosIniHandler);
+
+        if (!loaded.IsEmpty())
+            *combos = loaded;
+
+        return ams::ResultSuccess();
+    }
+
+}
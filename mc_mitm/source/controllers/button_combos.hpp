@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+#include "../bluetooth_mitm/bluetooth/bluetooth_types.hpp"
+
+namespace ams::controller {
+
+    struct SwitchButtonData;
+
+    constexpr size_t MaxButtonComboRules = 6;
+
+    // Rules operate on the button word described by SwitchButtonMask. A rule matches when the buttons in mask are in the state
+    // given by match, and fires once it has matched for at least hold_ms. The buttons in clear are released for as long as the rule
+    // matches, including while a hold is still pending, and those in set are pressed while it fires.
+    struct ButtonComboRule {
+        uint32_t mask;
+        uint32_t match;
+        uint32_t clear;
+        uint32_t set;
+        uint32_t hold_ms;
+    };
+
+    // Rules are applied in order, each seeing the buttons as left by the ones before it
+    class ButtonCombos {
+
+        public:
+            ButtonCombos(void) : m_rule_count(0), m_matched_rules(0) { }
+
+            void Clear(void) { m_rule_count = 0; m_matched_rules = 0; }
+            bool IsEmpty(void) const { return m_rule_count == 0; }
+
+            bool AddRule(const ButtonComboRule *rule);
+
+            // A chord is the common case of a rule that fires while all of its buttons are held, standing in for them
+            bool AddChord(uint32_t chord, uint32_t output, uint32_t hold_ms);
+
+            void Apply(SwitchButtonData *buttons, uint32_t now_ms);
+
+        private:
+            ButtonComboRule m_rules[MaxButtonComboRules];
+            uint32_t m_held_since[MaxButtonComboRules];
+            uint8_t m_rule_count;
+            uint8_t m_matched_rules;
+
+    };
+
+    // MINUS + DPAD_DOWN for HOME and MINUS + DPAD_UP for CAPTURE, for controllers without those buttons
+    void AddDefaultButtonCombos(ButtonCombos *combos);
+
+    // Reads the optional combos.ini from the controller directory on the I/O thread. Combos listed there replace the ones given by the driver.
+    Result LoadButtonCombos(const bluetooth::Address *address, ButtonCombos *combos);
+
+}
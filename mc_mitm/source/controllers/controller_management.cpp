@@ -14,6 +14,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "controller_management.hpp"
+#include "../mcmitm_io.hpp"
+#include "../utils.hpp"
+#include "../mcmitm_thread_stack.hpp"
 #include <stratosphere.hpp>
 #include <memory>
 #include <mutex>
@@ -41,13 +44,201 @@ namespace ams::controller {
         constexpr auto cod_minor_joystick    = 0x04;
         constexpr auto cod_minor_keyboard    = 0x40;
 
+        // Controllers live on the 32KB general heap, one per connected device. Anything growing them noticeably should be a deliberate decision.
+        constexpr size_t MaxControllerObjectSize = 0xa00;
+
+        static_assert(sizeof(SwitchController)       <= MaxControllerObjectSize);
+        static_assert(sizeof(WiiController)          <= MaxControllerObjectSize);
+        static_assert(sizeof(Dualshock4Controller)   <= MaxControllerObjectSize);
+        static_assert(sizeof(DualsenseController)    <= MaxControllerObjectSize);
+        static_assert(sizeof(XboxOneController)      <= MaxControllerObjectSize);
+        static_assert(sizeof(OuyaController)         <= MaxControllerObjectSize);
+        static_assert(sizeof(GamestickController)    <= MaxControllerObjectSize);
+        static_assert(sizeof(GemboxController)       <= MaxControllerObjectSize);
+        static_assert(sizeof(IpegaController)        <= MaxControllerObjectSize);
+        static_assert(sizeof(XiaomiController)       <= MaxControllerObjectSize);
+        static_assert(sizeof(GamesirController)      <= MaxControllerObjectSize);
+        static_assert(sizeof(SteelseriesController)  <= MaxControllerObjectSize);
+        static_assert(sizeof(NvidiaShieldController) <= MaxControllerObjectSize);
+        static_assert(sizeof(EightBitDoController)   <= MaxControllerObjectSize);
+        static_assert(sizeof(PowerAController)       <= MaxControllerObjectSize);
+        static_assert(sizeof(MadCatzController)      <= MaxControllerObjectSize);
+        static_assert(sizeof(MocuteController)       <= MaxControllerObjectSize);
+        static_assert(sizeof(RazerController)        <= MaxControllerObjectSize);
+        static_assert(sizeof(ICadeController)        <= MaxControllerObjectSize);
+        static_assert(sizeof(LanShenController)      <= MaxControllerObjectSize);
+        static_assert(sizeof(AtGamesController)      <= MaxControllerObjectSize);
+        static_assert(sizeof(HyperkinController)     <= MaxControllerObjectSize);
+        static_assert(sizeof(UnknownController)      <= MaxControllerObjectSize);
+        static_assert(sizeof(VirtualController)      <= MaxControllerObjectSize);
+
+        constexpr size_t AttachThreadStackSize = 0x2000;
+        constexpr s32 AttachThreadPriority = 20;
+
         os::Mutex g_controller_lock(false);
-        std::vector<std::unique_ptr<SwitchController>> g_controllers;
+        std::vector<std::shared_ptr<SwitchController>> g_controllers;
+
+        struct PendingController {
+            std::shared_ptr<SwitchController> controller;
+            ControllerType type;
+        };
+
+        // Controllers that have been registered but are still waiting on their filesystem setup
+        os::Mutex g_pending_lock(false);
+        std::vector<PendingController> g_pending_controllers;
+        os::Event g_pending_event(os::EventClearMode_AutoClear);
+
+        os::ThreadType g_attach_thread;
+        alignas(os::ThreadStackAlignment) uint8_t g_attach_thread_stack[AttachThreadStackSize];
+
+        // Virtual controllers are given locally administered addresses ending in their slot number
+        constexpr uint8_t VirtualControllerAddressPrefix[] = {0x02, 0x4d, 0x43, 0x56, 0x00};
+        constexpr size_t MaxVirtualControllers = 8;
+
+        // Input reports for virtual controllers are produced at the rate a Pro Controller sends them over bluetooth
+        constexpr TimeSpan VirtualReportInterval = TimeSpan::FromMilliSeconds(15);
+        constexpr size_t VirtualReportThreadStackSize = 0x1000;
+        const s32 VirtualReportThreadPriority = utils::ConvertToUserPriority(17);
+
+        os::Mutex g_virtual_lock(false);
+        std::vector<std::shared_ptr<VirtualController>> g_virtual_controllers;
+        os::Event g_virtual_event(os::EventClearMode_AutoClear);
+
+        os::ThreadType g_virtual_report_thread;
+        alignas(os::ThreadStackAlignment) uint8_t g_virtual_report_thread_stack[VirtualReportThreadStackSize];
 
         inline bool bdcmp(const bluetooth::Address *addr1, const bluetooth::Address *addr2) {
             return std::memcmp(addr1, addr2, sizeof(bluetooth::Address)) == 0;
         }
 
+        Result ReleaseControllerFunction(void *data) {
+            delete *reinterpret_cast<std::shared_ptr<SwitchController> **>(data);
+            return ams::ResultSuccess();
+        }
+
+        // Requests already queued to the I/O thread may still refer to the controller, so the reference is dropped from behind them.
+        // If the queue is full, wait for a slot rather than dropping it here ahead of those requests.
+        void ReleaseController(std::shared_ptr<SwitchController> controller) {
+            auto ref = new std::shared_ptr<SwitchController>(std::move(controller));
+            if (!mitm::io::Submit(ReleaseControllerFunction, nullptr, &ref, sizeof(ref)))
+                mitm::io::Execute(ReleaseControllerFunction, &ref);
+        }
+
+        void RemoveController(const SwitchController *controller) {
+            std::scoped_lock lk(g_controller_lock);
+
+            for (auto it = g_controllers.begin(); it < g_controllers.end(); ++it) {
+                if ((*it).get() == controller) {
+                    g_controllers.erase(it);
+                    return;
+                }
+            }
+        }
+
+        void InitializeController(const PendingController *pending) {
+            auto controller = pending->controller.get();
+            auto address = &controller->Address();
+            auto id = controller->HardwareId();
+
+            // Restore the last known state of the controller, unless the device at this address has since changed
+            ControllerProfile profile;
+            if (R_FAILED(LoadControllerProfile(address, &profile)) || (profile.type != pending->type) || (profile.vid != id.vid) || (profile.pid != id.pid)) {
+                InitializeControllerProfile(&profile, pending->type, id.vid, id.pid);
+            }
+            controller->SetProfile(&profile);
+
+            // The device may already have gone away by now, in which case there's nothing left to set up
+            if (R_FAILED(controller->Initialize())) {
+                RemoveController(controller);
+                return;
+            }
+
+            controller->SetReady();
+        }
+
+        void AttachThreadFunc(void *) {
+            while (true) {
+                g_pending_event.Wait();
+
+                while (true) {
+                    PendingController pending;
+                    {
+                        std::scoped_lock lk(g_pending_lock);
+                        if (g_pending_controllers.empty())
+                            break;
+
+                        pending = std::move(g_pending_controllers.front());
+                        g_pending_controllers.erase(g_pending_controllers.begin());
+                    }
+
+                    InitializeController(&pending);
+                    ReleaseController(std::move(pending.controller));
+                }
+            }
+        }
+
+        void VirtualReportThreadFunc(void *) {
+            while (true) {
+                bool active;
+                {
+                    std::scoped_lock lk(g_virtual_lock);
+
+                    // Virtual controllers take their state from shared memory rather than the report they are handed
+                    for (auto &controller : g_virtual_controllers)
+                        controller->HandleIncomingReport(nullptr);
+
+                    active = !g_virtual_controllers.empty();
+                }
+
+                if (active)
+                    os::SleepThread(VirtualReportInterval);
+                else
+                    g_virtual_event.Wait();
+            }
+        }
+
+        // Register the controller straight away so that incoming reports can be passed on in a neutral state.
+        // Loading its profile and setting up the virtual spi flash is left to the attach thread.
+        void RegisterController(std::shared_ptr<SwitchController> controller, ControllerType type) {
+            {
+                std::scoped_lock lk(g_controller_lock);
+                g_controllers.push_back(controller);
+            }
+
+            {
+                std::scoped_lock lk(g_pending_lock);
+                g_pending_controllers.push_back({std::move(controller), type});
+            }
+
+            g_pending_event.Signal();
+        }
+
+    }
+
+    Result Initialize(void) {
+        ams::mitm::PaintThreadStack("attach", g_attach_thread_stack, sizeof(g_attach_thread_stack));
+        R_TRY(os::CreateThread(&g_attach_thread,
+            AttachThreadFunc,
+            nullptr,
+            g_attach_thread_stack,
+            sizeof(g_attach_thread_stack),
+            AttachThreadPriority
+        ));
+
+        ams::mitm::PaintThreadStack("virtual_report", g_virtual_report_thread_stack, sizeof(g_virtual_report_thread_stack));
+
+        R_TRY(os::CreateThread(&g_virtual_report_thread,
+            VirtualReportThreadFunc,
+            nullptr,
+            g_virtual_report_thread_stack,
+            sizeof(g_virtual_report_thread_stack),
+            VirtualReportThreadPriority
+        ));
+
+        os::StartThread(&g_attach_thread);
+        os::StartThread(&g_virtual_report_thread);
+
+        return ams::ResultSuccess();
     }
 
     ControllerType Identify(const bluetooth::DevicesSettings *device) {
@@ -199,97 +390,104 @@ namespace ams::controller {
     }
 
     void AttachHandler(const bluetooth::Address *address) {
-        std::scoped_lock lk(g_controller_lock);
-
         bluetooth::DevicesSettings device_settings;
         R_ABORT_UNLESS(btdrvGetPairedDeviceInfo(*address, &device_settings));
 
         HardwareID id = { device_settings.vid, device_settings.pid };
+        ControllerType type = Identify(&device_settings);
 
-        switch (Identify(&device_settings)) {
+        std::shared_ptr<SwitchController> controller;
+        switch (type) {
             case ControllerType_Switch:
-                g_controllers.push_back(std::make_unique<SwitchController>(address, id));
+                controller = std::make_shared<SwitchController>(address, id);
                 break;
             case ControllerType_Wii:
-                g_controllers.push_back(std::make_unique<WiiController>(address, id));
+                controller = std::make_shared<WiiController>(address, id);
                 break;
             case ControllerType_Dualshock4:
-                g_controllers.push_back(std::make_unique<Dualshock4Controller>(address, id));
+                controller = std::make_shared<Dualshock4Controller>(address, id);
                 break;
             case ControllerType_Dualsense:
-                g_controllers.push_back(std::make_unique<DualsenseController>(address, id));
+                controller = std::make_shared<DualsenseController>(address, id);
                 break;
             case ControllerType_XboxOne:
-                g_controllers.push_back(std::make_unique<XboxOneController>(address, id));
+                controller = std::make_shared<XboxOneController>(address, id);
                 break;
             case ControllerType_Ouya:
-                g_controllers.push_back(std::make_unique<OuyaController>(address, id));
+                controller = std::make_shared<OuyaController>(address, id);
                 break;
             case ControllerType_Gamestick:
-                g_controllers.push_back(std::make_unique<GamestickController>(address, id));
+                controller = std::make_shared<GamestickController>(address, id);
 				break;
             case ControllerType_Gembox:
-                g_controllers.push_back(std::make_unique<GemboxController>(address, id));
+                controller = std::make_shared<GemboxController>(address, id);
                 break;
             case ControllerType_Ipega:
-                g_controllers.push_back(std::make_unique<IpegaController>(address, id));
+                controller = std::make_shared<IpegaController>(address, id);
 				break;
             case ControllerType_Xiaomi:
-                g_controllers.push_back(std::make_unique<XiaomiController>(address, id));
+                controller = std::make_shared<XiaomiController>(address, id);
                 break;
             case ControllerType_Gamesir:
-                g_controllers.push_back(std::make_unique<GamesirController>(address, id));
+                controller = std::make_shared<GamesirController>(address, id);
 				break;
             case ControllerType_Steelseries:
-                g_controllers.push_back(std::make_unique<SteelseriesController>(address, id));
+                controller = std::make_shared<SteelseriesController>(address, id);
                 break;
             case ControllerType_NvidiaShield:
-                g_controllers.push_back(std::make_unique<NvidiaShieldController>(address, id));
+                controller = std::make_shared<NvidiaShieldController>(address, id);
 				break;
             case ControllerType_8BitDo:
-                g_controllers.push_back(std::make_unique<EightBitDoController>(address, id));
+                controller = std::make_shared<EightBitDoController>(address, id);
                 break;
             case ControllerType_PowerA:
-                g_controllers.push_back(std::make_unique<PowerAController>(address, id));
+                controller = std::make_shared<PowerAController>(address, id);
                 break;
             case ControllerType_MadCatz:
-                g_controllers.push_back(std::make_unique<MadCatzController>(address, id));
+                controller = std::make_shared<MadCatzController>(address, id);
                 break;
             case ControllerType_Mocute:
-                g_controllers.push_back(std::make_unique<MocuteController>(address, id));
+                controller = std::make_shared<MocuteController>(address, id);
                 break;
             case ControllerType_Razer:
-                g_controllers.push_back(std::make_unique<RazerController>(address, id));
+                controller = std::make_shared<RazerController>(address, id);
                 break;
             case ControllerType_ICade:
-                g_controllers.push_back(std::make_unique<ICadeController>(address, id));
+                controller = std::make_shared<ICadeController>(address, id);
                 break;
 			case ControllerType_LanShen:
-                g_controllers.push_back(std::make_unique<LanShenController>(address, id));
+                controller = std::make_shared<LanShenController>(address, id);
                 break;
             case ControllerType_AtGames:
-                g_controllers.push_back(std::make_unique<AtGamesController>(address, id));
+                controller = std::make_shared<AtGamesController>(address, id);
                 break;
             case ControllerType_Hyperkin:
-                g_controllers.push_back(std::make_unique<HyperkinController>(address, id));
+                controller = std::make_shared<HyperkinController>(address, id);
                 break;
             default:
-                g_controllers.push_back(std::make_unique<UnknownController>(address, id));
+                controller = std::make_shared<UnknownController>(address, id);
                 break;
         }
 
-        R_ABORT_UNLESS(g_controllers.back()->Initialize());
+        RegisterController(std::move(controller), type);
     }
 
     void RemoveHandler(const bluetooth::Address *address) {
-        std::scoped_lock lk(g_controller_lock);
+        std::shared_ptr<SwitchController> controller;
+        {
+            std::scoped_lock lk(g_controller_lock);
 
-        for (auto it = g_controllers.begin(); it < g_controllers.end(); ++it) {
-            if (bdcmp(&(*it)->Address(), address)) {
-                g_controllers.erase(it);
-                return;
+            for (auto it = g_controllers.begin(); it < g_controllers.end(); ++it) {
+                if (bdcmp(&(*it)->Address(), address)) {
+                    controller = std::move(*it);
+                    g_controllers.erase(it);
+                    break;
+                }
             }
         }
+
+        if (controller)
+            ReleaseController(std::move(controller));
     }
 
     SwitchController *LocateHandler(const bluetooth::Address *address) {
@@ -304,4 +502,70 @@ namespace ams::controller {
         return nullptr;
     }
 
+    size_t GetReportMappingStatistics(ReportMappingStatistics *stats, size_t count) {
+        std::scoped_lock lk(g_controller_lock);
+
+        size_t total = 0;
+        for (auto it = g_controllers.begin(); (it < g_controllers.end()) && (total < count); ++it) {
+            if ((*it)->GetReportMappingStatistics(&stats[total]))
+                ++total;
+        }
+
+        return total;
+    }
+
+    Result CreateVirtualController(bluetooth::Address *address, os::NativeHandle *handle) {
+        std::scoped_lock lk(g_virtual_lock);
+
+        // Take the first free slot
+        bluetooth::Address virtual_address;
+        std::memcpy(virtual_address.address, VirtualControllerAddressPrefix, sizeof(VirtualControllerAddressPrefix));
+
+        size_t slot = 0;
+        for (; slot < MaxVirtualControllers; ++slot) {
+            virtual_address.address[sizeof(VirtualControllerAddressPrefix)] = slot;
+            if (!LocateHandler(&virtual_address))
+                break;
+        }
+
+        if (slot == MaxVirtualControllers)
+            return -1;
+
+        auto controller = std::make_shared<VirtualController>(&virtual_address);
+        R_TRY(controller->InitializeStateRing());
+
+        g_virtual_controllers.push_back(controller);
+
+        *address = virtual_address;
+        *handle = controller->GetSharedMemoryHandle();
+
+        RegisterController(std::move(controller), ControllerType_Virtual);
+        g_virtual_event.Signal();
+
+        return ams::ResultSuccess();
+    }
+
+    Result DestroyVirtualController(const bluetooth::Address *address) {
+        std::shared_ptr<VirtualController> controller;
+        {
+            std::scoped_lock lk(g_virtual_lock);
+
+            for (auto it = g_virtual_controllers.begin(); it < g_virtual_controllers.end(); ++it) {
+                if (bdcmp(&(*it)->Address(), address)) {
+                    controller = std::move(*it);
+                    g_virtual_controllers.erase(it);
+                    break;
+                }
+            }
+        }
+
+        if (!controller)
+            return -1;
+
+        RemoveHandler(address);
+        ReleaseController(std::move(controller));
+
+        return ams::ResultSuccess();
+    }
+
 }
@@ -39,6 +39,8 @@
 #include "lanshen_controller.hpp"
 #include "atgames_controller.hpp"
 #include "hyperkin_controller.hpp"
+#include "virtual_controller.hpp"
+#include "unknown_controller.hpp"
 
 namespace ams::controller {
 
@@ -69,22 +71,23 @@ namespace ams::controller {
         ControllerType_AtGames,
         ControllerType_Hyperkin,
         ControllerType_Unknown,
-    };
-
-    class UnknownController : public EmulatedSwitchController {
-        public:
-            UnknownController(const bluetooth::Address *address, HardwareID id)
-            : EmulatedSwitchController(address, id) {
-                m_colours.buttons = {0xff, 0x00, 0x00};
-            };
+        ControllerType_Virtual,
     };
 
     ControllerType Identify(const bluetooth::DevicesSettings *device);
     bool IsAllowedDeviceClass(const bluetooth::DeviceClass *cod);
     bool IsOfficialSwitchControllerName(const std::string& name);
 
+    Result Initialize(void);
+
     void AttachHandler(const bluetooth::Address *address);
     void RemoveHandler(const bluetooth::Address *address);
     SwitchController *LocateHandler(const bluetooth::Address *address);
 
+    // Returns the number of entries written, one per connected controller whose reports we map
+    size_t GetReportMappingStatistics(ReportMappingStatistics *stats, size_t count);
+
+    Result CreateVirtualController(bluetooth::Address *address, os::NativeHandle *handle);
+    Result DestroyVirtualController(const bluetooth::Address *address);
+
 }
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "controller_profile.hpp"
+#include "switch_controller.hpp"
+#include "../mcmitm_io.hpp"
+#include <string>
+
+namespace ams::controller {
+
+    namespace {
+
+        std::string GetControllerProfilePath(const bluetooth::Address *address) {
+            return GetControllerDirectory(address) + "/profile.bin";
+        }
+
+        struct ProfileRequest {
+            bluetooth::Address address;
+            ControllerProfile profile;
+        };
+
+        Result ReadControllerProfile(const bluetooth::Address *address, ControllerProfile *profile) {
+            std::string path = GetControllerProfilePath(address);
+
+            fs::FileHandle file;
+            R_TRY(fs::OpenFile(std::addressof(file), path.c_str(), fs::OpenMode_Read));
+            ON_SCOPE_EXIT { fs::CloseFile(file); };
+
+            R_TRY(fs::ReadFile(file, 0, profile, sizeof(ControllerProfile)));
+
+            if ((profile->magic != ControllerProfileMagic) || (profile->version != ControllerProfileVersion))
+                return -1;
+
+            return ams::ResultSuccess();
+        }
+
+        Result WriteControllerProfile(const bluetooth::Address *address, const ControllerProfile *profile) {
+            std::string path = GetControllerProfilePath(address);
+
+            bool file_exists;
+            R_TRY(fs::HasFile(&file_exists, path.c_str()));
+            if (!file_exists) {
+                R_TRY(fs::CreateFile(path.c_str(), sizeof(ControllerProfile)));
+            }
+
+            fs::FileHandle file;
+            R_TRY(fs::OpenFile(std::addressof(file), path.c_str(), fs::OpenMode_Write));
+            ON_SCOPE_EXIT { fs::CloseFile(file); };
+
+            return fs::WriteFile(file, 0, profile, sizeof(ControllerProfile), fs::WriteOption::Flush);
+        }
+
+        Result LoadProfileFunction(void *data) {
+            auto request = reinterpret_cast<ProfileRequest *>(data);
+            return ReadControllerProfile(&request->address, &request->profile);
+        }
+
+        Result SaveProfileFunction(void *data) {
+            auto request = reinterpret_cast<ProfileRequest *>(data);
+            return WriteControllerProfile(&request->address, &request->profile);
+        }
+
+    }
+
+    void InitializeControllerProfile(ControllerProfile *profile, uint8_t type, uint16_t vid, uint16_t pid) {
+        std::memset(profile, 0, sizeof(ControllerProfile));
+        profile->magic   = ControllerProfileMagic;
+        profile->version = ControllerProfileVersion;
+        profile->type    = type;
+        profile->vid     = vid;
+        profile->pid     = pid;
+    }
+
+    Result LoadControllerProfile(const bluetooth::Address *address, ControllerProfile *profile) {
+        ProfileRequest request = { *address, {} };
+        R_TRY(mitm::io::Execute(LoadProfileFunction, &request));
+
+        *profile = request.profile;
+        return ams::ResultSuccess();
+    }
+
+    Result SaveControllerProfile(const bluetooth::Address *address, const ControllerProfile *profile) {
+        // Saved in the background. Nothing waits on the result.
+        const ProfileRequest request = { *address, *profile };
+        if (!mitm::io::Submit(SaveProfileFunction, nullptr, &request, sizeof(request)))
+            return -1;
+
+        return ams::ResultSuccess();
+    }
+
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+#include "../bluetooth_mitm/bluetooth/bluetooth_types.hpp"
+
+namespace ams::controller {
+
+    constexpr uint32_t ControllerProfileMagic   = 0x4650434d;   // "MCPF"
+    constexpr uint8_t  ControllerProfileVersion = 1;
+
+    enum ControllerProfileFlags : uint16_t {
+        ControllerProfileFlag_VirtualSpiFlash = (1 << 0),   // Virtual SPI flash exists and is up to date
+        ControllerProfileFlag_Extension       = (1 << 1),   // extension and report_mode hold the last identified extension
+        ControllerProfileFlag_Calibration     = (1 << 2),   // calibration holds data read from the controller
+    };
+
+    // Last known-good state of a controller, kept alongside its other files so that reconnects can skip straight to it.
+    // Everything here is revalidated once the controller is up and running, and rewritten only when it changes.
+    struct ControllerProfile {
+        uint32_t magic;
+        uint8_t  version;
+        uint8_t  type;
+        uint16_t flags;
+        uint16_t vid;
+        uint16_t pid;
+        uint8_t  extension;
+        uint8_t  report_mode;
+        uint8_t  _reserved[2];
+        uint8_t  calibration[24];
+    } __attribute__ ((__packed__));
+
+    static_assert(sizeof(ControllerProfile) == 40);
+
+    void InitializeControllerProfile(ControllerProfile *profile, uint8_t type, uint16_t vid, uint16_t pid);
+    Result LoadControllerProfile(const bluetooth::Address *address, ControllerProfile *profile);
+    Result SaveControllerProfile(const bluetooth::Address *address, const ControllerProfile *profile);
+
+}
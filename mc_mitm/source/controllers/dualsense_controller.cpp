@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "dualsense_controller.hpp"
+#include "report_view.hpp"
 #include "../mcmitm_config.hpp"
 #include <stratosphere.hpp>
 
@@ -23,6 +24,9 @@ namespace ams::controller {
 
         const constexpr float stick_scale_factor = float(UINT12_MAX) / UINT8_MAX;
 
+        constexpr int32_t accel_scale_factor = AccelScaleFactor(8192);
+        constexpr int32_t gyro_scale_factor  = GyroScaleFactor(16);
+
         const uint8_t player_led_flags[] = {
             // Mimic the Switch's player LEDs
             0x01,
@@ -90,10 +94,12 @@ namespace ams::controller {
 
         switch(dualsense_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(dualsense_report);
+                if (auto src = GetReportView<DualsenseReportData, DualsenseInputReport0x01>(report))
+                    this->HandleInputReport0x01(src);
                 break;
             case 0x31:
-                this->HandleInputReport0x31(dualsense_report);
+                if (auto src = GetReportView<DualsenseReportData, DualsenseInputReport0x31>(report))
+                    this->HandleInputReport0x31(src);
                 break;
             default:
                 break;
@@ -139,6 +145,10 @@ namespace ams::controller {
         );
 
         this->MapButtons(&src->input0x31.buttons);
+
+        if (m_enable_motion) {
+            this->MapMotionData(&src->input0x31);
+        }
     }
 
     void DualsenseController::MapButtons(const DualsenseButtonData *buttons) {
@@ -175,6 +185,23 @@ namespace ams::controller {
         m_buttons.home    = buttons->ps;
     }
 
+    void DualsenseController::MapMotionData(const DualsenseInputReport0x31 *src) {
+        // Sensor timestamp is a free-running 32-bit counter in units of 1/3us
+        m_sensor_ticks += static_cast<uint32_t>(src->sensor_timestamp - m_sensor_timestamp);
+        m_sensor_timestamp = src->sensor_timestamp;
+
+        const Switch6AxisData sample = {
+            .accel_x = ScaleMotionValue(-src->acc_z, accel_scale_factor),
+            .accel_y = ScaleMotionValue(-src->acc_x, accel_scale_factor),
+            .accel_z = ScaleMotionValue( src->acc_y, accel_scale_factor),
+            .gyro_1  = ScaleMotionValue(-src->vel_z, gyro_scale_factor),
+            .gyro_2  = ScaleMotionValue(-src->vel_x, gyro_scale_factor),
+            .gyro_3  = ScaleMotionValue( src->vel_y, gyro_scale_factor)
+        };
+
+        this->PushMotionSample(os::ConvertToTick(TimeSpan::FromMicroSeconds(m_sensor_ticks / 3)), &sample);
+    }
+
     Result DualsenseController::PushRumbleLedState(void) {
         DualsenseOutputReport0x31 report = {0xa2, 0x31, 0x02, 0x03, 0x14, m_rumble_state.amp_motor_right, m_rumble_state.amp_motor_left};
         report.data[41] = 0x02;
@@ -75,6 +75,7 @@ namespace ams::controller {
         uint8_t                 left_trigger;
         uint8_t                 right_trigger;
     } __attribute__((packed));
+    static_assert(sizeof(DualsenseInputReport0x01) == 0x09);
 
     struct DualsenseInputReport0x31 {
         uint8_t                 _unk0;
@@ -85,19 +86,21 @@ namespace ams::controller {
         uint8_t                 counter;
         DualsenseButtonData     buttons;
         uint8_t                 _unk1[5];
-        uint16_t                vel_x;
-        uint16_t                vel_y;
-        uint16_t                vel_z;
-        uint16_t                acc_x;
-        uint16_t                acc_y;
-        uint16_t                acc_z;
-        uint8_t                 _unk2[25];
+        int16_t                 vel_x;
+        int16_t                 vel_y;
+        int16_t                 vel_z;
+        int16_t                 acc_x;
+        int16_t                 acc_y;
+        int16_t                 acc_z;
+        uint32_t                sensor_timestamp;
+        uint8_t                 _unk2[21];
 
         uint8_t battery_level    : 4;
         uint8_t usb              : 1;
         uint8_t full             : 1;
         uint8_t                  : 0;
     } __attribute__((packed));
+    static_assert(sizeof(DualsenseInputReport0x31) == 0x36);
 
     struct DualsenseReportData {
         uint8_t id;
@@ -118,7 +121,9 @@ namespace ams::controller {
             : EmulatedSwitchController(address, id)
             , m_led_flags(0)
             , m_led_colour({0, 0, 0})
-            , m_rumble_state({0, 0}) { }
+            , m_rumble_state({0, 0})
+            , m_sensor_timestamp(0)
+            , m_sensor_ticks(0) { }
 
             Result Initialize(void);
             Result SetVibration(const SwitchRumbleData *rumble_data);
@@ -133,12 +138,16 @@ namespace ams::controller {
             void HandleInputReport0x31(const DualsenseReportData *src);
 
             void MapButtons(const DualsenseButtonData *buttons);
+            void MapMotionData(const DualsenseInputReport0x31 *src);
 
             Result PushRumbleLedState(void);
 
             uint8_t m_led_flags;
             RGBColour m_led_colour;
-            DualsenseRumbleData m_rumble_state; 
+            DualsenseRumbleData m_rumble_state;
+
+            uint32_t m_sensor_timestamp;
+            uint64_t m_sensor_ticks;
     };
 
 }
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "dualshock4_controller.hpp"
+#include "report_view.hpp"
 #include "../mcmitm_config.hpp"
 #include <switch.h>
 #include <stratosphere.hpp>
@@ -25,6 +26,9 @@ namespace ams::controller {
 
         const constexpr float stick_scale_factor = float(UINT12_MAX) / UINT8_MAX;
 
+        constexpr int32_t accel_scale_factor = AccelScaleFactor(8192);
+        constexpr int32_t gyro_scale_factor  = GyroScaleFactor(16);
+
         const constexpr RGBColour led_disable = {0x00, 0x00, 0x00};
 
         const RGBColour player_led_colours[] = {
@@ -79,10 +83,12 @@ namespace ams::controller {
 
         switch(ds4_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(ds4_report);
+                if (auto src = GetReportView<Dualshock4ReportData, Dualshock4InputReport0x01>(report))
+                    this->HandleInputReport0x01(src);
                 break;
             case 0x11:
-                this->HandleInputReport0x11(ds4_report);
+                if (auto src = GetReportView<Dualshock4ReportData, Dualshock4InputReport0x11>(report))
+                    this->HandleInputReport0x11(src);
                 break;
             default:
                 break;
@@ -128,6 +134,10 @@ namespace ams::controller {
         );
 
         this->MapButtons(&src->input0x11.buttons);
+
+        if (m_enable_motion) {
+            this->MapMotionData(&src->input0x11);
+        }
     }
 
     void Dualshock4Controller::MapButtons(const Dualshock4ButtonData *buttons) {
@@ -164,6 +174,23 @@ namespace ams::controller {
         m_buttons.home    = buttons->ps;
     }
 
+    void Dualshock4Controller::MapMotionData(const Dualshock4InputReport0x11 *src) {
+        // Sensor timestamp is a free-running 16-bit counter in units of 16/3us
+        m_sensor_ticks += static_cast<uint16_t>(src->timestamp - m_sensor_timestamp);
+        m_sensor_timestamp = src->timestamp;
+
+        const Switch6AxisData sample = {
+            .accel_x = ScaleMotionValue(-src->acc_z, accel_scale_factor),
+            .accel_y = ScaleMotionValue(-src->acc_x, accel_scale_factor),
+            .accel_z = ScaleMotionValue( src->acc_y, accel_scale_factor),
+            .gyro_1  = ScaleMotionValue(-src->vel_z, gyro_scale_factor),
+            .gyro_2  = ScaleMotionValue(-src->vel_x, gyro_scale_factor),
+            .gyro_3  = ScaleMotionValue( src->vel_y, gyro_scale_factor)
+        };
+
+        this->PushMotionSample(os::ConvertToTick(TimeSpan::FromMicroSeconds(m_sensor_ticks * 16 / 3)), &sample);
+    }
+
     Result Dualshock4Controller::PushRumbleLedState(void) {
         Dualshock4OutputReport0x11 report = {0xa2, 0x11, static_cast<uint8_t>(0xc0 | (m_report_rate & 0xff)), 0x20, 0xf3, 0x04, 0x00,
             m_rumble_state.amp_motor_right, m_rumble_state.amp_motor_left,
@@ -101,6 +101,7 @@ namespace ams::controller {
         uint8_t                 left_trigger;
         uint8_t                 right_trigger;
     } __attribute__((packed));
+    static_assert(sizeof(Dualshock4InputReport0x01) == 0x09);
 
     struct Dualshock4InputReport0x11 {
         uint8_t                 _unk0[2];
@@ -111,12 +112,12 @@ namespace ams::controller {
         uint8_t                 right_trigger;
         uint16_t                timestamp;
         uint8_t                 battery;
-        uint16_t                vel_x;
-        uint16_t                vel_y;
-        uint16_t                vel_z;
-        uint16_t                acc_x;
-        uint16_t                acc_y;
-        uint16_t                acc_z;
+        int16_t                 vel_x;
+        int16_t                 vel_y;
+        int16_t                 vel_z;
+        int16_t                 acc_x;
+        int16_t                 acc_y;
+        int16_t                 acc_z;
         uint8_t                 _unk1[5];
 
         uint8_t battery_level    : 4;
@@ -129,6 +130,12 @@ namespace ams::controller {
         uint8_t  tpad_packets;
         uint8_t  packet_counter;
     } __attribute__((packed));
+    static_assert(sizeof(Dualshock4InputReport0x11) == 0x24);
+    static_assert(offsetof(Dualshock4InputReport0x11, left_stick) == 0x02);
+    static_assert(offsetof(Dualshock4InputReport0x11, buttons) == 0x06);
+    static_assert(offsetof(Dualshock4InputReport0x11, battery) == 0x0d);
+    static_assert(offsetof(Dualshock4InputReport0x11, vel_x) == 0x0e);
+    static_assert(offsetof(Dualshock4InputReport0x11, acc_x) == 0x14);
 
     struct Dualshock4ReportData {
         uint8_t id;
@@ -153,7 +160,9 @@ namespace ams::controller {
             : EmulatedSwitchController(address, id)
             , m_report_rate(Dualshock4ReportRate_125Hz)
             , m_led_colour({0, 0, 0})
-            , m_rumble_state({0, 0}) { }
+            , m_rumble_state({0, 0})
+            , m_sensor_timestamp(0)
+            , m_sensor_ticks(0) { }
 
             Result Initialize(void);
             Result SetVibration(const SwitchRumbleData *rumble_data);
@@ -168,12 +177,16 @@ namespace ams::controller {
             void HandleInputReport0x11(const Dualshock4ReportData *src);
 
             void MapButtons(const Dualshock4ButtonData *buttons);
-            
+            void MapMotionData(const Dualshock4InputReport0x11 *src);
+
             Result PushRumbleLedState(void);
 
             Dualshock4ReportRate m_report_rate;
             RGBColour m_led_colour; 
             Dualshock4RumbleData m_rumble_state;
+
+            uint16_t m_sensor_timestamp;
+            uint64_t m_sensor_ticks;
     };
 
 }
@@ -16,19 +16,35 @@
 #include "emulated_switch_controller.hpp"
 #include "../utils.hpp"
 #include "../mcmitm_config.hpp"
+#include "../mcmitm_io.hpp"
+#include "../mcmitm_trace.hpp"
+#include "report_view.hpp"
 #include <memory>
 
 namespace ams::controller {
 
     namespace {
 
+        // Size of the region of spi flash we emulate, and the granularity it is erased in
+        constexpr size_t spi_flash_size        = 0x10000;
+        constexpr size_t spi_flash_sector_size = 0x1000;
+
         // Factory calibration data representing analog stick ranges that span the entire 12-bit data type in x and y
         SwitchAnalogStickFactoryCalibration lstick_factory_calib = {0xff, 0xf7, 0x7f, 0x00, 0x08, 0x80, 0x00, 0x08, 0x80};
         SwitchAnalogStickFactoryCalibration rstick_factory_calib = {0x00, 0x08, 0x80, 0x00, 0x08, 0x80, 0xff, 0xf7, 0x7f};
 
+        // 6-axis horizontal offsets read from an official Pro Controller
+        const uint8_t motion_horizontal_offsets[] = {0x50, 0xfd, 0x00, 0x00, 0xc6, 0x0f};
+
         // Stick parameters data that produce a 12.5% inner deadzone and a 5% outer deadzone (in relation to the full 12 bit range above)
         SwitchAnalogStickParameters default_stick_params = {0x0f, 0x30, 0x61, 0x00, 0x31, 0xf3, 0xd4, 0x14, 0x54, 0x41, 0x15, 0x54, 0xc7, 0x79, 0x9c, 0x33, 0x36, 0x63};
 
+        // As above, but with no inner or outer deadzone. Used for sticks we shape ourselves so the console doesn't apply its deadzones on top.
+        SwitchAnalogStickParameters neutral_stick_params = {0x0f, 0x30, 0x61, 0x00, 0xf0, 0xff, 0xd4, 0x14, 0x54, 0x41, 0x15, 0x54, 0xc7, 0x79, 0x9c, 0x33, 0x36, 0x63};
+
+        constexpr uint32_t lstick_parameters_address = 0x6086;
+        constexpr uint32_t rstick_parameters_address = 0x6098;
+
         // Frequency in Hz rounded to nearest int
         // https://github.com/dekuNukem/Nintendo_Switch_Reverse_Engineering/blob/master/rumble_data_table.md#frequency-table
         const uint16_t rumble_freq_lut[] = {
@@ -96,6 +112,11 @@ namespace ams::controller {
             return ams::ResultSuccess();
         }
 
+        // Flash addresses come straight from the console's output reports, so accesses are checked against the emulated region before reaching the file
+        bool IsValidSpiFlashRange(uint32_t address, size_t size) {
+            return (address < spi_flash_size) && (size <= spi_flash_size - address);
+        }
+
         Result InitializeVirtualSpiFlash(const char *path, size_t size) {
             fs::FileHandle file;
 
@@ -121,6 +142,8 @@ namespace ams::controller {
             } data1 = { lstick_factory_calib, rstick_factory_calib };
             R_TRY(fs::WriteFile(file, 0x603d, &data1, sizeof(data1), fs::WriteOption::None));
 
+            R_TRY(fs::WriteFile(file, 0x6020, &motion_factory_calib, sizeof(motion_factory_calib), fs::WriteOption::None));
+
             const struct {
                 RGBColour body;
                 RGBColour buttons;
@@ -133,7 +156,8 @@ namespace ams::controller {
                 SwitchAnalogStickParameters lstick_default_parameters;
                 SwitchAnalogStickParameters rstick_default_parameters;
             } data3 = { default_stick_params, default_stick_params };
-            R_TRY(fs::WriteFile(file, 0x6086, &data3, sizeof(data3), fs::WriteOption::None));
+            R_TRY(fs::WriteFile(file, 0x6080, motion_horizontal_offsets, sizeof(motion_horizontal_offsets), fs::WriteOption::None));
+            R_TRY(fs::WriteFile(file, lstick_parameters_address, &data3, sizeof(data3), fs::WriteOption::None));
 
             R_TRY(fs::FlushFile(file));
 
@@ -142,12 +166,56 @@ namespace ams::controller {
 
     }
 
+    // Largest transfers that fit within a single subcommand or its response
+    constexpr size_t spi_flash_read_max_size  = sizeof(SwitchSubcommandResponse::data) - sizeof(uint32_t) - sizeof(uint8_t);
+    constexpr size_t spi_flash_write_max_size = sizeof(SwitchSubcommand::data) - sizeof(uint32_t) - sizeof(uint8_t);
+
+    // Subcommand arguments follow the report id, the output0x01 header and the subcommand id
+    constexpr size_t subcmd_args_offset = sizeof(uint8_t) + offsetof(SwitchOutputReport0x01, subcmd) + sizeof(uint8_t);
+
+    namespace {
+
+        // The subcommand as far as the report goes. Arguments missing from a truncated report read as zero, so handlers never look past its end.
+        SwitchSubcommand GetSubCmd(const bluetooth::HidReport *report) {
+            constexpr size_t subcmd_offset = subcmd_args_offset - sizeof(uint8_t);
+
+            SwitchSubcommand subcmd = {};
+            std::memcpy(&subcmd, report->data + subcmd_offset, std::min(report->size - subcmd_offset, sizeof(subcmd)));
+            return subcmd;
+        }
+
+    }
+
+    // Virtual spi flash accesses requested by the console are queued to the I/O thread and answered from there once complete
+    struct EmulatedSwitchController::SpiFlashReadRequest {
+        EmulatedSwitchController *controller;
+        SwitchSubcommandResponse response;
+    };
+
+    struct EmulatedSwitchController::SpiFlashWriteRequest {
+        EmulatedSwitchController *controller;
+        uint32_t address;
+        uint8_t size;
+        uint8_t data[spi_flash_write_max_size];
+    };
+
+    struct EmulatedSwitchController::SpiSectorEraseRequest {
+        EmulatedSwitchController *controller;
+        uint32_t address;
+        SubCmdType id;
+    };
+
     EmulatedSwitchController::EmulatedSwitchController(const bluetooth::Address *address, HardwareID id)
     : SwitchController(address, id)
     , m_charging(false)
     , m_ext_power(false)
     , m_battery(BATTERY_MAX)
-    , m_led_pattern(0) {
+    , m_led_pattern(0)
+    , m_motion_reset_pending(false)
+    , m_ready(false)
+    , m_mapped_report_count(0)
+    , m_mapping_ticks_total(0)
+    , m_mapping_ticks_max(0) {
         this->ClearControllerState();
 
         m_colours.body       = {0x32, 0x32, 0x32};
@@ -158,6 +226,7 @@ namespace ams::controller {
         auto config = mitm::GetGlobalConfig();
 
         m_enable_rumble = config->general.enable_rumble;
+        m_enable_motion = config->general.enable_motion;
     };
 
     EmulatedSwitchController::~EmulatedSwitchController() {
@@ -167,8 +236,29 @@ namespace ams::controller {
     Result EmulatedSwitchController::Initialize(void) {
         SwitchController::Initialize();
 
-        // Ensure config directory for this controller exists
+        return mitm::io::Execute(InitializeStorageFunction, this);
+    }
+
+    Result EmulatedSwitchController::InitializeStorage(void) {
+        // Stick shaping is optional. Without a sticks.ini the console's own deadzones from the virtual spi flash are all that apply.
+        // Sticks that are shaped have those deadzones removed from the flash instead, so the two don't stack.
+        StickShapingConfig left_stick_config, right_stick_config;
+        if (R_SUCCEEDED(LoadStickShapingConfig(&m_address, &left_stick_config, &right_stick_config))) {
+            m_left_stick_shaper.Configure(&left_stick_config);
+            m_right_stick_shaper.Configure(&right_stick_config);
+        }
+
+        // Likewise for combos.ini, without which the driver's own combos stay in place
+        LoadButtonCombos(&m_address, &m_button_combos);
+
+        // A profile from a previous connection means the controller directory and virtual spi flash have already been set up
         std::string path = GetControllerDirectory(&m_address);
+        if (m_profile.flags & ControllerProfileFlag_VirtualSpiFlash) {
+            if (R_SUCCEEDED(fs::OpenFile(std::addressof(m_spi_flash_file), (path + "/spi_flash.bin").c_str(), fs::OpenMode_ReadWrite)))
+                return this->EnsureStickParameters();
+        }
+
+        // Ensure config directory for this controller exists
         R_TRY(fs::EnsureDirectoryRecursively(path.c_str()));
 
         // Check if the virtual spi flash file already exists and initialise it if not
@@ -176,7 +266,6 @@ namespace ams::controller {
         bool file_exists;
         R_TRY(fs::HasFile(&file_exists, path.c_str()));
         if (!file_exists) {
-            auto spi_flash_size = 0x10000;
             // Create file representing first 64KB of SPI flash
             R_TRY(fs::CreateFile(path.c_str(), spi_flash_size));
 
@@ -187,6 +276,15 @@ namespace ams::controller {
         // Open the virtual spi flash file for read and write
         R_TRY(fs::OpenFile(std::addressof(m_spi_flash_file), path.c_str(), fs::OpenMode_ReadWrite));
 
+        // Flash images created by older versions don't contain the motion calibration our IMU values are scaled against
+        R_TRY(this->EnsureMotionCalibration());
+
+        R_TRY(this->EnsureStickParameters());
+
+        // Failing to save the profile only costs a slower reconnect
+        m_profile.flags |= ControllerProfileFlag_VirtualSpiFlash;
+        this->SaveProfile();
+
         return ams::ResultSuccess();
     }
 
@@ -195,10 +293,31 @@ namespace ams::controller {
         m_left_stick.SetData(STICK_ZERO, STICK_ZERO);
         m_right_stick.SetData(STICK_ZERO, STICK_ZERO);
         std::memset(&m_motion_data, 0, sizeof(m_motion_data));
+        m_motion_samples.Clear();
+    }
+
+    void EmulatedSwitchController::PushMotionSample(os::Tick tick, const Switch6AxisData *sample) {
+        if (m_enable_motion)
+            m_motion_samples.Push(tick, sample);
     }
 
     Result EmulatedSwitchController::HandleIncomingReport(const bluetooth::HidReport *report) {
-        this->UpdateControllerState(report);
+        // Until initialisation has finished on the attach thread the controller state is left cleared.
+        // Drivers switch on the report id before checking the size, so empty reports are never handed to them. Virtual controllers are handed no report at all.
+        // A motion reset requested by the console is done here, so that nothing pushed before it survives and m_motion_data isn't written from two threads.
+        if (m_motion_reset_pending.exchange(false, std::memory_order_acquire)) {
+            std::memset(&m_motion_data, 0, sizeof(m_motion_data));
+            m_motion_samples.Clear();
+        }
+
+        if (m_ready && ((report == nullptr) || (report->size > 0))) {
+            auto start_tick = os::GetSystemTick();
+            this->UpdateControllerState(report);
+            this->RecordMappingTime(os::GetSystemTick() - start_tick);
+
+            if (m_enable_motion)
+                m_motion_samples.Resample(m_motion_data);
+        }
 
         // Prepare Switch report
         m_input_report.size = sizeof(SwitchInputReport0x30) + 1;
@@ -211,21 +330,57 @@ namespace ams::controller {
         switch_report->input0x30.right_stick = m_right_stick;
         std::memcpy(&switch_report->input0x30.motion, &m_motion_data, sizeof(m_motion_data));
 
-        this->ApplyButtonCombos(&switch_report->input0x30.buttons);
+        // The shaping tables and button combos are loaded during initialisation, so can only be used once it has finished
+        if (m_ready) {
+            if (m_left_stick_shaper.IsEnabled())
+                m_left_stick_shaper.Apply(&switch_report->input0x30.left_stick);
+            if (m_right_stick_shaper.IsEnabled())
+                m_right_stick_shaper.Apply(&switch_report->input0x30.right_stick);
+
+            this->ApplyButtonCombos(&switch_report->input0x30.buttons);
+        }
 
         switch_report->input0x30.timer = os::ConvertToTimeSpan(os::GetSystemTick()).GetMilliSeconds() & 0xff;
         return bluetooth::hid::report::WriteHidReportBuffer(&m_address, &m_input_report);
     }
 
+    bool EmulatedSwitchController::GetReportMappingStatistics(ReportMappingStatistics *stats) {
+        *stats = {
+            .address = m_address,
+            .id = m_id,
+            .report_count = m_mapped_report_count.load(std::memory_order_relaxed),
+            .total_ns = static_cast<uint64_t>(os::ConvertToTimeSpan(os::Tick(m_mapping_ticks_total.load(std::memory_order_relaxed))).GetNanoSeconds()),
+            .max_ns = static_cast<uint64_t>(os::ConvertToTimeSpan(os::Tick(m_mapping_ticks_max.load(std::memory_order_relaxed))).GetNanoSeconds())
+        };
+
+        return true;
+    }
+
+    void EmulatedSwitchController::RecordMappingTime(os::Tick ticks) {
+        // There is a single writer, so plain loads and stores are enough to keep concurrent readers from seeing torn values
+        auto value = ticks.GetInt64Value();
+        m_mapped_report_count.store(m_mapped_report_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_mapping_ticks_total.store(m_mapping_ticks_total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        if (value > m_mapping_ticks_max.load(std::memory_order_relaxed))
+            m_mapping_ticks_max.store(value, std::memory_order_relaxed);
+    }
+
     Result EmulatedSwitchController::HandleOutgoingReport(const bluetooth::HidReport *report) {
+        // Subcommands can't be answered without the virtual spi flash. The console resends any that go unanswered.
+        if (!m_ready || (report->size == 0))
+            return ams::ResultSuccess();
+
         auto report_data = reinterpret_cast<const SwitchReportData *>(&report->data);
 
         switch (report_data->id) {
             case 0x01:
-                R_TRY(this->HandleSubCmdReport(report));
+                // Reports too short to carry a subcommand id are dropped. Each subcommand checks the size of its own arguments.
+                if (report->size >= subcmd_args_offset)
+                    R_TRY(this->HandleSubCmdReport(report));
                 break;
             case 0x10:
-                R_TRY(this->HandleRumbleReport(report));
+                if (GetReportView<SwitchReportData, SwitchOutputReport0x10>(report))
+                    R_TRY(this->HandleRumbleReport(report));
                 break;
             default:
                 break;
@@ -237,6 +392,8 @@ namespace ams::controller {
     Result EmulatedSwitchController::HandleSubCmdReport(const bluetooth::HidReport *report) {
         auto report_data = reinterpret_cast<const SwitchReportData *>(&report->data);
 
+        mitm::trace::RecordAddress(mitm::trace::TraceEvent_SubCmd, m_address.address, report_data->output0x01.subcmd.id);
+
         switch (report_data->output0x01.subcmd.id) {
             case SubCmd_RequestDeviceInfo:
                 R_TRY(this->SubCmdRequestDeviceInfo(report));
@@ -375,14 +532,11 @@ namespace ams::controller {
     Result EmulatedSwitchController::SubCmdResetPairingInfo(const bluetooth::HidReport *report) {
         AMS_UNUSED(report);
 
-        R_TRY(this->VirtualSpiFlashSectorErase(0x2000));
-
-        const SwitchSubcommandResponse response = {
-            .ack = 0x80,
-            .id = SubCmd_ResetPairingInfo
-        };
+        const SpiSectorEraseRequest request = { this, 0x2000, SubCmd_ResetPairingInfo };
+        if (!mitm::io::Submit(SpiSectorEraseFunction, SpiSectorEraseCallback, &request, sizeof(request)))
+            return -1;
 
-        return this->FakeSubCmdResponse(&response);
+        return ams::ResultSuccess();
     }
 
     Result EmulatedSwitchController::SubCmdSetShipPowerState(const bluetooth::HidReport *report) {
@@ -411,60 +565,173 @@ namespace ams::controller {
         // @ 0x0000603d: e6 a5 67 1a 58 78 50 56 60 1a f8 7f 20 c6 63 d5 15 5e ff 32 32 32 ff ff ff <= Analog stick factory calibration + face/button colours
         // @ 0x00006020: 64 ff 33 00 b8 01 00 40 00 40 00 40 17 00 d7 ff bd ff 3b 34 3b 34 3b 34    <= 6-Axis motion sensor Factory calibration
 
-        auto switch_report = reinterpret_cast<const SwitchReportData *>(&report->data);
-        auto read_addr = switch_report->output0x01.subcmd.spi_flash_read.address;
-        auto read_size = switch_report->output0x01.subcmd.spi_flash_read.size;
-
-        SwitchSubcommandResponse response = {
-            .ack = 0x90,
-            .id = SubCmd_SpiFlashRead,
-            .data = {
-                .spi_flash_read = {
-                    .address = read_addr,
-                    .size = read_size
+        auto subcmd = GetSubCmd(report);
+        auto args_size = report->size - subcmd_args_offset;
+        auto read_addr = subcmd.spi_flash_read.address;
+        auto read_size = subcmd.spi_flash_read.size;
+
+        SpiFlashReadRequest request = {
+            .controller = this,
+            .response = {
+                .ack = 0x90,
+                .id = SubCmd_SpiFlashRead,
+                .data = {
+                    .spi_flash_read = {
+                        .address = read_addr,
+                        .size = read_size
+                    }
                 }
             }
         };
 
-            R_TRY(this->VirtualSpiFlashRead(read_addr, response.data.spi_flash_read.data, read_size));
+        // The data is read straight into the queued response, so it can't be any larger than what the response holds
+        request.response.data.spi_flash_read.size = std::min<uint8_t>(read_size, spi_flash_read_max_size);
 
-        return this->FakeSubCmdResponse(&response);
+        // Truncated requests and reads from outside the emulated region are answered without any data
+        if ((args_size < sizeof(uint32_t) + sizeof(uint8_t)) || !IsValidSpiFlashRange(read_addr, request.response.data.spi_flash_read.size)) {
+            request.response.data.spi_flash_read.size = 0;
+            return this->FakeSubCmdResponse(&request.response);
+        }
+
+        if (!mitm::io::Submit(SpiFlashReadFunction, SpiFlashReadCallback, &request, sizeof(request)))
+            return -1;
+
+        return ams::ResultSuccess();
     }
 
     Result EmulatedSwitchController::SubCmdSpiFlashWrite(const bluetooth::HidReport *report) {
-        auto switch_report = reinterpret_cast<const SwitchReportData *>(&report->data);
-        auto write_addr = switch_report->output0x01.subcmd.spi_flash_write.address;
-        auto write_size = switch_report->output0x01.subcmd.spi_flash_write.size;
-        auto write_data = switch_report->output0x01.subcmd.spi_flash_write.data;
+        auto subcmd = GetSubCmd(report);
+        auto args_size = report->size - subcmd_args_offset;
+
+        SpiFlashWriteRequest request = {
+            .controller = this,
+            .address = subcmd.spi_flash_write.address,
+            .size = subcmd.spi_flash_write.size
+        };
+
+        // The request keeps its own copy of the data, which can't be any larger than the subcommand that carried it
+        request.size = std::min<uint8_t>(request.size, spi_flash_write_max_size);
+
+        // Reject writes whose data isn't all present in the report or that would land outside of the emulated region
+        if ((args_size < sizeof(uint32_t) + sizeof(uint8_t) + request.size) || !IsValidSpiFlashRange(request.address, request.size)) {
+            const SwitchSubcommandResponse response = {
+                .ack = 0x80,
+                .id = SubCmd_SpiFlashWrite,
+                .data = {
+                    .spi_flash_write = {
+                        .status = 1
+                    }
+                }
+            };
+
+            return this->FakeSubCmdResponse(&response);
+        }
+
+        std::memcpy(request.data, subcmd.spi_flash_write.data, request.size);
+
+        if (!mitm::io::Submit(SpiFlashWriteFunction, SpiFlashWriteCallback, &request, sizeof(request)))
+            return -1;
+
+        return ams::ResultSuccess();
+    }
+
+    Result EmulatedSwitchController::SubCmdSpiSectorErase(const bluetooth::HidReport *report) {
+        auto args_size = report->size - subcmd_args_offset;
+        auto erase_addr = GetSubCmd(report).spi_flash_sector_erase.address;
+
+        if ((args_size < sizeof(uint32_t)) || !IsValidSpiFlashRange(erase_addr, 0)) {
+            const SwitchSubcommandResponse response = {
+                .ack = 0x80,
+                .id = SubCmd_SpiSectorErase,
+                .data = {
+                    .spi_sector_erase = {
+                        .status = 1
+                    }
+                }
+            };
+
+            return this->FakeSubCmdResponse(&response);
+        }
+
+        // Erase the whole sector containing the address, as the flash itself would
+        const SpiSectorEraseRequest request = { this, static_cast<uint32_t>(erase_addr & ~(spi_flash_sector_size - 1)), SubCmd_SpiSectorErase };
+        if (!mitm::io::Submit(SpiSectorEraseFunction, SpiSectorEraseCallback, &request, sizeof(request)))
+            return -1;
+
+        return ams::ResultSuccess();
+    }
+
+    Result EmulatedSwitchController::SpiFlashReadFunction(void *data) {
+        auto request = reinterpret_cast<SpiFlashReadRequest *>(data);
+        return request->controller->VirtualSpiFlashRead(request->response.data.spi_flash_read.address,
+            request->response.data.spi_flash_read.data,
+            request->response.data.spi_flash_read.size
+        );
+    }
+
+    void EmulatedSwitchController::SpiFlashReadCallback(Result result, void *data) {
+        auto request = reinterpret_cast<SpiFlashReadRequest *>(data);
+        if (R_SUCCEEDED(result))
+            request->controller->FakeSubCmdResponse(&request->response);
+    }
+
+    Result EmulatedSwitchController::SpiFlashWriteFunction(void *data) {
+        auto request = reinterpret_cast<SpiFlashWriteRequest *>(data);
+        return request->controller->VirtualSpiFlashWrite(request->address, request->data, request->size);
+    }
+
+    void EmulatedSwitchController::SpiFlashWriteCallback(Result result, void *data) {
+        auto request = reinterpret_cast<SpiFlashWriteRequest *>(data);
 
         const SwitchSubcommandResponse response = {
             .ack = 0x80,
             .id = SubCmd_SpiFlashWrite,
             .data = {
                 .spi_flash_write = {
-                    .status = this->VirtualSpiFlashWrite(write_addr, write_data, write_size).IsFailure()
+                    .status = result.IsFailure()
                 }
             }
         };
 
-        return this->FakeSubCmdResponse(&response);
+        request->controller->FakeSubCmdResponse(&response);
     }
 
-    Result EmulatedSwitchController::SubCmdSpiSectorErase(const bluetooth::HidReport *report) {
-        auto switch_report = reinterpret_cast<const SwitchReportData *>(&report->data);
-        auto erase_addr = switch_report->output0x01.subcmd.spi_flash_sector_erase.address;
+    Result EmulatedSwitchController::SpiSectorEraseFunction(void *data) {
+        auto request = reinterpret_cast<SpiSectorEraseRequest *>(data);
+        return request->controller->VirtualSpiFlashSectorErase(request->address);
+    }
 
-        const SwitchSubcommandResponse response = {
-            .ack = 0x80,
-            .id = SubCmd_SpiSectorErase,
-            .data = {
-                .spi_sector_erase = {
-                    .status = this->VirtualSpiFlashSectorErase(erase_addr).IsFailure()
+    void EmulatedSwitchController::SpiSectorEraseCallback(Result result, void *data) {
+        auto request = reinterpret_cast<SpiSectorEraseRequest *>(data);
+
+        if (request->id == SubCmd_ResetPairingInfo) {
+            if (R_FAILED(result))
+                return;
+
+            const SwitchSubcommandResponse response = {
+                .ack = 0x80,
+                .id = SubCmd_ResetPairingInfo
+            };
+
+            request->controller->FakeSubCmdResponse(&response);
+        }
+        else {
+            const SwitchSubcommandResponse response = {
+                .ack = 0x80,
+                .id = SubCmd_SpiSectorErase,
+                .data = {
+                    .spi_sector_erase = {
+                        .status = result.IsFailure()
+                    }
                 }
-            }
-        };
+            };
 
-        return this->FakeSubCmdResponse(&response);
+            request->controller->FakeSubCmdResponse(&response);
+        }
+    }
+
+    Result EmulatedSwitchController::InitializeStorageFunction(void *data) {
+        return reinterpret_cast<EmulatedSwitchController *>(data)->InitializeStorage();
     }
 
     Result EmulatedSwitchController::SubCmd0x24(const bluetooth::HidReport *report) {
@@ -527,10 +794,11 @@ namespace ams::controller {
     }
 
     Result EmulatedSwitchController::SubCmdSetPlayerLeds(const bluetooth::HidReport *report) {
-        auto switch_report = reinterpret_cast<const SwitchReportData *>(&report->data);
-
-        m_led_pattern = switch_report->output0x01.subcmd.set_player_leds.leds;
-        R_TRY(this->SetPlayerLed(m_led_pattern));
+        // Truncated reports are acknowledged without changing anything, here and for the other single byte settings below
+        if (report->size > subcmd_args_offset) {
+            m_led_pattern = GetSubCmd(report).set_player_leds.leds;
+            R_TRY(this->SetPlayerLed(m_led_pattern));
+        }
 
         const SwitchSubcommandResponse response = {
             .ack = 0x80,
@@ -568,7 +836,11 @@ namespace ams::controller {
     }
 
     Result EmulatedSwitchController::SubCmdEnableImu(const bluetooth::HidReport *report) {
-        AMS_UNUSED(report);
+        if (report->size > subcmd_args_offset) {
+            m_enable_motion = mitm::GetGlobalConfig()->general.enable_motion && (GetSubCmd(report).enable_imu.enabled != 0);
+            if (!m_enable_motion)
+                m_motion_reset_pending.store(true, std::memory_order_release);
+        }
 
         const SwitchSubcommandResponse response = {
             .ack = 0x80,
@@ -579,9 +851,8 @@ namespace ams::controller {
     }
 
     Result EmulatedSwitchController::SubCmdEnableVibration(const bluetooth::HidReport *report) {
-        auto switch_report = reinterpret_cast<const SwitchReportData *>(&report->data);
-
-        m_enable_rumble = mitm::GetGlobalConfig()->general.enable_rumble & switch_report->output0x01.subcmd.set_vibration.enabled;
+        if (report->size > subcmd_args_offset)
+            m_enable_rumble = mitm::GetGlobalConfig()->general.enable_rumble && (GetSubCmd(report).set_vibration.enabled != 0);
 
         const SwitchSubcommandResponse response = {
             .ack = 0x80,
@@ -592,8 +863,10 @@ namespace ams::controller {
     }
 
     Result EmulatedSwitchController::FakeSubCmdResponse(const SwitchSubcommandResponse *response) {
-        m_input_report.size = sizeof(SwitchInputReport0x21) + 1;
-        auto report_data = reinterpret_cast<SwitchReportData *>(m_input_report.data);
+        // Responses are also sent from the I/O thread, so they can't share m_input_report with the input report handler
+        bluetooth::HidReport input_report;
+        input_report.size = sizeof(SwitchInputReport0x21) + 1;
+        auto report_data = reinterpret_cast<SwitchReportData *>(input_report.data);
         report_data->id = 0x21;
         report_data->input0x21.conn_info   = (0 << 1) | m_ext_power;
         report_data->input0x21.battery     = m_battery | m_charging;
@@ -605,7 +878,7 @@ namespace ams::controller {
         report_data->input0x21.timer = os::ConvertToTimeSpan(os::GetSystemTick()).GetMilliSeconds() & 0xff;
 
         //Write a fake response into the report buffer
-        return bluetooth::hid::report::WriteHidReportBuffer(&m_address, &m_input_report);
+        return bluetooth::hid::report::WriteHidReportBuffer(&m_address, &input_report);
     }
 
     Result EmulatedSwitchController::VirtualSpiFlashRead(int offset, void *data, size_t size) {
@@ -621,8 +894,7 @@ namespace ams::controller {
         std::memset(buff, 0xff, sizeof(buff));
 
         // Fill sector at offset with 0xff
-        unsigned int sector_size = 0x1000;
-        for (unsigned int i = 0; i < (sector_size / sizeof(buff)); ++i) {
+        for (unsigned int i = 0; i < (spi_flash_sector_size / sizeof(buff)); ++i) {
             R_TRY(fs::WriteFile(m_spi_flash_file, offset, buff, sizeof(buff), fs::WriteOption::None));
             offset += sizeof(buff);
         }
@@ -632,4 +904,37 @@ namespace ams::controller {
         return ams::ResultSuccess();
     }
 
+    Result EmulatedSwitchController::EnsureMotionCalibration(void) {
+        Switch6AxisCalibrationData calib;
+        R_TRY(this->VirtualSpiFlashRead(0x6020, &calib, sizeof(calib)));
+
+        if (std::memcmp(&calib, &motion_factory_calib, sizeof(calib)) != 0) {
+            R_TRY(this->VirtualSpiFlashWrite(0x6020, &motion_factory_calib, sizeof(motion_factory_calib)));
+        }
+
+        return ams::ResultSuccess();
+    }
+
+    Result EmulatedSwitchController::EnsureStickParameters(void) {
+        // sticks.ini can change between connections, so the parameters are brought in line with it every time
+        const struct {
+            uint32_t address;
+            const SwitchAnalogStickParameters *parameters;
+        } sticks[] = {
+            { lstick_parameters_address, m_left_stick_shaper.IsEnabled()  ? &neutral_stick_params : &default_stick_params },
+            { rstick_parameters_address, m_right_stick_shaper.IsEnabled() ? &neutral_stick_params : &default_stick_params },
+        };
+
+        for (auto &stick : sticks) {
+            SwitchAnalogStickParameters parameters;
+            R_TRY(this->VirtualSpiFlashRead(stick.address, &parameters, sizeof(parameters)));
+
+            if (std::memcmp(&parameters, stick.parameters, sizeof(parameters)) != 0) {
+                R_TRY(this->VirtualSpiFlashWrite(stick.address, stick.parameters, sizeof(*stick.parameters)));
+            }
+        }
+
+        return ams::ResultSuccess();
+    }
+
 }
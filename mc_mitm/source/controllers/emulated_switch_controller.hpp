@@ -15,6 +15,9 @@
  */
 #pragma once
 #include "switch_controller.hpp"
+#include "switch_motion.hpp"
+#include "stick_shaping.hpp"
+#include <atomic>
 
 namespace ams::controller {
 
@@ -29,7 +32,9 @@ namespace ams::controller {
             virtual ~EmulatedSwitchController();
 
             virtual Result Initialize(void);
+            void SetReady(void) { m_ready = true; }
             bool IsOfficialController(void) { return false; }
+            bool GetReportMappingStatistics(ReportMappingStatistics *stats);
 
             Result HandleIncomingReport(const bluetooth::HidReport *report);
             Result HandleOutgoingReport(const bluetooth::HidReport *report);
@@ -41,6 +46,8 @@ namespace ams::controller {
             virtual Result CancelVibration(void) { return ams::ResultSuccess(); }
             virtual Result SetPlayerLed(uint8_t led_mask) { AMS_UNUSED(led_mask); return ams::ResultSuccess(); }
 
+            void PushMotionSample(os::Tick tick, const Switch6AxisData *sample);
+
             Result HandleSubCmdReport(const bluetooth::HidReport *report);
             Result HandleRumbleReport(const bluetooth::HidReport *report);
 
@@ -64,9 +71,13 @@ namespace ams::controller {
 
             Result FakeSubCmdResponse(const SwitchSubcommandResponse *response);
 
+            // Everything below is only ever called on the I/O thread
+            Result InitializeStorage(void);
             Result VirtualSpiFlashRead(int offset, void *data, size_t size);
             Result VirtualSpiFlashWrite(int offset, const void *data, size_t size);
             Result VirtualSpiFlashSectorErase(int offset);
+            Result EnsureMotionCalibration(void);
+            Result EnsureStickParameters(void);
 
             bool m_charging;
             bool m_ext_power;
@@ -77,11 +88,42 @@ namespace ams::controller {
             SwitchAnalogStick m_right_stick;
             Switch6AxisData m_motion_data[3];
 
+            StickShaper m_left_stick_shaper;
+            StickShaper m_right_stick_shaper;
+
+            SwitchMotionSampleBuffer m_motion_samples;
+            // Set when subcommands disable the IMU. The motion state is then cleared by the thread handling incoming reports, which owns it.
+            std::atomic<bool> m_motion_reset_pending;
+
             ProControllerColours m_colours;
             bool m_enable_rumble;
+            bool m_enable_motion;
 
             fs::FileHandle m_spi_flash_file;
 
+            // Set by the attach thread once the whole Initialize chain has finished. Reports are handled in a neutral state until then.
+            std::atomic<bool> m_ready;
+
+            // Time spent in UpdateControllerState. Only written from the thread handling incoming reports.
+            std::atomic<uint32_t> m_mapped_report_count;
+            std::atomic<int64_t> m_mapping_ticks_total;
+            std::atomic<int64_t> m_mapping_ticks_max;
+
+        private:
+            struct SpiFlashReadRequest;
+            struct SpiFlashWriteRequest;
+            struct SpiSectorEraseRequest;
+
+            void RecordMappingTime(os::Tick ticks);
+
+            static Result InitializeStorageFunction(void *data);
+            static Result SpiFlashReadFunction(void *data);
+            static void SpiFlashReadCallback(Result result, void *data);
+            static Result SpiFlashWriteFunction(void *data);
+            static void SpiFlashWriteCallback(Result result, void *data);
+            static Result SpiSectorEraseFunction(void *data);
+            static void SpiSectorEraseCallback(Result result, void *data);
+
     };
 
 }
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "gamesir_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -29,13 +30,16 @@ namespace ams::controller {
 
         switch(gamesir_report->id) {
             case 0x03:
-                this->HandleInputReport0x03(gamesir_report);
+                if (auto src = GetReportView<GamesirReportData, GamesirReport0x03>(report))
+                    this->HandleInputReport0x03(src);
                 break;
             case 0x12:
-                this->HandleInputReport0x12(gamesir_report);
+                if (auto src = GetReportView<GamesirReportData, GamesirReport0x12>(report))
+                    this->HandleInputReport0x12(src);
                 break;
             case 0xc4:
-                this->HandleInputReport0xc4(gamesir_report);
+                if (auto src = GetReportView<GamesirReportData, GamesirReport0xc4>(report))
+                    this->HandleInputReport0xc4(src);
                 break;
             default:
                 break;
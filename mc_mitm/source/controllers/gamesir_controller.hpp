@@ -77,6 +77,7 @@ namespace ams::controller {
         uint8_t right_trigger;
         uint8_t _unk[2];
     } __attribute__((packed));
+    static_assert(sizeof(GamesirReport0x03) == 0x0b);
 
     struct GamesirReport0x12 {
         uint8_t         : 3;
@@ -85,6 +86,7 @@ namespace ams::controller {
 
         uint8_t _unk[2];
     } __attribute__((packed));
+    static_assert(sizeof(GamesirReport0x12) == 0x03);
 
     struct GamesirReport0xc4 {
         GamesirStickData left_stick;
@@ -94,6 +96,7 @@ namespace ams::controller {
         GamesirButtonData buttons;
         uint8_t _unk;
     } __attribute__((packed));
+    static_assert(sizeof(GamesirReport0xc4) == 0x0a);
 
     struct GamesirReportData {
         uint8_t id;
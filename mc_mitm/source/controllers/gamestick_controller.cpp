@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "gamestick_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 #include <cstring>
 
@@ -30,10 +31,12 @@ namespace ams::controller {
 
         switch(gamestick_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(gamestick_report);
+                if (auto src = GetReportView<GamestickReportData, GamestickInputReport0x01>(report))
+                    this->HandleInputReport0x01(src);
                 break;
             case 0x03:
-                this->HandleInputReport0x03(gamestick_report);
+                if (auto src = GetReportView<GamestickReportData, GamestickInputReport0x03>(report))
+                    this->HandleInputReport0x03(src);
                 break;
             default:
                 break;
@@ -47,6 +47,7 @@ namespace ams::controller {
 
         uint8_t _unk1[6];
     } __attribute__((packed));
+    static_assert(sizeof(GamestickInputReport0x01) == 0x08);
 
     struct GamestickInputReport0x03 {
         uint8_t dpad;
@@ -73,6 +74,7 @@ namespace ams::controller {
         } buttons;
 
     } __attribute__((packed));
+    static_assert(sizeof(GamestickInputReport0x03) == 0x09);
 
     struct GamestickReportData {
         uint8_t id;
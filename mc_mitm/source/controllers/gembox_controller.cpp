@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "gembox_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -29,10 +30,12 @@ namespace ams::controller {
 
         switch(gembox_report->id) {
             case 0x02:
-                this->HandleInputReport0x02(gembox_report);
+                if (auto src = GetReportView<GemboxReportData, GemboxInputReport0x02>(report))
+                    this->HandleInputReport0x02(src);
                 break;
             case 0x07:
-                this->HandleInputReport0x07(gembox_report);
+                if (auto src = GetReportView<GemboxReportData, GemboxInputReport0x07>(report))
+                    this->HandleInputReport0x07(src);
                 break;
             default:
                 break;
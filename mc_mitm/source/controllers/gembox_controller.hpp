@@ -64,6 +64,7 @@ namespace ams::controller {
             uint8_t buttons;
         };
     } __attribute__((packed));
+    static_assert(sizeof(GemboxInputReport0x02) == 0x01);
 
     struct GemboxInputReport0x07 {
         uint8_t             dpad;
@@ -73,6 +74,7 @@ namespace ams::controller {
         uint8_t             right_trigger;
         GemboxButtonData    buttons;
     } __attribute__((packed));
+    static_assert(sizeof(GemboxInputReport0x07) == 0x09);
 
     struct GemboxReportData {
         uint8_t id;
@@ -0,0 +1,512 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "hid_report_descriptor.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace ams::controller {
+
+    namespace {
+
+        constexpr size_t MaxLocalUsages = 16;
+        constexpr size_t MaxTrackedReportIds = 8;
+
+        enum HidItemType {
+            HidItemType_Main   = 0,
+            HidItemType_Global = 1,
+            HidItemType_Local  = 2,
+        };
+
+        enum HidMainItemTag {
+            HidMainItemTag_Input = 0x8,
+        };
+
+        enum HidGlobalItemTag {
+            HidGlobalItemTag_UsagePage    = 0x0,
+            HidGlobalItemTag_LogicalMin   = 0x1,
+            HidGlobalItemTag_LogicalMax   = 0x2,
+            HidGlobalItemTag_ReportSize   = 0x7,
+            HidGlobalItemTag_ReportId     = 0x8,
+            HidGlobalItemTag_ReportCount  = 0x9,
+        };
+
+        enum HidLocalItemTag {
+            HidLocalItemTag_Usage     = 0x0,
+            HidLocalItemTag_UsageMin  = 0x1,
+            HidLocalItemTag_UsageMax  = 0x2,
+        };
+
+        enum HidUsagePage : uint16_t {
+            HidUsagePage_GenericDesktop = 0x01,
+            HidUsagePage_Simulation     = 0x02,
+            HidUsagePage_Button         = 0x09,
+            HidUsagePage_Consumer       = 0x0c,
+        };
+
+        constexpr uint8_t HidLongItemPrefix = 0xfe;
+        constexpr uint32_t HidInputFlagConstant = (1 << 0);
+        constexpr uint32_t HidInputFlagVariable = (1 << 1);
+
+        constexpr uint32_t Usage(uint16_t page, uint16_t id) {
+            return (uint32_t(page) << 16) | id;
+        }
+
+        // Button page usages laid out as on the standard (Android) bluetooth gamepad, mapped to the same physical positions on the Switch
+        constexpr uint32_t gamepad_button_masks[] = {
+            SwitchButtonMask_B,             // A
+            SwitchButtonMask_A,             // B
+            0,                              // C
+            SwitchButtonMask_Y,             // X
+            SwitchButtonMask_X,             // Y
+            0,                              // Z
+            SwitchButtonMask_L,             // L1
+            SwitchButtonMask_R,             // R1
+            SwitchButtonMask_ZL,            // L2
+            SwitchButtonMask_ZR,            // R2
+            SwitchButtonMask_Minus,         // Select
+            SwitchButtonMask_Plus,          // Start
+            SwitchButtonMask_Home,          // Mode
+            SwitchButtonMask_LStickPress,   // Left thumb
+            SwitchButtonMask_RStickPress,   // Right thumb
+            SwitchButtonMask_Capture,
+        };
+
+        // Hat switch directions clockwise from north
+        constexpr uint32_t hat_button_masks[] = {
+            SwitchButtonMask_DpadUp,
+            SwitchButtonMask_DpadUp   | SwitchButtonMask_DpadRight,
+            SwitchButtonMask_DpadRight,
+            SwitchButtonMask_DpadDown | SwitchButtonMask_DpadRight,
+            SwitchButtonMask_DpadDown,
+            SwitchButtonMask_DpadDown | SwitchButtonMask_DpadLeft,
+            SwitchButtonMask_DpadLeft,
+            SwitchButtonMask_DpadUp   | SwitchButtonMask_DpadLeft,
+        };
+
+        struct HidGlobalState {
+            uint16_t usage_page;
+            int32_t logical_min;
+            int32_t logical_max;
+            uint32_t report_size;
+            uint32_t report_count;
+            uint8_t report_id;
+        };
+
+        struct HidLocalState {
+            uint32_t usages[MaxLocalUsages];
+            size_t usage_count;
+            uint32_t usage_min;
+            uint32_t usage_max;
+        };
+
+        struct HidReportOffset {
+            uint8_t id;
+            uint16_t bit_offset;
+        };
+
+        uint32_t ReadItemData(const uint8_t *data, size_t size) {
+            uint32_t value = 0;
+            for (size_t i = 0; i < size; ++i)
+                value |= uint32_t(data[i]) << (8 * i);
+
+            return value;
+        }
+
+        int32_t SignExtend(uint32_t value, size_t size) {
+            if (size == 0 || size == 4)
+                return value;
+
+            uint32_t sign_bit = 1 << (8 * size - 1);
+            return (value ^ sign_bit) - sign_bit;
+        }
+
+        // Resolve the target of a single input value. Returns false for usages we have no use for.
+        bool MapUsage(uint32_t usage, HidReportField *field) {
+            uint16_t page = usage >> 16;
+            uint16_t id = usage & 0xffff;
+
+            if (page == HidUsagePage_Button) {
+                if ((id == 0) || (id > std::size(gamepad_button_masks)) || (gamepad_button_masks[id - 1] == 0))
+                    return false;
+
+                field->target = HidFieldTarget_Buttons;
+                field->button_mask = gamepad_button_masks[id - 1];
+                return true;
+            }
+
+            switch (usage) {
+                case Usage(HidUsagePage_GenericDesktop, 0x30): field->target = HidFieldTarget_LeftStickX;   return true;
+                case Usage(HidUsagePage_GenericDesktop, 0x31): field->target = HidFieldTarget_LeftStickY;   return true;
+                case Usage(HidUsagePage_GenericDesktop, 0x32): field->target = HidFieldTarget_RightStickX;  return true;
+                case Usage(HidUsagePage_GenericDesktop, 0x35): field->target = HidFieldTarget_RightStickY;  return true;
+                case Usage(HidUsagePage_GenericDesktop, 0x33): field->target = HidFieldTarget_LeftTrigger;  return true;
+                case Usage(HidUsagePage_GenericDesktop, 0x34): field->target = HidFieldTarget_RightTrigger; return true;
+                case Usage(HidUsagePage_GenericDesktop, 0x39): field->target = HidFieldTarget_Hat;          return true;
+                case Usage(HidUsagePage_Simulation, 0xc5):     field->target = HidFieldTarget_LeftTrigger;  return true;
+                case Usage(HidUsagePage_Simulation, 0xc4):     field->target = HidFieldTarget_RightTrigger; return true;
+                default:
+                    break;
+            }
+
+            uint32_t button_mask;
+            switch (usage) {
+                case Usage(HidUsagePage_GenericDesktop, 0x90): button_mask = SwitchButtonMask_DpadUp;    break;
+                case Usage(HidUsagePage_GenericDesktop, 0x91): button_mask = SwitchButtonMask_DpadDown;  break;
+                case Usage(HidUsagePage_GenericDesktop, 0x92): button_mask = SwitchButtonMask_DpadRight; break;
+                case Usage(HidUsagePage_GenericDesktop, 0x93): button_mask = SwitchButtonMask_DpadLeft;  break;
+                case Usage(HidUsagePage_GenericDesktop, 0x85): button_mask = SwitchButtonMask_Home;      break;
+                case Usage(HidUsagePage_Consumer, 0x040):      button_mask = SwitchButtonMask_Plus;      break;
+                case Usage(HidUsagePage_Consumer, 0x223):      button_mask = SwitchButtonMask_Home;      break;
+                case Usage(HidUsagePage_Consumer, 0x224):      button_mask = SwitchButtonMask_Minus;     break;
+                default:
+                    return false;
+            }
+
+            field->target = HidFieldTarget_Buttons;
+            field->button_mask = button_mask;
+            return true;
+        }
+
+        uint32_t GetLocalUsage(const HidLocalState *local, size_t index) {
+            if (index < local->usage_count)
+                return local->usages[index];
+
+            if ((local->usage_max >= local->usage_min) && (local->usage_max != 0))
+                return std::min(local->usage_min + uint32_t(index - local->usage_count), local->usage_max);
+
+            return local->usage_count > 0 ? local->usages[local->usage_count - 1] : 0;
+        }
+
+        HidReportPlan *GetReportPlan(HidDescriptorPlan *plan, uint8_t id) {
+            for (size_t i = 0; i < plan->report_count; ++i) {
+                if (plan->reports[i].id == id)
+                    return &plan->reports[i];
+            }
+
+            if (plan->report_count == HidPlanMaxReports)
+                return nullptr;
+
+            auto report = &plan->reports[plan->report_count++];
+            report->id = id;
+            return report;
+        }
+
+        uint16_t *GetReportOffset(HidReportOffset *offsets, size_t *count, uint8_t id) {
+            for (size_t i = 0; i < *count; ++i) {
+                if (offsets[i].id == id)
+                    return &offsets[i].bit_offset;
+            }
+
+            if (*count == MaxTrackedReportIds)
+                return nullptr;
+
+            offsets[*count] = { id, 0 };
+            return &offsets[(*count)++].bit_offset;
+        }
+
+        void CompileInputItem(HidDescriptorPlan *plan, const HidGlobalState *global, const HidLocalState *local, uint32_t flags, HidReportOffset *offsets, size_t *offset_count) {
+            auto bit_offset = GetReportOffset(offsets, offset_count, global->report_id);
+            if (bit_offset == nullptr)
+                return;
+
+            uint16_t start = *bit_offset;
+            *bit_offset = std::min<uint64_t>(start + uint64_t(global->report_size) * global->report_count, HidPlanMaxReportBits);
+
+            // Array items list the usages currently active rather than giving a value per usage, which gamepads don't use for anything we map
+            if ((flags & HidInputFlagConstant) || !(flags & HidInputFlagVariable) || (global->report_size == 0) || (global->report_size > 32))
+                return;
+
+            uint16_t id_bits = plan->uses_report_ids ? 8 : 0;
+
+            // Only values within the largest report we can be handed are looked at. This also keeps a bogus report count from stalling us here.
+            size_t available_bits = HidPlanMaxReportBits - id_bits;
+            if (start >= available_bits)
+                return;
+
+            size_t value_count = std::min<uint64_t>(global->report_count, (available_bits - start) / global->report_size);
+            if (value_count == 0)
+                return;
+
+            // Some descriptors give an unsigned logical maximum in too few bytes for it to be read as signed
+            int32_t logical_max = global->logical_max;
+            if (logical_max < global->logical_min)
+                logical_max = uint32_t(logical_max) & ((uint64_t(1) << global->report_size) - 1);
+
+            // Gamepads describe their buttons as a run of single bit values. These are decoded together as one field.
+            uint32_t first_usage = GetLocalUsage(local, 0) | (uint32_t(global->usage_page) << 16);
+            uint32_t last_usage = GetLocalUsage(local, value_count - 1) | (uint32_t(global->usage_page) << 16);
+            if ((global->report_size == 1) && (value_count > 1) && (value_count <= 32) &&
+                ((first_usage >> 16) == HidUsagePage_Button) && ((first_usage & 0xffff) != 0) && (last_usage - first_usage == value_count - 1)) {
+                auto report = GetReportPlan(plan, global->report_id);
+                if ((report == nullptr) || (report->field_count == HidPlanMaxFields))
+                    return;
+
+                auto field = &report->fields[report->field_count++];
+                field->bit_offset   = id_bits + start;
+                field->bit_size     = value_count;
+                field->target       = HidFieldTarget_ButtonRun;
+                field->first_button = (first_usage & 0xffff) - 1;
+                report->size = std::max<uint16_t>(report->size, (field->bit_offset + field->bit_size + 7) / 8);
+                return;
+            }
+
+            for (size_t i = 0; i < value_count; ++i) {
+                HidReportField field = {
+                    .bit_offset = uint16_t(id_bits + start + i * global->report_size),
+                    .bit_size   = uint8_t(global->report_size),
+                    .target     = HidFieldTarget_None,
+                    .button_mask = 0
+                };
+
+                uint32_t usage = GetLocalUsage(local, i);
+                if ((usage >> 16) == 0)
+                    usage |= uint32_t(global->usage_page) << 16;
+
+                if (!MapUsage(usage, &field))
+                    continue;
+
+                if (field.target != HidFieldTarget_Buttons) {
+                    field.logical_min = global->logical_min;
+                    field.logical_max = logical_max;
+                    if (field.logical_max <= field.logical_min)
+                        continue;
+                }
+
+                auto report = GetReportPlan(plan, global->report_id);
+                if ((report == nullptr) || (report->field_count == HidPlanMaxFields))
+                    continue;
+
+                report->fields[report->field_count++] = field;
+                report->size = std::max<uint16_t>(report->size, (field.bit_offset + field.bit_size + 7) / 8);
+            }
+        }
+
+        uint32_t ExtractBits(const uint8_t *data, uint16_t bit_offset, uint8_t bit_size) {
+            size_t first = bit_offset >> 3;
+            size_t last = (bit_offset + bit_size - 1) >> 3;
+
+            uint64_t value = 0;
+            for (size_t i = last + 1; i > first; --i)
+                value = (value << 8) | data[i - 1];
+
+            return (value >> (bit_offset & 7)) & ((uint64_t(1) << bit_size) - 1);
+        }
+
+        // Scale a value from its logical range to that of a Switch analog stick axis
+        uint16_t ScaleAxis(int32_t value, const HidReportField *field) {
+            value = std::clamp(value, field->logical_min, field->logical_max);
+            return (int64_t(value) - field->logical_min) * UINT12_MAX / (int64_t(field->logical_max) - field->logical_min);
+        }
+
+    }
+
+    Result CompileHidReportDescriptor(const uint8_t *descriptor, size_t size, HidDescriptorPlan *plan) {
+        std::memset(plan, 0, sizeof(HidDescriptorPlan));
+        plan->magic   = HidPlanMagic;
+        plan->version = HidPlanVersion;
+
+        HidGlobalState global = {};
+        HidLocalState local = {};
+        HidReportOffset offsets[MaxTrackedReportIds];
+        size_t offset_count = 0;
+
+        // Report ids apply to the whole descriptor, and change the layout of every report
+        for (size_t i = 0; i < size; ) {
+            uint8_t prefix = descriptor[i];
+            if (prefix == HidLongItemPrefix) {
+                i += (i + 1 < size) ? descriptor[i + 1] + 3 : size;
+                continue;
+            }
+
+            size_t data_size = (prefix & 0x3) == 3 ? 4 : (prefix & 0x3);
+            if ((((prefix >> 2) & 0x3) == HidItemType_Global) && ((prefix >> 4) == HidGlobalItemTag_ReportId))
+                plan->uses_report_ids = true;
+
+            i += data_size + 1;
+        }
+
+        for (size_t i = 0; i < size; ) {
+            uint8_t prefix = descriptor[i];
+            if (prefix == HidLongItemPrefix) {
+                i += (i + 1 < size) ? descriptor[i + 1] + 3 : size;
+                continue;
+            }
+
+            size_t data_size = (prefix & 0x3) == 3 ? 4 : (prefix & 0x3);
+            if (i + 1 + data_size > size)
+                break;  // Descriptors stored in the pairing database can be truncated
+
+            uint8_t type = (prefix >> 2) & 0x3;
+            uint8_t tag = prefix >> 4;
+            uint32_t data = ReadItemData(&descriptor[i + 1], data_size);
+            i += data_size + 1;
+
+            switch (type) {
+                case HidItemType_Main:
+                    if (tag == HidMainItemTag_Input)
+                        CompileInputItem(plan, &global, &local, data, offsets, &offset_count);
+
+                    std::memset(&local, 0, sizeof(local));
+                    break;
+                case HidItemType_Global:
+                    switch (tag) {
+                        case HidGlobalItemTag_UsagePage:   global.usage_page = data; break;
+                        case HidGlobalItemTag_LogicalMin:  global.logical_min = SignExtend(data, data_size); break;
+                        case HidGlobalItemTag_LogicalMax:  global.logical_max = SignExtend(data, data_size); break;
+                        case HidGlobalItemTag_ReportSize:  global.report_size = data; break;
+                        case HidGlobalItemTag_ReportId:    global.report_id = data; break;
+                        case HidGlobalItemTag_ReportCount: global.report_count = data; break;
+                        default: break;
+                    }
+                    break;
+                case HidItemType_Local:
+                    // Four byte usages carry their own usage page
+                    if (data_size < 4)
+                        data &= 0xffff;
+
+                    switch (tag) {
+                        case HidLocalItemTag_Usage:
+                            if (local.usage_count < MaxLocalUsages)
+                                local.usages[local.usage_count++] = data;
+                            break;
+                        case HidLocalItemTag_UsageMin:
+                            local.usage_min = data;
+                            break;
+                        case HidLocalItemTag_UsageMax:
+                            local.usage_max = data;
+                            break;
+                        default:
+                            break;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if ((plan->report_count == 0) || !ValidateHidDescriptorPlan(plan))
+            return -1;
+
+        return ams::ResultSuccess();
+    }
+
+    bool ValidateHidDescriptorPlan(const HidDescriptorPlan *plan) {
+        if ((plan->magic != HidPlanMagic) || (plan->version != HidPlanVersion) || (plan->report_count == 0) || (plan->report_count > HidPlanMaxReports))
+            return false;
+
+        for (size_t i = 0; i < plan->report_count; ++i) {
+            auto report = &plan->reports[i];
+            if ((report->field_count > HidPlanMaxFields) || (report->size > HidPlanMaxReportBits / 8))
+                return false;
+
+            for (size_t j = 0; j < report->field_count; ++j) {
+                auto field = &report->fields[j];
+                if ((field->bit_size == 0) || (field->bit_size > 32) || (field->bit_offset + field->bit_size > report->size * 8u))
+                    return false;
+
+                if ((field->target == HidFieldTarget_None) || (field->target > HidFieldTarget_RightTrigger))
+                    return false;
+
+                // Axes are scaled by their logical range
+                if ((field->target >= HidFieldTarget_LeftStickX) && (field->logical_max <= field->logical_min))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool DecodeHidReport(const HidDescriptorPlan *plan, const uint8_t *data, size_t size, SwitchButtonData *buttons, SwitchAnalogStick *left_stick, SwitchAnalogStick *right_stick) {
+        const HidReportPlan *report = nullptr;
+        for (size_t i = 0; i < plan->report_count; ++i) {
+            if (!plan->uses_report_ids || (size > 0 && plan->reports[i].id == data[0])) {
+                report = &plan->reports[i];
+                break;
+            }
+        }
+
+        // Checking the length once up front lets every field be read without further bounds checks
+        if ((report == nullptr) || (size < report->size))
+            return false;
+
+        uint32_t button_word = 0;
+        uint16_t axes[4] = { STICK_ZERO, STICK_ZERO, STICK_ZERO, STICK_ZERO };
+
+        for (size_t i = 0; i < report->field_count; ++i) {
+            auto field = &report->fields[i];
+
+            uint32_t raw = ExtractBits(data, field->bit_offset, field->bit_size);
+            if (field->target == HidFieldTarget_Buttons) {
+                button_word |= raw ? field->button_mask : 0;
+                continue;
+            }
+
+            if (field->target == HidFieldTarget_ButtonRun) {
+                for (uint32_t bits = raw; bits != 0; bits &= bits - 1) {
+                    size_t index = field->first_button + __builtin_ctz(bits);
+                    if (index < std::size(gamepad_button_masks))
+                        button_word |= gamepad_button_masks[index];
+                }
+                continue;
+            }
+
+            int32_t value = raw;
+            if ((field->logical_min < 0) && (field->bit_size < 32)) {
+                uint32_t sign_bit = 1 << (field->bit_size - 1);
+                value = int32_t((raw ^ sign_bit) - sign_bit);
+            }
+
+            switch (field->target) {
+                case HidFieldTarget_Hat: {
+                    uint32_t direction = value - field->logical_min;
+                    if (direction < std::size(hat_button_masks))
+                        button_word |= hat_button_masks[direction];
+                    break;
+                }
+                case HidFieldTarget_LeftStickX:
+                    axes[0] = ScaleAxis(value, field);
+                    break;
+                case HidFieldTarget_LeftStickY:
+                    axes[1] = UINT12_MAX - ScaleAxis(value, field);
+                    break;
+                case HidFieldTarget_RightStickX:
+                    axes[2] = ScaleAxis(value, field);
+                    break;
+                case HidFieldTarget_RightStickY:
+                    axes[3] = UINT12_MAX - ScaleAxis(value, field);
+                    break;
+                case HidFieldTarget_LeftTrigger:
+                    if (ScaleAxis(value, field) > STICK_ZERO)
+                        button_word |= SwitchButtonMask_ZL;
+                    break;
+                case HidFieldTarget_RightTrigger:
+                    if (ScaleAxis(value, field) > STICK_ZERO)
+                        button_word |= SwitchButtonMask_ZR;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        uint8_t button_bytes[3] = { uint8_t(button_word), uint8_t(button_word >> 8), uint8_t(button_word >> 16) };
+        std::memcpy(buttons, button_bytes, sizeof(button_bytes));
+        left_stick->SetData(axes[0], axes[1]);
+        right_stick->SetData(axes[2], axes[3]);
+
+        return true;
+    }
+
+}
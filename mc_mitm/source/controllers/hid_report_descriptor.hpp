@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+#include "switch_controller.hpp"
+
+namespace ams::controller {
+
+    constexpr size_t HidPlanMaxReports = 2;
+    constexpr size_t HidPlanMaxFields  = 16;
+
+    // Largest report we can be handed, in bits. Nothing beyond this is ever decoded.
+    constexpr size_t HidPlanMaxReportBits = sizeof(bluetooth::HidReport::data) * 8;
+
+    constexpr uint32_t HidPlanMagic   = 0x50484d43; // MCHP
+    constexpr uint16_t HidPlanVersion = 1;
+
+    enum HidFieldTarget : uint8_t {
+        HidFieldTarget_None,
+        HidFieldTarget_Buttons,
+        HidFieldTarget_ButtonRun,
+        HidFieldTarget_Hat,
+        HidFieldTarget_LeftStickX,
+        HidFieldTarget_LeftStickY,
+        HidFieldTarget_RightStickX,
+        HidFieldTarget_RightStickY,
+        HidFieldTarget_LeftTrigger,
+        HidFieldTarget_RightTrigger,
+    };
+
+    // A single input value, located by its bit position within the report
+    struct HidReportField {
+        uint16_t bit_offset;
+        uint8_t bit_size;
+        uint8_t target;
+        union {
+            // Pressed whenever the value is non-zero
+            uint32_t button_mask;
+
+            // One bit per button, for consecutive button page usages starting from this index
+            uint32_t first_button;
+
+            struct {
+                int32_t logical_min;
+                int32_t logical_max;
+            };
+        };
+    };
+    static_assert(sizeof(HidReportField) == 0xc);
+
+    struct HidReportPlan {
+        uint8_t id;
+        uint8_t field_count;
+        uint16_t size;  // Minimum length of the report data, including any id byte
+        HidReportField fields[HidPlanMaxFields];
+    };
+
+    // Everything needed to decode a device's input reports, compiled from its report descriptor.
+    // Written as-is to the controller directory, keyed by a crc of the descriptor it was built from.
+    struct HidDescriptorPlan {
+        uint32_t magic;
+        uint16_t version;
+        uint8_t report_count;
+        bool uses_report_ids;
+        uint32_t descriptor_crc;
+        HidReportPlan reports[HidPlanMaxReports];
+    };
+
+    Result CompileHidReportDescriptor(const uint8_t *descriptor, size_t size, HidDescriptorPlan *plan);
+
+    // Check that every field of a plan lies within its report, and every report within the largest we can be handed.
+    // Plans read back from storage must pass this before being used to decode anything.
+    bool ValidateHidDescriptorPlan(const HidDescriptorPlan *plan);
+
+    // Returns false if the report doesn't match any in the plan, leaving the outputs untouched
+    bool DecodeHidReport(const HidDescriptorPlan *plan, const uint8_t *data, size_t size, SwitchButtonData *buttons, SwitchAnalogStick *left_stick, SwitchAnalogStick *right_stick);
+
+}
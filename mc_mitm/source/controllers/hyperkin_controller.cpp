@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "hyperkin_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -27,7 +28,8 @@ namespace ams::controller {
 
         switch(hyperkin_report->id) {
             case 0x3f:
-                this->HandleInputReport0x3f(hyperkin_report);
+                if (auto src = GetReportView<HyperkinReportData, HyperkinInputReport0x3f>(report))
+                    this->HandleInputReport0x3f(src);
                 break;
             default:
                 break;
@@ -57,6 +57,7 @@ namespace ams::controller {
         HyperkinStickData right_stick;
         uint8_t unk;
     } __attribute__ ((__packed__));
+    static_assert(sizeof(HyperkinInputReport0x3f) == 0x0c);
 
     struct HyperkinReportData{
         uint8_t id;
@@ -14,14 +14,24 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "icade_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
 
+    ICadeController::ICadeController(const bluetooth::Address *address, HardwareID id)
+    : EmulatedSwitchController(address, id) {
+        // The arcade layout has no minus or plus buttons, so they are produced from the shoulder buttons ahead of the usual combos
+        m_button_combos.Clear();
+        m_button_combos.AddChord(SwitchButtonMask_ZL | SwitchButtonMask_ZR | SwitchButtonMask_L, SwitchButtonMask_Minus, 0);
+        m_button_combos.AddChord(SwitchButtonMask_ZL | SwitchButtonMask_ZR | SwitchButtonMask_R, SwitchButtonMask_Plus, 0);
+        AddDefaultButtonCombos(&m_button_combos);
+    }
+
     void ICadeController::UpdateControllerState(const bluetooth::HidReport *report) {
         auto icade_report = reinterpret_cast<const ICadeReportData *>(&report->data);
 
-        if (icade_report->id == 0x01) {
+        if ((icade_report->id == 0x01) && GetReportView<ICadeReportData, ICadeInputReport0x01>(report)) {
 
             for (unsigned int i = 0; i < sizeof(icade_report->input0x01.keys); ++i) {
                 
@@ -61,24 +71,4 @@ namespace ams::controller {
 
     }
 
-    void ICadeController::ApplyButtonCombos(SwitchButtonData *buttons) {
-        // Combo for minus button
-        if (buttons->ZL && buttons->ZR && buttons->L) {
-            buttons->minus = 1;
-            buttons->ZL = 0;
-            buttons->ZR = 0;
-            buttons->L = 0;
-        }
-
-        // Combo for plus button
-        if (buttons->ZL && buttons->ZR && buttons->R) {
-            buttons->plus = 1;
-            buttons->ZL = 0;
-            buttons->ZR = 0;
-            buttons->R = 0;
-        }
-
-        EmulatedSwitchController::ApplyButtonCombos(buttons);
-    }
-
 }
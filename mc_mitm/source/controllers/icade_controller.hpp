@@ -21,6 +21,7 @@ namespace ams::controller {
     struct ICadeInputReport0x01 {
         uint8_t keys[9];
     } __attribute__((packed));
+    static_assert(sizeof(ICadeInputReport0x01) == 0x09);
 
     struct ICadeReportData {
         uint8_t id;
@@ -36,11 +37,9 @@ namespace ams::controller {
                 {0x15e4, 0x0132}    // ION iCade Controller
             };  
 
-            ICadeController(const bluetooth::Address *address, HardwareID id)
-            : EmulatedSwitchController(address, id) { }
+            ICadeController(const bluetooth::Address *address, HardwareID id);
 
             void UpdateControllerState(const bluetooth::HidReport *report);
-            void ApplyButtonCombos(SwitchButtonData *buttons) override;
 
     };
 
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "ipega_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -29,10 +30,12 @@ namespace ams::controller {
 
         switch(ipega_report->id) {
             case 0x02:
-                this->HandleInputReport0x02(ipega_report);
+                if (auto src = GetReportView<IpegaReportData, IpegaInputReport0x02>(report))
+                    this->HandleInputReport0x02(src);
                 break;
             case 0x07:
-                this->HandleInputReport0x07(ipega_report);
+                if (auto src = GetReportView<IpegaReportData, IpegaInputReport0x07>(report))
+                    this->HandleInputReport0x07(src);
                 break;
             default:
                 break;
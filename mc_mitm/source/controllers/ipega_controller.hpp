@@ -61,6 +61,7 @@ namespace ams::controller {
         uint8_t         : 7;
         uint8_t home    : 1;
     } __attribute__((packed));
+    static_assert(sizeof(IpegaInputReport0x02) == 0x01);
 
     struct IpegaInputReport0x07 {
         IpegaStickData   left_stick;
@@ -69,6 +70,7 @@ namespace ams::controller {
         uint8_t          right_trigger;
         uint8_t          left_trigger;
     } __attribute__((packed));
+    static_assert(sizeof(IpegaInputReport0x07) == 0x09);
 
     struct IpegaReportData {
         uint8_t id;
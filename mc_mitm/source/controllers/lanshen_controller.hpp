@@ -64,6 +64,7 @@ namespace ams::controller {
         LanShenButtonData buttons;
         uint8_t _unk[4];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(LanShenInputReport0x01) == 0x0b);
 
     struct LanShenReportData {
         uint8_t id;
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mad_catz_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -29,10 +30,12 @@ namespace ams::controller {
 
         switch(madcatz_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(madcatz_report);
+                if (auto src = GetReportView<MadCatzReportData, MadCatzInputReport0x01>(report))
+                    this->HandleInputReport0x01(src);
                 break;
             case 0x02:
-                this->HandleInputReport0x02(madcatz_report);
+                if (auto src = GetReportView<MadCatzReportData, MadCatzInputReport0x02>(report))
+                    this->HandleInputReport0x02(src);
                 break;
             default:
                 break;
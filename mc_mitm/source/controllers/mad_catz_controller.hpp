@@ -80,6 +80,8 @@ namespace ams::controller {
             MadCatzInputReport0x02 input0x02;
         };
     } __attribute__((packed));
+    static_assert(sizeof(MadCatzInputReport0x02) == 0x01);
+    static_assert(sizeof(MadCatzInputReport0x01) == 0x09);
 
     class MadCatzController : public EmulatedSwitchController {
 
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mocute_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -31,7 +32,8 @@ namespace ams::controller {
             case 0x01:
             case 0x04:
             case 0x06:
-                this->HandleInputReport(mocute_report);
+                if (auto src = GetReportView<MocuteReportData, MocuteInputReport0x01>(report))
+                    this->HandleInputReport(src);
                 break;
             default:
                 break;
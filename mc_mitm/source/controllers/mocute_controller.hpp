@@ -78,6 +78,7 @@ namespace ams::controller {
             MocuteInputReport0x01 input0x01;
         };
     } __attribute__((packed));
+    static_assert(sizeof(MocuteInputReport0x01) == 0x08);
 
     class MocuteController : public EmulatedSwitchController {
 
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "nvidia_shield_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -29,10 +30,12 @@ namespace ams::controller {
 
         switch(nvidia_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(nvidia_report);
+                if (auto src = GetReportView<NvidiaShieldReportData, NvidiaShieldInputReport0x01>(report))
+                    this->HandleInputReport0x01(src);
                 break;
             case 0x03:
-                this->HandleInputReport0x03(nvidia_report);
+                if (auto src = GetReportView<NvidiaShieldReportData, NvidiaShieldInputReport0x03>(report))
+                    this->HandleInputReport0x03(src);
                 break;
             default:
                 break;
@@ -61,10 +61,12 @@ namespace ams::controller {
         uint8_t back    : 1;
         uint8_t         : 0;
     } __attribute__((packed));
+    static_assert(sizeof(NvidiaShieldInputReport0x01) == 0x11);
 
     struct NvidiaShieldInputReport0x03 {
         uint8_t _unk[15];
     } __attribute__((packed));
+    static_assert(sizeof(NvidiaShieldInputReport0x03) == 0x0f);
 
     struct NvidiaShieldReportData{
         uint8_t id;
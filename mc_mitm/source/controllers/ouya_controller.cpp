@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "ouya_controller.hpp"
+#include "report_view.hpp"
 #include "controller_utils.hpp"
 #include <stratosphere.hpp>
 
@@ -30,10 +31,12 @@ namespace ams::controller {
 
         switch(ouya_report->id) {
             case 0x03:
-                this->HandleInputReport0x03(ouya_report);
+                if (auto src = GetReportView<OuyaReportData, OuyaInputReport0x03>(report))
+                    this->HandleInputReport0x03(src);
                 break;
             case 0x07:
-                this->HandleInputReport0x07(ouya_report);
+                if (auto src = GetReportView<OuyaReportData, OuyaInputReport0x07>(report))
+                    this->HandleInputReport0x07(src);
                 break;
             default:
                 break;
@@ -47,6 +47,7 @@ namespace ams::controller {
         uint8_t battery;
         uint8_t _unk[6];
     } __attribute__((packed));
+    static_assert(sizeof(OuyaInputReport0x03) == 0x07);
 
     struct OuyaInputReport0x07 {
         OuyaStickData   left_stick;
@@ -55,6 +56,7 @@ namespace ams::controller {
         uint16_t        right_trigger;
         OuyaButtonData  buttons;
     } __attribute__((packed));
+    static_assert(sizeof(OuyaInputReport0x07) == 0x0e);
 
     struct OuyaReportData {
         uint8_t id;
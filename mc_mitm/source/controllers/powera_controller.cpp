@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "powera_controller.hpp"
+#include "report_view.hpp"
 #include "controller_utils.hpp"
 #include <stratosphere.hpp>
 
@@ -30,7 +31,8 @@ namespace ams::controller {
 
         switch(powera_report->id) {
             case 0x03:
-                this->HandleInputReport0x03(powera_report);
+                if (auto src = GetReportView<PowerAReportData, PowerAInputReport0x03>(report))
+                    this->HandleInputReport0x03(src);
                 break;
             default:
                 break;
@@ -60,6 +60,7 @@ namespace ams::controller {
         uint8_t battery;
         uint8_t _unk;
     } __attribute__((packed));
+    static_assert(sizeof(PowerAInputReport0x03) == 0x0a);
 
     struct PowerAReportData{
         uint8_t id;
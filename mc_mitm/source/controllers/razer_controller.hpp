@@ -62,6 +62,7 @@ namespace ams::controller {
         uint8_t left_trigger;
         uint8_t right_trigger;
     } __attribute__((packed));
+    static_assert(sizeof(RazerInputReport0x01) == 0x09);
 
     struct RazerReportData{
         uint8_t id;
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "../bluetooth_mitm/bluetooth/bluetooth_types.hpp"
+#include <type_traits>
+
+namespace ams::controller {
+
+    // Reports are read through packed structs laid over the report data, following the report id byte.
+    // A view of a report is only handed out if the report is long enough to hold the payload layout for its id,
+    // so handlers can read any field of the payload without checking the size again.
+    template<typename ReportDataT, typename PayloadT>
+    inline const ReportDataT *GetReportView(const bluetooth::HidReport *report) {
+        static_assert(std::is_trivially_copyable<PayloadT>::value);
+        static_assert(sizeof(PayloadT) < sizeof(report->data));
+
+        return report->size >= sizeof(PayloadT) + 1 ? reinterpret_cast<const ReportDataT *>(&report->data) : nullptr;
+    }
+
+}
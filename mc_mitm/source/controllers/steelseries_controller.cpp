@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "steelseries_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 
 namespace ams::controller {
@@ -29,17 +30,21 @@ namespace ams::controller {
 
         switch(steelseries_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(steelseries_report);
+                if (auto src = GetReportView<SteelseriesReportData, SteelseriesInputReport0x01>(report))
+                    this->HandleInputReport0x01(src);
                 break;
             case 0x12:
-                this->HandleInputReport0x12(steelseries_report);
+                if (auto src = GetReportView<SteelseriesReportData, SteelseriesInputReport0x12>(report))
+                    this->HandleInputReport0x12(src);
                 break;
             case 0xc4:
-                this->HandleInputReport0xc4(steelseries_report);
+                if (auto src = GetReportView<SteelseriesReportData, SteelseriesInputReport0xc4>(report))
+                    this->HandleInputReport0xc4(src);
                 break;
             default:
                 // Todo: handle this properly
-                this->HandleMfiInputReport(steelseries_report);
+                if (report->size >= sizeof(SteelseriesMfiInputReport))
+                    this->HandleMfiInputReport(steelseries_report);
                 break;
         }
     }
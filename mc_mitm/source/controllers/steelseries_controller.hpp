@@ -106,6 +106,7 @@ namespace ams::controller {
         SteelseriesStickData left_stick;
         SteelseriesStickData right_stick;
     } __attribute__((packed));
+    static_assert(sizeof(SteelseriesMfiInputReport) == 0x11);
 
     struct SteelseriesInputReport0x01 {
         uint8_t dpad;
@@ -113,6 +114,7 @@ namespace ams::controller {
         SteelseriesStickData right_stick;
         SteelseriesButtonData buttons;
     } __attribute__((packed));
+    static_assert(sizeof(SteelseriesInputReport0x01) == 0x07);
 
     struct SteelseriesInputReport0x12 {
         uint8_t      : 3;
@@ -124,6 +126,7 @@ namespace ams::controller {
         uint8_t _unk1;  // Maybe battery
         
     } __attribute__((packed));
+    static_assert(sizeof(SteelseriesInputReport0x12) == 0x04);
 
     struct SteelseriesInputReport0xc4 {
         SteelseriesStickData left_stick;
@@ -134,6 +137,7 @@ namespace ams::controller {
         uint8_t dpad;
         uint8_t _unk[2];
     } __attribute__((packed));
+    static_assert(sizeof(SteelseriesInputReport0xc4) == 0x0b);
 
     struct SteelseriesReportData {
         union {
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "stick_shaping.hpp"
+#include "switch_controller.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace ams::controller {
+
+    namespace {
+
+        constexpr int32_t  stick_max     = STICK_ZERO - 1;
+        constexpr uint32_t segment_shift = 6;   // 2048 / StickShaper::LutSegments
+        constexpr uint32_t scale_shift   = 12;
+        constexpr uint32_t live_shift    = 12;
+
+        static_assert((1 << segment_shift) * StickShaper::LutSegments == STICK_ZERO);
+
+        const StickShapingConfig default_stick_shaping_config = {
+            .enable = false,
+            .deadzone_mode = StickDeadzoneMode_Radial,
+            .inner_deadzone = 0,
+            .outer_deadzone = 0,
+            .anti_deadzone = 0,
+            .response_curve = 100,
+            .scale_x = 100,
+            .scale_y = 100
+        };
+
+        struct StickShapingConfigPair {
+            StickShapingConfig left;
+            StickShapingConfig right;
+        };
+
+        uint32_t SquareRoot(uint32_t value) {
+            uint32_t result = 0;
+            uint32_t bit = 1 << 30;
+            while (bit > value)
+                bit >>= 2;
+
+            while (bit != 0) {
+                if (value >= result + bit) {
+                    value -= result + bit;
+                    result = (result >> 1) + bit;
+                }
+                else {
+                    result >>= 1;
+                }
+                bit >>= 2;
+            }
+
+            return result;
+        }
+
+        void ParsePercentage(const char *value, uint32_t max, uint8_t *out, bool *enable) {
+            char *end;
+            auto result = std::strtoul(value, &end, 10);
+            if ((end != value) && (*end == '\0') && (result <= max)) {
+                *out = static_cast<uint8_t>(result);
+                *enable = true;
+            }
+        }
+
+        void ParseScale(const char *value, uint16_t *out, bool *enable) {
+            char *end;
+            auto result = std::strtoul(value, &end, 10);
+            if ((end != value) && (*end == '\0') && (result <= 1000)) {
+                *out = static_cast<uint16_t>(result);
+                *enable = true;
+            }
+        }
+
+        int StickShapingIniHandler(void *user, const char *section, const char *name, const char *value) {
+            auto configs = reinterpret_cast<StickShapingConfigPair *>(user);
+
+            StickShapingConfig *config;
+            if (strcasecmp(section, "left_stick") == 0)
+                config = &configs->left;
+            else if (strcasecmp(section, "right_stick") == 0)
+                config = &configs->right;
+            else
+                return 0;
+
+            if (strcasecmp(name, "deadzone_mode") == 0) {
+                if (strcasecmp(value, "radial") == 0)
+                    config->deadzone_mode = StickDeadzoneMode_Radial;
+                else if (strcasecmp(value, "axial") == 0)
+                    config->deadzone_mode = StickDeadzoneMode_Axial;
+            }
+            else if (strcasecmp(name, "inner_deadzone") == 0)
+                ParsePercentage(value, 100, &config->inner_deadzone, &config->enable);
+            else if (strcasecmp(name, "outer_deadzone") == 0)
+                ParsePercentage(value, 100, &config->outer_deadzone, &config->enable);
+            else if (strcasecmp(name, "anti_deadzone") == 0)
+                ParsePercentage(value, 100, &config->anti_deadzone, &config->enable);
+            else if (strcasecmp(name, "response_curve") == 0)
+                ParseScale(value, &config->response_curve, &config->enable);
+            else if (strcasecmp(name, "scale_x") == 0)
+                ParseScale(value, &config->scale_x, &config->enable);
+            else if (strcasecmp(name, "scale_y") == 0)
+                ParseScale(value, &config->scale_y, &config->enable);
+            else
+                return 0;
+
+            return 1;
+        }
+
+    }
+
+    void StickShaper::Configure(const StickShapingConfig *config) {
+        m_enabled = false;
+        if (!config->enable)
+            return;
+
+        // Deadzones overlapping each other or a zero exponent leave nothing sensible to map to
+        if ((config->inner_deadzone + config->outer_deadzone >= 100) || (config->response_curve == 0))
+            return;
+
+        float anti = config->anti_deadzone / 100.0f;
+        float exponent = config->response_curve / 100.0f;
+
+        // The table covers only the live range between the deadzones, which Lookup maps deflection onto
+        m_inner = (config->inner_deadzone * STICK_ZERO) / 100;
+        m_outer = STICK_ZERO - (config->outer_deadzone * STICK_ZERO) / 100;
+        m_live_scale = (STICK_ZERO << live_shift) / (m_outer - m_inner);
+
+        for (size_t i = 0; i <= LutSegments; ++i) {
+            float output = anti + (1.0f - anti) * std::pow(float(i) / LutSegments, exponent);
+            m_lut[i] = static_cast<uint16_t>(output * stick_max + 0.5f);
+        }
+
+        m_mode = config->deadzone_mode;
+        m_scale_x = static_cast<uint16_t>((config->scale_x << scale_shift) / 100);
+        m_scale_y = static_cast<uint16_t>((config->scale_y << scale_shift) / 100);
+        m_enabled = true;
+    }
+
+    uint16_t StickShaper::Lookup(uint32_t magnitude) const {
+        if (magnitude <= m_inner)
+            return 0;
+        if (magnitude >= m_outer)
+            return m_lut[LutSegments];
+
+        magnitude = ((magnitude - m_inner) * m_live_scale) >> live_shift;
+        if (magnitude >= STICK_ZERO)
+            return m_lut[LutSegments];
+
+        uint32_t index = magnitude >> segment_shift;
+        int32_t fraction = magnitude & ((1 << segment_shift) - 1);
+        return m_lut[index] + (((m_lut[index + 1] - m_lut[index]) * fraction) >> segment_shift);
+    }
+
+    void StickShaper::Apply(SwitchAnalogStick *stick) const {
+        int32_t x = stick->GetX() - STICK_ZERO;
+        int32_t y = stick->GetY() - STICK_ZERO;
+
+        if (m_mode == StickDeadzoneMode_Axial) {
+            x = x < 0 ? -Lookup(-x) : Lookup(x);
+            y = y < 0 ? -Lookup(-y) : Lookup(y);
+        }
+        else {
+            // Scale both axes by the same factor so that the direction of the stick is kept
+            uint32_t magnitude = SquareRoot(x * x + y * y);
+            if (magnitude != 0) {
+                int32_t output = Lookup(magnitude);
+                x = (x * output) / int32_t(magnitude);
+                y = (y * output) / int32_t(magnitude);
+            }
+        }
+
+        x = std::clamp<int32_t>((x * m_scale_x) >> scale_shift, -STICK_ZERO, stick_max);
+        y = std::clamp<int32_t>((y * m_scale_y) >> scale_shift, -STICK_ZERO, stick_max);
+
+        stick->SetData(x + STICK_ZERO, y + STICK_ZERO);
+    }
+
+    Result LoadStickShapingConfig(const bluetooth::Address *address, StickShapingConfig *left, StickShapingConfig *right) {
+        StickShapingConfigPair configs = { default_stick_shaping_config, default_stick_shaping_config };
+
+        std::string path = GetControllerDirectory(address) + "/sticks.ini";
+
+        fs::FileHandle file;
+        if (R_SUCCEEDED(fs::OpenFile(std::addressof(file), path.c_str(), fs::OpenMode_Read))) {
+            ON_SCOPE_EXIT { fs::CloseFile(file); };
+            util::ini::ParseFile(file, &configs, StickShapingIniHandler);
+        }
+
+        *left  = configs.left;
+        *right = configs.right;
+
+        return ams::ResultSuccess();
+    }
+
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+#include "switch_analog_stick.hpp"
+#include "../bluetooth_mitm/bluetooth/bluetooth_types.hpp"
+
+namespace ams::controller {
+
+    enum StickDeadzoneMode : uint8_t {
+        StickDeadzoneMode_Radial,
+        StickDeadzoneMode_Axial,
+    };
+
+    // Deadzones are percentages of full deflection, the response curve is an exponent in hundredths (100 is linear)
+    struct StickShapingConfig {
+        bool enable;
+        StickDeadzoneMode deadzone_mode;
+        uint8_t inner_deadzone;
+        uint8_t outer_deadzone;
+        uint8_t anti_deadzone;
+        uint16_t response_curve;
+        uint16_t scale_x;
+        uint16_t scale_y;
+    };
+
+    // Reshapes stick deflection through a table of output magnitudes built once from a StickShapingConfig.
+    // Deflection inside the inner deadzone gives nothing. The rest, up to the outer deadzone, is spread over 32 linearly
+    // interpolated knots, so that the anti-deadzone step lands exactly on the first and a report costs a few integer operations per stick.
+    class StickShaper {
+
+        public:
+            static constexpr size_t LutSegments = 32;
+
+            StickShaper(void) : m_enabled(false) { }
+
+            void Configure(const StickShapingConfig *config);
+            bool IsEnabled(void) const { return m_enabled; }
+            void Apply(SwitchAnalogStick *stick) const;
+
+        private:
+            uint16_t Lookup(uint32_t magnitude) const;
+
+            bool m_enabled;
+            StickDeadzoneMode m_mode;
+            uint16_t m_scale_x;
+            uint16_t m_scale_y;
+            uint32_t m_inner;
+            uint32_t m_outer;
+            uint32_t m_live_scale;
+            uint16_t m_lut[LutSegments + 1];
+
+    };
+
+    // Reads the optional sticks.ini from the controller directory. Missing settings leave the sticks as they are.
+    Result LoadStickShapingConfig(const bluetooth::Address *address, StickShapingConfig *left, StickShapingConfig *right);
+
+}
@@ -14,7 +14,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "switch_controller.hpp"
+#include "report_view.hpp"
 #include "../utils.hpp"
+#include "../mcmitm_io.hpp"
 #include <string>
 
 namespace ams::controller {
@@ -40,6 +42,16 @@ namespace ams::controller {
             SwitchPlayerNumber_Four,    //1111
         };
 
+        struct HasFileRequest {
+            const char *path;
+            bool exists;
+        };
+
+        Result HasFileFunction(void *data) {
+            auto request = reinterpret_cast<HasFileRequest *>(data);
+            return fs::HasFile(&request->exists, request->path);
+        }
+
     }
 
     Result LedsMaskToPlayerNumber(uint8_t led_mask, uint8_t *player_number) {
@@ -70,12 +82,16 @@ namespace ams::controller {
         return ams::ResultSuccess(); 
     }
 
+    Result SwitchController::SaveProfile(void) {
+        return SaveControllerProfile(&m_address, &m_profile);
+    }
+
     bool SwitchController::HasSetTsiDisableFlag(void) {
         std::string flag_file = GetControllerDirectory(&m_address) + "/settsi_disable.flag";
 
-        bool file_exists;
-        if (R_SUCCEEDED(fs::HasFile(&file_exists, flag_file.c_str()))) {
-            return file_exists;
+        HasFileRequest request = { flag_file.c_str(), false };
+        if (R_SUCCEEDED(mitm::io::Execute(HasFileFunction, &request))) {
+            return request.exists;
         }
 
         return false;
@@ -86,7 +102,7 @@ namespace ams::controller {
 	    std::memcpy(m_input_report.data, report->data, report->size);
 
         auto switch_report = reinterpret_cast<SwitchReportData *>(m_input_report.data);
-        if (switch_report->id == 0x30) {
+        if ((switch_report->id == 0x30) && GetReportView<SwitchReportData, SwitchInputReport0x30>(report)) {
             this->ApplyButtonCombos(&switch_report->input0x30.buttons);
         }
 
@@ -98,19 +114,7 @@ namespace ams::controller {
     }
 
     void SwitchController::ApplyButtonCombos(SwitchButtonData *buttons) {
-        // Home combo = MINUS + DPAD_DOWN
-        if (buttons->minus && buttons->dpad_down) {
-            buttons->home = 1;
-            buttons->minus = 0;
-            buttons->dpad_down = 0;
-        }
-
-        // Capture combo = MINUS + DPAD_UP
-        if (buttons->minus && buttons->dpad_up) {
-            buttons->capture = 1;
-            buttons->minus = 0;
-            buttons->dpad_up = 0;
-        }
+        m_button_combos.Apply(buttons, os::ConvertToTimeSpan(os::GetSystemTick()).GetMilliSeconds());
     }
 
 }
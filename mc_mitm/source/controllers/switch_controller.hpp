@@ -15,6 +15,8 @@
  */
 #pragma once
 #include "switch_analog_stick.hpp"
+#include "controller_profile.hpp"
+#include "button_combos.hpp"
 #include "../bluetooth_mitm/bluetooth/bluetooth_types.hpp"
 #include "../bluetooth_mitm/bluetooth/bluetooth_hid_report.hpp"
 
@@ -39,6 +41,16 @@ namespace ams::controller {
         uint16_t pid;
     };
 
+    struct ReportMappingStatistics {
+        bluetooth::Address address;
+        HardwareID id;
+        uint8_t reserved[2];
+        uint32_t report_count;
+        uint64_t total_ns;
+        uint64_t max_ns;
+    };
+    static_assert(sizeof(ReportMappingStatistics) == 0x20);
+
     struct RGBColour {
         uint8_t r;
         uint8_t g;
@@ -78,13 +90,35 @@ namespace ams::controller {
         uint8_t ZL             : 1;
     } __attribute__ ((__packed__));
 
+    // Bits of SwitchButtonData when read as a little endian 24 bit word
+    enum SwitchButtonMask : uint32_t {
+        SwitchButtonMask_Y            = (1 << 0),
+        SwitchButtonMask_X            = (1 << 1),
+        SwitchButtonMask_B            = (1 << 2),
+        SwitchButtonMask_A            = (1 << 3),
+        SwitchButtonMask_R            = (1 << 6),
+        SwitchButtonMask_ZR           = (1 << 7),
+        SwitchButtonMask_Minus        = (1 << 8),
+        SwitchButtonMask_Plus         = (1 << 9),
+        SwitchButtonMask_RStickPress  = (1 << 10),
+        SwitchButtonMask_LStickPress  = (1 << 11),
+        SwitchButtonMask_Home         = (1 << 12),
+        SwitchButtonMask_Capture      = (1 << 13),
+        SwitchButtonMask_DpadDown     = (1 << 16),
+        SwitchButtonMask_DpadUp       = (1 << 17),
+        SwitchButtonMask_DpadRight    = (1 << 18),
+        SwitchButtonMask_DpadLeft     = (1 << 19),
+        SwitchButtonMask_L            = (1 << 22),
+        SwitchButtonMask_ZL           = (1 << 23),
+    };
+
     struct Switch6AxisData {
-        uint16_t accel_x;
-        uint16_t accel_y;
-        uint16_t accel_z;
-        uint16_t gyro_1;
-        uint16_t gyro_2;
-        uint16_t gyro_3;
+        int16_t accel_x;
+        int16_t accel_y;
+        int16_t accel_z;
+        int16_t gyro_1;
+        int16_t gyro_2;
+        int16_t gyro_3;
     } __attribute__ ((__packed__));
 
     struct SwitchRumbleData {
@@ -159,8 +193,13 @@ namespace ams::controller {
                 };
             } set_player_leds;
 
+            // Plain bytes, as the console can send any value
             struct {
-                bool enabled;
+                uint8_t enabled;
+            } enable_imu;
+
+            struct {
+                uint8_t enabled;
             } set_vibration;
         };
     } __attribute__ ((__packed__));
@@ -222,6 +261,7 @@ namespace ams::controller {
         } rumble;
         SwitchSubcommand subcmd;
     } __attribute__ ((__packed__));
+    static_assert(offsetof(SwitchOutputReport0x01, subcmd) == 0x09);
 
     struct SwitchOutputReport0x03;
 
@@ -232,6 +272,7 @@ namespace ams::controller {
             uint8_t right_motor[4];
         } rumble;
     }__attribute__ ((__packed__));
+    static_assert(sizeof(SwitchOutputReport0x10) == 0x09);
 
     struct SwitchOutputReport0x11;
     struct SwitchOutputReport0x12;
@@ -246,6 +287,11 @@ namespace ams::controller {
         uint8_t           vibrator;
         SwitchSubcommandResponse response;
     } __attribute__ ((__packed__));
+    static_assert(sizeof(SwitchInputReport0x21) == 0x32);
+    static_assert(offsetof(SwitchInputReport0x21, buttons) == 0x02);
+    static_assert(offsetof(SwitchInputReport0x21, left_stick) == 0x05);
+    static_assert(offsetof(SwitchInputReport0x21, right_stick) == 0x08);
+    static_assert(offsetof(SwitchInputReport0x21, response) == 0x0c);
 
     struct SwitchInputReport0x23;
 
@@ -261,6 +307,11 @@ namespace ams::controller {
         // IMU samples at 0, 5 and 10ms
         Switch6AxisData     motion[3];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(SwitchInputReport0x30) == 0x30);
+    static_assert(offsetof(SwitchInputReport0x30, buttons) == 0x02);
+    static_assert(offsetof(SwitchInputReport0x30, left_stick) == 0x05);
+    static_assert(offsetof(SwitchInputReport0x30, right_stick) == 0x08);
+    static_assert(offsetof(SwitchInputReport0x30, motion) == 0x0c);
 
     struct SwitchInputReport0x31;
     struct SwitchInputReport0x32;
@@ -303,16 +354,28 @@ namespace ams::controller {
             SwitchController(const bluetooth::Address *address, HardwareID id)
             : m_address(*address)
             , m_id(id)
-            , m_settsi_supported(true) { }
+            , m_settsi_supported(true)
+            , m_profile() {
+                AddDefaultButtonCombos(&m_button_combos);
+            }
 
             virtual ~SwitchController() { };
 
             const bluetooth::Address& Address(void) const { return m_address; }
+            HardwareID HardwareId(void) const { return m_id; }
 
             virtual bool IsOfficialController(void) { return true; }
             virtual bool SupportsSetTsiCommand(void) { return m_settsi_supported; }
 
+            // Official controllers are passed through as they are, so only emulated ones have report mapping to measure
+            virtual bool GetReportMappingStatistics(ReportMappingStatistics *stats) { AMS_UNUSED(stats); return false; }
+
+            void SetProfile(const ControllerProfile *profile) { m_profile = *profile; }
+
             virtual Result Initialize(void);
+
+            // Called once Initialize has returned from the most derived class, so that report handling can rely on everything it set up
+            virtual void SetReady(void) { }
             virtual Result HandleIncomingReport(const bluetooth::HidReport *report);
             virtual Result HandleOutgoingReport(const bluetooth::HidReport *report);
 
@@ -320,13 +383,19 @@ namespace ams::controller {
             bool HasSetTsiDisableFlag(void);
 
         protected:
-            virtual void ApplyButtonCombos(SwitchButtonData *buttons);
+            void ApplyButtonCombos(SwitchButtonData *buttons);
+
+            Result SaveProfile(void);
 
             bluetooth::Address m_address;
             HardwareID m_id;
 
             bool m_settsi_supported;
 
+            ControllerProfile m_profile;
+
+            ButtonCombos m_button_combos;
+
             bluetooth::HidReport m_input_report;
             bluetooth::HidReport m_output_report;
     };
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "switch_motion.hpp"
+
+namespace ams::controller {
+
+    static_assert(sizeof(Switch6AxisData) == 6 * sizeof(int16_t));
+
+    SwitchMotionSampleBuffer::SwitchMotionSampleBuffer(void)
+    : m_write_count(0)
+    , m_slot_interval(os::ConvertToTick(TimeSpan::FromMilliSeconds(5))) { }
+
+    void SwitchMotionSampleBuffer::Clear(void) {
+        m_write_count.store(0, std::memory_order_release);
+    }
+
+    void SwitchMotionSampleBuffer::Push(os::Tick tick, const Switch6AxisData *sample) {
+        uint32_t count = m_write_count.load(std::memory_order_relaxed);
+
+        auto entry = &m_samples[count % BufferSize];
+        entry->tick = tick;
+        std::memcpy(entry->axes, sample, sizeof(entry->axes));
+
+        // Publish the sample only once it has been fully written
+        m_write_count.store(count + 1, std::memory_order_release);
+    }
+
+    bool SwitchMotionSampleBuffer::Resample(Switch6AxisData samples[3]) {
+        uint32_t count = m_write_count.load(std::memory_order_acquire);
+        if (count == 0)
+            return false;
+
+        size_t available = std::min<size_t>(count, BufferSize);
+        const MotionSample *newest = &m_samples[(count - 1) % BufferSize];
+
+        // Slots are placed at 10, 5 and 0ms before the newest sample. Walking backwards through the ring,
+        // each slot is interpolated between the pair of samples either side of it. Samples arriving faster
+        // than the slot rate are decimated, and slots older than the oldest sample are clamped to it.
+        size_t index = 0;
+        for (int i = 2; i >= 0; --i) {
+            os::Tick slot_tick = newest->tick - os::Tick(m_slot_interval.GetInt64Value() * (2 - i));
+
+            const MotionSample *b = newest;
+            const MotionSample *a = newest;
+            while (index < available) {
+                a = &m_samples[(count - 1 - index) % BufferSize];
+                if (a->tick <= slot_tick)
+                    break;
+                b = a;
+                ++index;
+            }
+
+            this->Interpolate(a, b, slot_tick, &samples[i]);
+
+            // The next (older) slot may share the same pair of samples
+            if (index > 0)
+                --index;
+        }
+
+        return true;
+    }
+
+    void SwitchMotionSampleBuffer::Interpolate(const MotionSample *a, const MotionSample *b, os::Tick tick, Switch6AxisData *out) {
+        int16_t axes[6];
+
+        int64_t span = (b->tick - a->tick).GetInt64Value();
+        if ((span <= 0) || (tick <= a->tick)) {
+            std::memcpy(axes, a->axes, sizeof(axes));
+        }
+        else if (tick >= b->tick) {
+            std::memcpy(axes, b->axes, sizeof(axes));
+        }
+        else {
+            // Q15 weight of the newer sample keeps the per-axis products within 32 bits
+            int32_t weight = ((tick - a->tick).GetInt64Value() << 15) / span;
+            for (unsigned int i = 0; i < 6; ++i) {
+                axes[i] = a->axes[i] + (((b->axes[i] - a->axes[i]) * weight) >> 15);
+            }
+        }
+
+        std::memcpy(out, axes, sizeof(axes));
+    }
+
+}
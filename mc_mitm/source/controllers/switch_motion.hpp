@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+#include <algorithm>
+#include <atomic>
+#include "switch_controller.hpp"
+
+namespace ams::controller {
+
+    // Sensitivities of the emulated IMU. These must agree with the factory calibration written to virtual SPI flash at 0x6020.
+    // With zero origins the console interprets accelerometer values as 4096 LSB/G and gyroscope values as 13371/936 LSB/dps.
+    constexpr int32_t SwitchAccelSensitivity = 0x4000;
+    constexpr int32_t SwitchGyroSensitivity  = 0x343b;
+    constexpr int32_t SwitchAccelCountsPerG  = SwitchAccelSensitivity / 4;
+    constexpr int32_t SwitchGyroRangeDps     = 936;
+
+    struct SwitchMotionAxisData {
+        int16_t x;
+        int16_t y;
+        int16_t z;
+    } __attribute__ ((__packed__));
+
+    struct Switch6AxisCalibrationData {
+        SwitchMotionAxisData acc_origin;
+        SwitchMotionAxisData acc_sensitivity;
+        SwitchMotionAxisData gyro_origin;
+        SwitchMotionAxisData gyro_sensitivity;
+    } __attribute__ ((__packed__));
+
+    constexpr Switch6AxisCalibrationData motion_factory_calib = {
+        .acc_origin       = {0, 0, 0},
+        .acc_sensitivity  = {SwitchAccelSensitivity, SwitchAccelSensitivity, SwitchAccelSensitivity},
+        .gyro_origin      = {0, 0, 0},
+        .gyro_sensitivity = {SwitchGyroSensitivity, SwitchGyroSensitivity, SwitchGyroSensitivity}
+    };
+
+    // Q16 fixed-point factors for converting a source sensor's native units to those of the emulated IMU
+    constexpr int32_t AccelScaleFactor(int32_t counts_per_g) {
+        return (int64_t(SwitchAccelCountsPerG) << 16) / counts_per_g;
+    }
+
+    // Gyroscope sensitivity is given as a number of counts per `dps` degrees per second, for sources without an integer count per dps
+    constexpr int32_t GyroScaleFactor(int32_t counts, int32_t dps = 1) {
+        return ((int64_t(SwitchGyroSensitivity) << 16) * dps) / (int64_t(SwitchGyroRangeDps) * counts);
+    }
+
+    inline int16_t ScaleMotionValue(int32_t value, int32_t scale_factor) {
+        return static_cast<int16_t>(std::clamp<int64_t>((int64_t(value) * scale_factor) >> 16, INT16_MIN, INT16_MAX));
+    }
+
+    // Ring of timestamped IMU samples from a single producer (the controller's input report handler).
+    // Sources report motion at their own rate, so the three 5ms spaced samples of each Switch input report are resampled from here at encode time.
+    // Clear must only be called from the producer, since a concurrent Push would write back the count it reset.
+    class SwitchMotionSampleBuffer {
+
+        public:
+            SwitchMotionSampleBuffer(void);
+
+            void Clear(void);
+            void Push(os::Tick tick, const Switch6AxisData *sample);
+            bool Resample(Switch6AxisData samples[3]);
+
+        private:
+            static constexpr size_t BufferSize = 16;
+
+            struct MotionSample {
+                os::Tick tick;
+                int16_t axes[6];
+            };
+
+            void Interpolate(const MotionSample *a, const MotionSample *b, os::Tick tick, Switch6AxisData *out);
+
+            MotionSample m_samples[BufferSize];
+            std::atomic<uint32_t> m_write_count;
+            os::Tick m_slot_interval;
+    };
+
+}
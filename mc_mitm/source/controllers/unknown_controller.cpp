@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "unknown_controller.hpp"
+#include "../mcmitm_io.hpp"
+#include <algorithm>
+#include <string>
+
+namespace ams::controller {
+
+    namespace {
+
+        struct ReportPlanRequest {
+            bluetooth::Address address;
+            HidDescriptorPlan *plan;
+        };
+
+        std::string GetReportPlanPath(const bluetooth::Address *address) {
+            return GetControllerDirectory(address) + "/hid_plan.bin";
+        }
+
+        Result ReadReportPlanFunction(void *data) {
+            auto request = reinterpret_cast<ReportPlanRequest *>(data);
+            std::string path = GetReportPlanPath(&request->address);
+
+            fs::FileHandle file;
+            R_TRY(fs::OpenFile(std::addressof(file), path.c_str(), fs::OpenMode_Read));
+            ON_SCOPE_EXIT { fs::CloseFile(file); };
+
+            return fs::ReadFile(file, 0, request->plan, sizeof(HidDescriptorPlan));
+        }
+
+        Result WriteReportPlanFunction(void *data) {
+            auto request = reinterpret_cast<ReportPlanRequest *>(data);
+            std::string path = GetReportPlanPath(&request->address);
+
+            R_TRY(fs::EnsureDirectoryRecursively(GetControllerDirectory(&request->address).c_str()));
+
+            bool file_exists;
+            R_TRY(fs::HasFile(&file_exists, path.c_str()));
+            if (!file_exists) {
+                R_TRY(fs::CreateFile(path.c_str(), sizeof(HidDescriptorPlan)));
+            }
+
+            fs::FileHandle file;
+            R_TRY(fs::OpenFile(std::addressof(file), path.c_str(), fs::OpenMode_Write));
+            ON_SCOPE_EXIT { fs::CloseFile(file); };
+
+            return fs::WriteFile(file, 0, request->plan, sizeof(HidDescriptorPlan), fs::WriteOption::Flush);
+        }
+
+    }
+
+    Result UnknownController::Initialize(void) {
+        R_TRY(EmulatedSwitchController::Initialize());
+
+        // Devices we can't build a plan for still connect, reporting a neutral state
+        if (R_SUCCEEDED(this->InitializeReportPlan()))
+            m_plan_ready = true;
+
+        return ams::ResultSuccess();
+    }
+
+    Result UnknownController::InitializeReportPlan(void) {
+        // The report descriptor is stored in the pairing database along with the rest of the device's settings
+        bluetooth::DevicesSettings device_settings;
+        R_TRY(btdrvGetPairedDeviceInfo(m_address, &device_settings));
+
+        size_t descriptor_size = std::min<size_t>(device_settings.descriptor_length, sizeof(device_settings.descriptor));
+        if (descriptor_size == 0)
+            return -1;
+
+        uint32_t descriptor_crc = crc32Calculate(device_settings.descriptor, descriptor_size);
+
+        // Reuse the plan compiled on a previous connection if the descriptor hasn't changed since.
+        // The file could have been corrupted or edited, so the plan is only trusted once every field has been checked to lie within its report.
+        ReportPlanRequest request = { m_address, &m_plan };
+        if (R_SUCCEEDED(mitm::io::Execute(ReadReportPlanFunction, &request))) {
+            if ((m_plan.descriptor_crc == descriptor_crc) && ValidateHidDescriptorPlan(&m_plan))
+                return ams::ResultSuccess();
+        }
+
+        R_TRY(CompileHidReportDescriptor(device_settings.descriptor, descriptor_size, &m_plan));
+        m_plan.descriptor_crc = descriptor_crc;
+
+        // Failing to cache the plan only costs compiling it again next time
+        mitm::io::Execute(WriteReportPlanFunction, &request);
+
+        return ams::ResultSuccess();
+    }
+
+    void UnknownController::UpdateControllerState(const bluetooth::HidReport *report) {
+        if (m_plan_ready)
+            DecodeHidReport(&m_plan, report->data, report->size, &m_buttons, &m_left_stick, &m_right_stick);
+    }
+
+}
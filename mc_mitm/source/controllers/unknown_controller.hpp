@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "emulated_switch_controller.hpp"
+#include "hid_report_descriptor.hpp"
+#include <atomic>
+
+namespace ams::controller {
+
+    // Fallback for devices without a dedicated driver. Input reports are decoded generically from the device's HID report descriptor.
+    class UnknownController : public EmulatedSwitchController {
+
+        public:
+            UnknownController(const bluetooth::Address *address, HardwareID id)
+            : EmulatedSwitchController(address, id)
+            , m_plan_ready(false) {
+                m_colours.buttons = {0xff, 0x00, 0x00};
+            };
+
+            Result Initialize(void);
+
+        protected:
+            void UpdateControllerState(const bluetooth::HidReport *report);
+
+        private:
+            Result InitializeReportPlan(void);
+
+            HidDescriptorPlan m_plan;
+            std::atomic<bool> m_plan_ready;
+    };
+
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "virtual_controller.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace ams::controller {
+
+    namespace {
+
+        constexpr size_t state_ring_sharedmem_size = util::AlignUp(sizeof(VirtualControllerStateRing), os::MemoryPageSize);
+
+    }
+
+    VirtualController::VirtualController(const bluetooth::Address *address)
+    : EmulatedSwitchController(address, hardware_id)
+    , m_state_shmem(state_ring_sharedmem_size, os::MemoryPermission_ReadWrite, os::MemoryPermission_ReadWrite)
+    , m_state_ring(nullptr)
+    , m_read_sequence(0) { }
+
+    Result VirtualController::InitializeStateRing(void) {
+        void *address = m_state_shmem.Map(os::MemoryPermission_ReadWrite);
+        if (address == nullptr)
+            return -1;
+
+        m_state_ring = reinterpret_cast<VirtualControllerStateRing *>(address);
+
+        // Freshly created shared memory is zero filled, so only the header needs setting up
+        m_state_ring->header.magic       = VirtualControllerStateRingMagic;
+        m_state_ring->header.version     = VirtualControllerStateRingVersion;
+        m_state_ring->header.entry_count = VirtualControllerStateRingEntryCount;
+
+        return ams::ResultSuccess();
+    }
+
+    // Called once per input report, so the client's states are replayed at the report rate in the order they were written
+    void VirtualController::UpdateControllerState(const bluetooth::HidReport *report) {
+        AMS_UNUSED(report);
+
+        VirtualControllerState state;
+        if (!this->ReadNextState(&state))
+            return;
+
+        m_buttons     = state.buttons;
+        m_left_stick  = state.left_stick;
+        m_right_stick = state.right_stick;
+
+        m_battery   = std::min<uint8_t>(state.battery, BATTERY_MAX) & ~1;
+        m_charging  = (state.flags & VirtualControllerStateFlag_Charging) != 0;
+        m_ext_power = (state.flags & VirtualControllerStateFlag_ExternalPower) != 0;
+
+        this->PushMotionSample(os::GetSystemTick(), &state.motion);
+    }
+
+    bool VirtualController::ReadNextState(VirtualControllerState *state) {
+        // The client can write anything here at any time, so every state is copied out before it is looked at
+        uint64_t write_sequence = m_state_ring->header.write_sequence.load(std::memory_order_acquire);
+        if (write_sequence == m_read_sequence)
+            return false;
+
+        // Either the client restarted its sequence or it has lapped us. Carry on from the oldest state still held.
+        if ((write_sequence < m_read_sequence) || (write_sequence - m_read_sequence > VirtualControllerStateRingEntryCount))
+            m_read_sequence = write_sequence - std::min<uint64_t>(write_sequence, VirtualControllerStateRingEntryCount);
+
+        auto entry = &m_state_ring->entries[m_read_sequence % VirtualControllerStateRingEntryCount];
+
+        uint64_t sequence = entry->sequence.load(std::memory_order_acquire);
+        std::memcpy(state, &entry->state, sizeof(VirtualControllerState));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Skip anything overwritten while it was being read. The next report picks up from the oldest remaining state.
+        if ((sequence != m_read_sequence + 1) || (entry->sequence.load(std::memory_order_relaxed) != sequence)) {
+            m_read_sequence++;
+            return false;
+        }
+
+        m_read_sequence++;
+        return true;
+    }
+
+}
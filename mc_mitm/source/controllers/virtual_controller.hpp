@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "emulated_switch_controller.hpp"
+#include <atomic>
+
+namespace ams::controller {
+
+    // Shared memory ring of Switch-format controller states written by a client driving a virtual controller.
+    // The client publishes state n into slot (n % entry_count), setting that slot's sequence to n + 1 and then write_sequence to n + 1.
+    // One state is consumed per input report. A client that gets more than entry_count states ahead loses the oldest ones.
+    constexpr uint32_t VirtualControllerStateRingMagic      = 0x5356434d; // MCVS
+    constexpr uint16_t VirtualControllerStateRingVersion    = 1;
+    constexpr size_t   VirtualControllerStateRingEntryCount = 64;
+
+    enum VirtualControllerStateFlag : uint8_t {
+        VirtualControllerStateFlag_Charging      = (1 << 0),
+        VirtualControllerStateFlag_ExternalPower = (1 << 1),
+    };
+
+    struct VirtualControllerState {
+        SwitchButtonData  buttons;
+        SwitchAnalogStick left_stick;
+        SwitchAnalogStick right_stick;
+        uint8_t           battery;  // 0 - BATTERY_MAX
+        uint8_t           flags;
+        uint8_t           _pad;
+        Switch6AxisData   motion;
+    } __attribute__ ((__packed__));
+
+    struct VirtualControllerStateEntry {
+        std::atomic<uint64_t> sequence;
+        VirtualControllerState state;
+    };
+    static_assert(sizeof(VirtualControllerStateEntry) == 0x20);
+
+    struct VirtualControllerStateRingHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t entry_count;
+        std::atomic<uint64_t> write_sequence;
+        uint8_t _pad[0x30];
+    };
+    static_assert(sizeof(VirtualControllerStateRingHeader) == 0x40);
+
+    struct VirtualControllerStateRing {
+        VirtualControllerStateRingHeader header;
+        VirtualControllerStateEntry entries[VirtualControllerStateRingEntryCount];
+    };
+
+    class VirtualController : public EmulatedSwitchController {
+
+        public:
+            static constexpr const HardwareID hardware_id = {0x057e, 0x2009};
+
+            VirtualController(const bluetooth::Address *address);
+
+            // Maps the state ring. Must succeed before the controller is handed out or registered.
+            Result InitializeStateRing(void);
+
+            bool SupportsSetTsiCommand(void) { return false; }
+
+            os::NativeHandle GetSharedMemoryHandle(void) { return m_state_shmem.GetHandle(); }
+
+        protected:
+            void UpdateControllerState(const bluetooth::HidReport *report);
+
+        private:
+            bool ReadNextState(VirtualControllerState *state);
+
+            os::SharedMemory m_state_shmem;
+            VirtualControllerStateRing *m_state_ring;
+            uint64_t m_read_sequence;
+
+    };
+
+}
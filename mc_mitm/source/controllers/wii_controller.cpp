@@ -14,10 +14,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "wii_controller.hpp"
+#include "report_view.hpp"
 #include "controller_utils.hpp"
+#include "../mcmitm_config.hpp"
+#include "../mcmitm_trace.hpp"
 #include <stratosphere.hpp>
 #include <algorithm>
 #include <cstring>
+#include <mutex>
 
 namespace ams::controller {
 
@@ -31,39 +35,100 @@ namespace ams::controller {
         constexpr float left_stick_scale_factor      = float(UINT12_MAX) / 0x3f;
         constexpr float right_stick_scale_factor     = float(UINT12_MAX) / 0x1f;
 
+        // MotionPlus speeds are centred on 0x2000. Slow mode gives roughly 8192/595 counts per dps and fast mode is 2000/440 times coarser.
+        // Indexed by the per-axis slow mode flag.
+        constexpr int16_t motion_plus_zero = 0x2000;
+        constexpr int32_t motion_plus_scale_factors[] = {
+            GyroScaleFactor(8192, 2705),
+            GyroScaleFactor(8192, 595)
+        };
+
+        // MotionPlus activation modes written to 0x04a600fe
+        constexpr uint8_t motion_plus_mode_standalone[]          = {0x04};
+        constexpr uint8_t motion_plus_mode_nunchuck_passthrough[] = {0x05};
+        constexpr uint8_t motion_plus_mode_classic_passthrough[]  = {0x07};
+
+        // Memory accesses that haven't been acknowledged after this long are resent
+        constexpr TimeSpan command_timeout = TimeSpan::FromMilliSeconds(100);
+        constexpr unsigned int command_max_retries = 3;
+
+        // Scales a stick reading about its centre, saturating at the ends of the range rather than wrapping
+        uint16_t ScaleStickValue(float scale_factor, int offset) {
+            return static_cast<uint16_t>(std::clamp(scale_factor * offset + STICK_ZERO, 0.0f, float(UINT12_MAX)));
+        }
+
     }
 
     Result WiiController::Initialize(void) {
         R_TRY(EmulatedSwitchController::Initialize());
-        R_TRY(this->SetReportMode(0x31));
 
-        return this->QueryStatus();
+        // Start out in the state the controller was last seen in. Both are revalidated below.
+        if (m_profile.flags & ControllerProfileFlag_Calibration) {
+            this->MapAccelerometerCalibration(reinterpret_cast<const WiiAccelerometerCalibrationData *>(m_profile.calibration));
+        }
+
+        uint8_t report_mode = 0x31;
+        if (m_profile.flags & ControllerProfileFlag_Extension) {
+            m_extension = static_cast<WiiExtensionController>(m_profile.extension);
+            m_extension_unverified = true;
+            report_mode = m_profile.report_mode;
+        }
+
+        R_TRY(this->SetReportMode(report_mode));
+
+        // Read accelerometer calibration
+        return this->ReadMemory(0x0016, sizeof(WiiAccelerometerCalibrationData));
+    }
+
+    void WiiController::SetReady(void) {
+        EmulatedSwitchController::SetReady();
+
+        // The status report isn't retried through the command queue, so only ask for it once replies are no longer dropped
+        this->QueryStatus();
     }
 
     void WiiController::UpdateControllerState(const bluetooth::HidReport *report) {
         auto wii_report = reinterpret_cast<const WiiReportData *>(&report->data);
 
+        // Check for timed out commands on every input report
+        this->ProcessCommandQueue();
+
         switch(wii_report->id) {
             case 0x20:  // status
-                this->HandleInputReport0x20(wii_report);
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x20>(report))
+                    this->HandleInputReport0x20(src);
                 break;
             case 0x21:  // memory read
-                this->HandleInputReport0x21(wii_report);
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x21>(report))
+                    this->HandleInputReport0x21(src);
                 break;
             case 0x22:  // ack
-                this->HandleInputReport0x22(wii_report);
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x22>(report))
+                    this->HandleInputReport0x22(src);
                 break;
             case 0x30:
-                this->HandleInputReport0x30(wii_report);
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x30>(report))
+                    this->HandleInputReport0x30(src);
                 break;
             case 0x31:
-                this->HandleInputReport0x31(wii_report);
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x31>(report))
+                    this->HandleInputReport0x31(src);
                 break;
             case 0x32:
-                this->HandleInputReport0x32(wii_report);
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x32>(report))
+                    this->HandleInputReport0x32(src);
                 break;
             case 0x34:
-                this->HandleInputReport0x34(wii_report);
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x34>(report))
+                    this->HandleInputReport0x34(src);
+                break;
+            case 0x35:
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x35>(report))
+                    this->HandleInputReport0x35(src);
+                break;
+            case 0x37:
+                if (auto src = GetReportView<WiiReportData, WiiInputReport0x37>(report))
+                    this->HandleInputReport0x37(src);
                 break;
             default:
                 break;
@@ -72,13 +137,34 @@ namespace ams::controller {
 
     void WiiController::HandleInputReport0x20(const WiiReportData *src) {
         if (!src->input0x20.extension_connected) {
+            // Don't leave the sticks and buttons of an unplugged extension held
+            if (m_extension != WiiExtensionController_None) {
+                this->ClearControllerState();
+            }
+
             m_extension = WiiExtensionController_None;
-            this->SetReportMode(0x31);
+            m_extension_unverified = false;
+
+            // The extension may briefly appear disconnected while a MotionPlus switches to active mode
+            if (m_motion_plus_status != WiiMotionPlusStatus_Activating) {
+                // Any pending initialisation commands are for an extension that is no longer present
+                this->FlushCommandQueue();
+                this->SetReportMode(0x31);
+
+                // Check for a MotionPlus that isn't yet active, or one that has been unplugged
+                if (m_motion_plus_status != WiiMotionPlusStatus_NotPresent) {
+                    m_motion_plus_status = WiiMotionPlusStatus_Unknown;
+                    this->ProbeMotionPlus();
+                }
+            }
         }
-        else if (src->input0x20.extension_connected && (m_extension == WiiExtensionController_None)) {
-            // Initialise extension
-            this->WriteMemory(0x04a400f0, init_data1, sizeof(init_data1));
-            this->WriteMemory(0x04a400fb, init_data2, sizeof(init_data2));
+        else if (src->input0x20.extension_connected && ((m_extension == WiiExtensionController_None) || m_extension_unverified)) {
+            // An active MotionPlus is mapped over the extension registers and would be deactivated by the usual initialisation sequence
+            if ((m_motion_plus_status != WiiMotionPlusStatus_Activating) && (m_motion_plus_status != WiiMotionPlusStatus_Active)) {
+                // Initialise extension
+                this->WriteMemory(0x04a400f0, init_data1, sizeof(init_data1));
+                this->WriteMemory(0x04a400fb, init_data2, sizeof(init_data2));
+            }
 
             // Read extension type
             this->ReadMemory(0x04a400fa, 6);
@@ -92,44 +178,104 @@ namespace ams::controller {
     void WiiController::HandleInputReport0x21(const WiiReportData *src) {
         uint16_t read_addr = util::SwapBytes(src->input0x21.address);
 
+        this->CompleteCommand(0x17, read_addr, src->input0x21.error);
+
+        if (read_addr == 0x0016) {
+            if (!src->input0x21.error) {
+                this->MapAccelerometerCalibration(reinterpret_cast<const WiiAccelerometerCalibrationData *>(&src->input0x21.data));
+
+                if (!(m_profile.flags & ControllerProfileFlag_Calibration) || (std::memcmp(m_profile.calibration, &src->input0x21.data, sizeof(WiiAccelerometerCalibrationData)) != 0)) {
+                    std::memcpy(m_profile.calibration, &src->input0x21.data, sizeof(WiiAccelerometerCalibrationData));
+                    m_profile.flags |= ControllerProfileFlag_Calibration;
+                    this->SaveProfile();
+                }
+            }
+            return;
+        }
+
         if (read_addr == 0x00fa) {
             // Identify extension controller by ID
-            uint64_t extension_id = (util::SwapBytes(*reinterpret_cast<const uint64_t *>(&src->input0x21.data)) >> 16);
+            uint64_t extension_id;
+            std::memcpy(&extension_id, &src->input0x21.data, sizeof(extension_id));
+            extension_id = util::SwapBytes(extension_id) >> 16;
+
+            if (m_motion_plus_status == WiiMotionPlusStatus_Probing) {
+                // Reading the inactive MotionPlus registers fails if there isn't one attached
+                if (!src->input0x21.error && (extension_id == 0x0000A6200005ULL)) {
+                    this->ActivateMotionPlus();
+                }
+                else {
+                    m_motion_plus_status = WiiMotionPlusStatus_NotPresent;
+                }
+                return;
+            }
 
+            uint8_t report_mode;
             switch (extension_id) {
                 case 0x0000A4200000ULL:
                 case 0xFF00A4200000ULL:
                     m_extension = WiiExtensionController_Nunchuck;
-                    this->SetReportMode(0x32);
+                    report_mode = this->GetExtensionReportMode();
                     break;
                 case 0x0000A4200101ULL:
                     m_extension = WiiExtensionController_Classic;
-                    this->SetReportMode(0x32);
+                    report_mode = this->GetExtensionReportMode();
                     break;
                 case 0x0100A4200101ULL:
                     m_extension = WiiExtensionController_ClassicPro;
-                    this->SetReportMode(0x32);
+                    report_mode = this->GetExtensionReportMode();
                     break;
                 case 0x0000a4200120ULL:
                     m_extension = WiiExtensionController_WiiUPro;
-                    this->SetReportMode(0x34);
+                    report_mode = 0x34;
                     break;
                 case 0x0000a4200111ULL:
                     m_extension = WiiExtensionController_TaTaCon;
-                    this->SetReportMode(0x32);
+                    report_mode = this->GetExtensionReportMode();
+                    break;
+                case 0x0000A4200405ULL:
+                    m_extension = WiiExtensionController_None;
+                    m_motion_plus_status = WiiMotionPlusStatus_Active;
+                    report_mode = this->GetExtensionReportMode();
+                    break;
+                case 0x0000A4200505ULL:
+                    m_extension = WiiExtensionController_Nunchuck;
+                    m_motion_plus_status = WiiMotionPlusStatus_Active;
+                    report_mode = this->GetExtensionReportMode();
+                    break;
+                case 0x0000A4200705ULL:
+                    m_extension = WiiExtensionController_Classic;
+                    m_motion_plus_status = WiiMotionPlusStatus_Active;
+                    report_mode = this->GetExtensionReportMode();
                     break;
                 default:
                     m_extension = WiiExtensionController_Unsupported;
-                    this->SetReportMode(0x31);
+                    report_mode = 0x31;
                     break;
             }
+
+            this->SetReportMode(report_mode);
+            m_extension_unverified = false;
+
+            // Remember the extension so that it can be decoded straight away on reconnect
+            if (!(m_profile.flags & ControllerProfileFlag_Extension) || (m_profile.extension != m_extension) || (m_profile.report_mode != report_mode)) {
+                m_profile.flags |= ControllerProfileFlag_Extension;
+                m_profile.extension = m_extension;
+                m_profile.report_mode = report_mode;
+                this->SaveProfile();
+            }
+
+            // Extensions can be attached through a MotionPlus. Check for one now that the extension is known
+            if (m_motion_plus_status == WiiMotionPlusStatus_Unknown) {
+                this->ProbeMotionPlus();
+            }
         }
 
         this->ClearControllerState();
     }
 
     void WiiController::HandleInputReport0x22(const WiiReportData *src) {
-        AMS_UNUSED(src);
+        this->CompleteCommand(src->input0x22.report_id, 0, src->input0x22.error);
     }
 
     void WiiController::HandleInputReport0x30(const WiiReportData *src) {
@@ -138,8 +284,8 @@ namespace ams::controller {
 
     void WiiController::HandleInputReport0x31(const WiiReportData *src) {
         this->MapButtonsHorizontalOrientation(&src->input0x31.buttons);
-
-        // Todo: Accelerometer data
+        this->MapAccelerometerData(&src->input0x31.buttons, &src->input0x31.accel);
+        this->PushMotionData();
     }
 
     void WiiController::HandleInputReport0x32(const WiiReportData *src) {
@@ -163,6 +309,38 @@ namespace ams::controller {
         this->MapExtensionBytes(src->input0x34.extension);
     }
 
+    void WiiController::HandleInputReport0x35(const WiiReportData *src) {
+        if ((m_extension == WiiExtensionController_Nunchuck)
+         || (m_extension == WiiExtensionController_Classic)
+         || (m_extension == WiiExtensionController_ClassicPro)
+         || (m_extension == WiiExtensionController_TaTaCon)) {
+            this->MapButtonsVerticalOrientation(&src->input0x35.buttons);
+        }
+        else {
+            this->MapButtonsHorizontalOrientation(&src->input0x35.buttons);
+        }
+
+        this->MapAccelerometerData(&src->input0x35.buttons, &src->input0x35.accel);
+        this->MapExtensionBytes(src->input0x35.extension);
+        this->PushMotionData();
+    }
+
+    void WiiController::HandleInputReport0x37(const WiiReportData *src) {
+        if ((m_extension == WiiExtensionController_Nunchuck)
+         || (m_extension == WiiExtensionController_Classic)
+         || (m_extension == WiiExtensionController_ClassicPro)
+         || (m_extension == WiiExtensionController_TaTaCon)) {
+            this->MapButtonsVerticalOrientation(&src->input0x37.buttons);
+        }
+        else {
+            this->MapButtonsHorizontalOrientation(&src->input0x37.buttons);
+        }
+
+        this->MapAccelerometerData(&src->input0x37.buttons, &src->input0x37.accel);
+        this->MapExtensionBytes(src->input0x37.extension);
+        this->PushMotionData();
+    }
+
     void WiiController::MapButtonsHorizontalOrientation(const WiiButtonData *buttons) {
         m_buttons.dpad_down  = buttons->dpad_left;
         m_buttons.dpad_up    = buttons->dpad_right;
@@ -201,6 +379,32 @@ namespace ams::controller {
     }
 
     void WiiController::MapExtensionBytes(const uint8_t ext[]) {
+        uint8_t passthrough[6];
+
+        if (m_motion_plus_status == WiiMotionPlusStatus_Active) {
+            // MotionPlus data is interleaved with that of any passthrough extension
+            if (reinterpret_cast<const WiiMotionPlusExtensionData *>(ext)->motionplus_data) {
+                this->MapMotionPlusExtension(ext);
+                return;
+            }
+
+            // Restore the regular data layout for passthrough extensions. Their least significant bits are lost to make room for MotionPlus flags.
+            std::memcpy(passthrough, ext, sizeof(passthrough));
+            switch(m_extension) {
+                case WiiExtensionController_Nunchuck:
+                    passthrough[5] = (ext[5] >> 2) & 0x03;
+                    break;
+                case WiiExtensionController_Classic:
+                    passthrough[0] &= 0xfe;
+                    passthrough[1] &= 0xfe;
+                    passthrough[5] = (ext[5] & 0xfc) | ((ext[1] & 0x01) << 1) | (ext[0] & 0x01);
+                    break;
+                default:
+                    break;
+            }
+            ext = passthrough;
+        }
+
         switch(m_extension) {
             case WiiExtensionController_Nunchuck:
                 this->MapNunchuckExtension(ext);
@@ -224,8 +428,8 @@ namespace ams::controller {
         auto extension = reinterpret_cast<const WiiNunchuckExtensionData *>(ext);
 
         m_left_stick.SetData(
-            std::clamp<uint16_t>(static_cast<uint16_t>(nunchuck_stick_scale_factor * (extension->stick_x - 0x80) + STICK_ZERO), 0, 0xfff),
-            std::clamp<uint16_t>(static_cast<uint16_t>(nunchuck_stick_scale_factor * (extension->stick_y - 0x80) + STICK_ZERO), 0, 0xfff)
+            ScaleStickValue(nunchuck_stick_scale_factor, extension->stick_x - 0x80),
+            ScaleStickValue(nunchuck_stick_scale_factor, extension->stick_y - 0x80)
         );
 
         m_buttons.L  = !extension->C;
@@ -234,12 +438,12 @@ namespace ams::controller {
 
     void WiiController::MapClassicControllerExtension(const uint8_t ext[]) {
         m_left_stick.SetData(
-            static_cast<uint16_t>(left_stick_scale_factor * ((ext[0] & 0x3f) - 0x20) + STICK_ZERO) & 0xfff,
-            static_cast<uint16_t>(left_stick_scale_factor * ((ext[1] & 0x3f) - 0x20) + STICK_ZERO) & 0xfff
+            ScaleStickValue(left_stick_scale_factor, (ext[0] & 0x3f) - 0x20),
+            ScaleStickValue(left_stick_scale_factor, (ext[1] & 0x3f) - 0x20)
         );
         m_right_stick.SetData(
-            static_cast<uint16_t>(right_stick_scale_factor * ((((ext[0] >> 3) & 0x18) | ((ext[1] >> 5) & 0x06) | ((ext[2] >> 7) & 0x01)) - 0x10) + STICK_ZERO) & 0xfff,
-            static_cast<uint16_t>(right_stick_scale_factor * ((ext[2] & 0x1f) - 0x10) + STICK_ZERO) & 0xfff
+            ScaleStickValue(right_stick_scale_factor, (((ext[0] >> 3) & 0x18) | ((ext[1] >> 5) & 0x06) | ((ext[2] >> 7) & 0x01)) - 0x10),
+            ScaleStickValue(right_stick_scale_factor, (ext[2] & 0x1f) - 0x10)
         );
 
         auto buttons = reinterpret_cast<const WiiClassicControllerButtonData *>(&ext[4]);
@@ -269,12 +473,12 @@ namespace ams::controller {
         auto extension = reinterpret_cast<const WiiUProExtensionData *>(ext);
 
         m_left_stick.SetData(
-            std::clamp<uint16_t>(((wiiu_scale_factor * (extension->left_stick_x - STICK_ZERO))) + STICK_ZERO, 0, 0xfff),
-            std::clamp<uint16_t>(((wiiu_scale_factor * (extension->left_stick_y - STICK_ZERO))) + STICK_ZERO, 0, 0xfff)
+            ScaleStickValue(wiiu_scale_factor, extension->left_stick_x - STICK_ZERO),
+            ScaleStickValue(wiiu_scale_factor, extension->left_stick_y - STICK_ZERO)
         );
         m_right_stick.SetData(
-            std::clamp<uint16_t>(((wiiu_scale_factor * (extension->right_stick_x - STICK_ZERO))) + STICK_ZERO, 0, 0xfff),
-            std::clamp<uint16_t>(((wiiu_scale_factor * (extension->right_stick_y - STICK_ZERO))) + STICK_ZERO, 0, 0xfff)
+            ScaleStickValue(wiiu_scale_factor, extension->right_stick_x - STICK_ZERO),
+            ScaleStickValue(wiiu_scale_factor, extension->right_stick_y - STICK_ZERO)
         );
 
         m_buttons.dpad_down  = !extension->buttons.dpad_down;
@@ -314,44 +518,159 @@ namespace ams::controller {
         m_buttons.dpad_right |= !extension->L_center;
     }
 
+    void WiiController::MapMotionPlusExtension(const uint8_t ext[]) {
+        auto extension = reinterpret_cast<const WiiMotionPlusExtensionData *>(ext);
+
+        m_gyro[0] = ScaleMotionValue(((extension->pitch_speed_138 << 8) | extension->pitch_speed_70) - motion_plus_zero, motion_plus_scale_factors[extension->pitch_slow_mode]);
+        m_gyro[1] = ScaleMotionValue(((extension->roll_speed_138  << 8) | extension->roll_speed_70)  - motion_plus_zero, motion_plus_scale_factors[extension->roll_slow_mode]);
+        m_gyro[2] = ScaleMotionValue(((extension->yaw_speed_138   << 8) | extension->yaw_speed_70)   - motion_plus_zero, motion_plus_scale_factors[extension->yaw_slow_mode]);
+    }
+
+    void WiiController::MapAccelerometerData(const WiiButtonData *buttons, const WiiAccelerometerData *accel) {
+        // Only bit 1 of the y and z LSBs is reported
+        const int16_t raw[] = {
+            static_cast<int16_t>((accel->x << 2) | buttons->accel_x_10),
+            static_cast<int16_t>((accel->y << 2) | (buttons->accel_y_1 << 1)),
+            static_cast<int16_t>((accel->z << 2) | (buttons->accel_z_1 << 1))
+        };
+
+        for (unsigned int i = 0; i < 3; ++i) {
+            m_accel[i] = ScaleMotionValue(raw[i] - m_accel_zero[i], m_accel_scale_factor[i]);
+        }
+    }
+
+    void WiiController::MapAccelerometerCalibration(const WiiAccelerometerCalibrationData *calib) {
+        const int16_t zero[] = {
+            static_cast<int16_t>((calib->zero_92.x << 2) | calib->zero_x_10),
+            static_cast<int16_t>((calib->zero_92.y << 2) | calib->zero_y_10),
+            static_cast<int16_t>((calib->zero_92.z << 2) | calib->zero_z_10)
+        };
+        const int16_t one_g[] = {
+            static_cast<int16_t>((calib->one_g_92.x << 2) | calib->one_g_x_10),
+            static_cast<int16_t>((calib->one_g_92.y << 2) | calib->one_g_y_10),
+            static_cast<int16_t>((calib->one_g_92.z << 2) | calib->one_g_z_10)
+        };
+
+        for (unsigned int i = 0; i < 3; ++i) {
+            // Keep the nominal calibration for axes with implausible values
+            if (one_g[i] > zero[i]) {
+                m_accel_zero[i] = zero[i];
+                m_accel_scale_factor[i] = AccelScaleFactor(one_g[i] - zero[i]);
+            }
+        }
+    }
+
+    void WiiController::PushMotionData(void) {
+        if (!m_enable_motion)
+            return;
+
+        // Wii Remote axes are x left, y forward and z up. Remap according to how the controller is being held.
+        Switch6AxisData sample;
+        if ((m_extension == WiiExtensionController_Nunchuck)
+         || (m_extension == WiiExtensionController_Classic)
+         || (m_extension == WiiExtensionController_ClassicPro)
+         || (m_extension == WiiExtensionController_TaTaCon)) {
+            sample = {
+                .accel_x = m_accel[1],
+                .accel_y = m_accel[0],
+                .accel_z = m_accel[2],
+                .gyro_1  = m_gyro[1],
+                .gyro_2  = m_gyro[0],
+                .gyro_3  = m_gyro[2]
+            };
+        }
+        else {
+            sample = {
+                .accel_x = static_cast<int16_t>(-m_accel[0]),
+                .accel_y = m_accel[1],
+                .accel_z = m_accel[2],
+                .gyro_1  = static_cast<int16_t>(-m_gyro[0]),
+                .gyro_2  = m_gyro[1],
+                .gyro_3  = m_gyro[2]
+            };
+        }
+
+        // The Wii Remote doesn't timestamp its reports
+        this->PushMotionSample(os::GetSystemTick(), &sample);
+    }
+
+    uint8_t WiiController::GetExtensionReportMode(void) {
+        // Report 0x35 carries accelerometer and extension data in a single packet
+        return mitm::GetGlobalConfig()->general.enable_motion ? 0x35 : 0x32;
+    }
+
+    Result WiiController::ProbeMotionPlus(void) {
+        // Any Wii Remote can host a MotionPlus, including the Wii Remote Plus, which shares its pid with the Wii U Pro Controller.
+        // The Wii U Pro Controller is told apart by its extension instead.
+        if (!mitm::GetGlobalConfig()->general.enable_motion || (m_extension == WiiExtensionController_WiiUPro)) {
+            m_motion_plus_status = WiiMotionPlusStatus_NotPresent;
+            return ams::ResultSuccess();
+        }
+
+        m_motion_plus_status = WiiMotionPlusStatus_Probing;
+        return this->ReadMemory(0x04a600fa, 6);
+    }
+
+    Result WiiController::ActivateMotionPlus(void) {
+        const uint8_t *mode;
+        switch (m_extension) {
+            case WiiExtensionController_None:
+                mode = motion_plus_mode_standalone;
+                break;
+            case WiiExtensionController_Nunchuck:
+                mode = motion_plus_mode_nunchuck_passthrough;
+                break;
+            case WiiExtensionController_Classic:
+            case WiiExtensionController_ClassicPro:
+                mode = motion_plus_mode_classic_passthrough;
+                break;
+            default:
+                // Other extensions can't be passed through. Leave the MotionPlus inactive so they keep working.
+                m_motion_plus_status = WiiMotionPlusStatus_NotPresent;
+                return ams::ResultSuccess();
+        }
+
+        // The extension is identified again once the MotionPlus reports itself active
+        m_extension = WiiExtensionController_None;
+        m_motion_plus_status = WiiMotionPlusStatus_Activating;
+
+        return this->WriteMemory(0x04a600fe, mode, 1);
+    }
+
     Result WiiController::WriteMemory(uint32_t write_addr, const uint8_t *data, uint8_t size) {
-        m_output_report.size = sizeof(WiiOutputReport0x16) + 1;
-        auto report_data = reinterpret_cast<WiiReportData *>(m_output_report.data);
-        report_data->id = 0x16;
-        report_data->output0x16.address = ams::util::SwapBytes(write_addr);
-        report_data->output0x16.size = size;
-        std::memcpy(&report_data->output0x16.data, data, size);
+        WiiReportData report = {};
+        report.id = 0x16;
+        report.output0x16.address = ams::util::SwapBytes(write_addr);
+        report.output0x16.size = size;
+        std::memcpy(&report.output0x16.data, data, size);
 
-        return bluetooth::hid::report::SendHidReport(&m_address, &m_output_report);
+        return this->QueueCommand(&report, sizeof(WiiOutputReport0x16) + 1);
     }
 
     Result WiiController::ReadMemory(uint32_t read_addr, uint16_t size) {
-        m_output_report.size = sizeof(WiiOutputReport0x17) + 1;
-        auto report_data = reinterpret_cast<WiiReportData *>(m_output_report.data);
-        report_data->id = 0x17;
-        report_data->output0x17.address = ams::util::SwapBytes(read_addr);
-        report_data->output0x17.size = ams::util::SwapBytes(size);
+        WiiReportData report = {};
+        report.id = 0x17;
+        report.output0x17.address = ams::util::SwapBytes(read_addr);
+        report.output0x17.size = ams::util::SwapBytes(size);
 
-        return bluetooth::hid::report::SendHidReport(&m_address, &m_output_report);
+        return this->QueueCommand(&report, sizeof(WiiOutputReport0x17) + 1);
     }
 
     Result WiiController::SetReportMode(uint8_t mode) {
-        m_output_report.size = sizeof(WiiOutputReport0x12) + 1;
-        auto report_data = reinterpret_cast<WiiReportData *>(m_output_report.data);
-        report_data->id = 0x12;
-        report_data->output0x12.rumble = m_rumble_state;
-        report_data->output0x12.report_mode = mode;
+        WiiReportData report = {};
+        report.id = 0x12;
+        report.output0x12.rumble = m_rumble_state;
+        report.output0x12.report_mode = mode;
 
-        return bluetooth::hid::report::SendHidReport(&m_address, &m_output_report);
+        return this->SendOutputReport(&report, sizeof(WiiOutputReport0x12) + 1);
     }
 
     Result WiiController::QueryStatus(void) {
-        m_output_report.size = sizeof(WiiOutputReport0x15) + 1;
-        auto report_data = reinterpret_cast<WiiReportData *>(m_output_report.data);
-        report_data->id = 0x15;
-        report_data->output0x15.rumble = m_rumble_state;
+        WiiReportData report = {};
+        report.id = 0x15;
+        report.output0x15.rumble = m_rumble_state;
 
-        return bluetooth::hid::report::SendHidReport(&m_address, &m_output_report);
+        return this->SendOutputReport(&report, sizeof(WiiOutputReport0x15) + 1);
     }
 
     Result WiiController::SetVibration(const SwitchRumbleData *rumble_data) {
@@ -360,33 +679,162 @@ namespace ams::controller {
                          rumble_data[1].low_band_amp > 0 ||
                          rumble_data[1].high_band_amp > 0;
 
-        m_output_report.size = sizeof(WiiOutputReport0x10) + 1;
-        auto report_data = reinterpret_cast<WiiReportData *>(m_output_report.data);
-        report_data->id = 0x10;
-        report_data->output0x10.rumble = m_rumble_state;
+        WiiReportData report = {};
+        report.id = 0x10;
+        report.output0x10.rumble = m_rumble_state;
 
-        return bluetooth::hid::report::SendHidReport(&m_address, &m_output_report);
+        return this->SendOutputReport(&report, sizeof(WiiOutputReport0x10) + 1);
     }
 
     Result WiiController::CancelVibration(void) {
         m_rumble_state = 0;
 
-        m_output_report.size = sizeof(WiiOutputReport0x10) + 1;
-        auto report_data = reinterpret_cast<WiiReportData *>(m_output_report.data);
-        report_data->id = 0x10;
-        report_data->output0x10.rumble = m_rumble_state;
+        WiiReportData report = {};
+        report.id = 0x10;
+        report.output0x10.rumble = m_rumble_state;
 
-        return bluetooth::hid::report::SendHidReport(&m_address, &m_output_report);
+        return this->SendOutputReport(&report, sizeof(WiiOutputReport0x10) + 1);
     }
 
     Result WiiController::SetPlayerLed(uint8_t led_mask) {
-        m_output_report.size = sizeof(WiiOutputReport0x11) + 1;
-        auto report_data = reinterpret_cast<WiiReportData *>(m_output_report.data);
-        report_data->id = 0x11;
-        report_data->output0x11.rumble = m_rumble_state;
-        report_data->output0x11.leds = led_mask & 0xf;
+        WiiReportData report = {};
+        report.id = 0x11;
+        report.output0x11.rumble = m_rumble_state;
+        report.output0x11.leds = led_mask & 0xf;
+
+        return this->SendOutputReport(&report, sizeof(WiiOutputReport0x11) + 1);
+    }
+
+    Result WiiController::SendOutputReport(const WiiReportData *report, size_t size) {
+        // Output is sent from both the IPC and hid report threads. Build each report on the stack rather than sharing m_output_report.
+        bluetooth::HidReport output_report;
+        output_report.size = size;
+        std::memcpy(output_report.data, report, size);
+
+        return bluetooth::hid::report::SendHidReport(&m_address, &output_report);
+    }
+
+    Result WiiController::QueueCommand(const WiiReportData *report, size_t size) {
+        {
+            std::scoped_lock lk(m_command_lock);
+
+            constexpr size_t queue_size = sizeof(m_command_queue) / sizeof(m_command_queue[0]);
+            if (m_command_queue_count == queue_size)
+                return -1;
+
+            auto command = &m_command_queue[(m_command_queue_head + m_command_queue_count) % queue_size];
+            command->size = size;
+            std::memcpy(&command->report, report, size);
+            ++m_command_queue_count;
+        }
 
-        return bluetooth::hid::report::SendHidReport(&m_address, &m_output_report);
+        this->ProcessCommandQueue();
+
+        return ams::ResultSuccess();
+    }
+
+    void WiiController::CompleteCommand(uint8_t id, uint16_t address, uint8_t error) {
+        WiiReportData failed_command;
+        bool command_failed = false;
+
+        {
+            std::scoped_lock lk(m_command_lock);
+
+            if (!m_command_in_flight)
+                return;
+
+            auto command = &m_command_queue[m_command_queue_head];
+            if (command->report.id != id)
+                return;
+
+            // Memory reads are matched by the low 16 bits of their address
+            if ((id == 0x17) && ((util::SwapBytes(command->report.output0x17.address) & 0xffff) != address))
+                return;
+
+            // Errors reported by the controller are final. Only commands that go unanswered are retried.
+            if (error) {
+                failed_command = command->report;
+                command_failed = true;
+            }
+
+            m_command_queue_head = (m_command_queue_head + 1) % (sizeof(m_command_queue) / sizeof(m_command_queue[0]));
+            --m_command_queue_count;
+            m_command_in_flight = false;
+        }
+
+        // A read of the MotionPlus registers is expected to fail when there isn't one attached, which is handled with the 0x21 report itself
+        if (command_failed && !((id == 0x17) && (m_motion_plus_status == WiiMotionPlusStatus_Probing))) {
+            this->HandleCommandFailure(&failed_command);
+        }
+
+        this->ProcessCommandQueue();
+    }
+
+    void WiiController::ProcessCommandQueue(void) {
+        WiiReportData failed_command;
+        bool command_failed = false;
+
+        {
+            std::scoped_lock lk(m_command_lock);
+
+            constexpr size_t queue_size = sizeof(m_command_queue) / sizeof(m_command_queue[0]);
+
+            if (m_command_in_flight && (os::ConvertToTimeSpan(os::GetSystemTick() - m_command_tick) >= command_timeout)) {
+                auto command = &m_command_queue[m_command_queue_head];
+                if (m_command_retries < command_max_retries) {
+                    ++m_command_retries;
+                    m_command_tick = os::GetSystemTick();
+                    this->SendOutputReport(&command->report, command->size);
+                }
+                else {
+                    mitm::trace::RecordAddress(mitm::trace::TraceEvent_WiiCommandTimeout, m_address.address, command->report.id);
+
+                    failed_command = command->report;
+                    command_failed = true;
+
+                    m_command_queue_head = (m_command_queue_head + 1) % queue_size;
+                    --m_command_queue_count;
+                    m_command_in_flight = false;
+                }
+            }
+
+            if (!m_command_in_flight && (m_command_queue_count > 0)) {
+                auto command = &m_command_queue[m_command_queue_head];
+                m_command_in_flight = true;
+                m_command_retries = 0;
+                m_command_tick = os::GetSystemTick();
+                this->SendOutputReport(&command->report, command->size);
+            }
+        }
+
+        if (command_failed) {
+            this->HandleCommandFailure(&failed_command);
+        }
+    }
+
+    void WiiController::FlushCommandQueue(void) {
+        std::scoped_lock lk(m_command_lock);
+
+        m_command_queue_head = 0;
+        m_command_queue_count = 0;
+        m_command_in_flight = false;
+    }
+
+    void WiiController::HandleCommandFailure(const WiiReportData *report) {
+        uint32_t address = util::SwapBytes((report->id == 0x16) ? report->output0x16.address : report->output0x17.address);
+
+        if ((address & 0xffff0000) == 0x04a60000) {
+            // MotionPlus didn't respond. Leave it inactive and fall back to the regular extension handling
+            m_motion_plus_status = WiiMotionPlusStatus_NotPresent;
+            this->FlushCommandQueue();
+            this->QueryStatus();
+        }
+        else if ((address & 0xffff0000) == 0x04a40000) {
+            // Give up on the extension until it is reconnected
+            m_extension = WiiExtensionController_Unsupported;
+            this->FlushCommandQueue();
+            this->SetReportMode(0x31);
+        }
     }
 
 }
@@ -35,12 +35,21 @@ namespace ams::controller {
         WiiExtensionController_Unsupported,
     };
 
+    enum WiiMotionPlusStatus {
+        WiiMotionPlusStatus_Unknown,
+        WiiMotionPlusStatus_Probing,
+        WiiMotionPlusStatus_NotPresent,
+        WiiMotionPlusStatus_Activating,
+        WiiMotionPlusStatus_Active,
+    };
+
     struct WiiButtonData {
         uint8_t dpad_left   : 1;
         uint8_t dpad_right  : 1;
         uint8_t dpad_down   : 1;
         uint8_t dpad_up     : 1;
         uint8_t plus        : 1;
+        uint8_t accel_x_10  : 2;    // Accelerometer LSBs in reports that carry accelerometer data
         uint8_t             : 0;
         
         uint8_t two         : 1;
@@ -48,7 +57,8 @@ namespace ams::controller {
         uint8_t B           : 1;
         uint8_t A           : 1;
         uint8_t minus       : 1;
-        uint8_t             : 2;
+        uint8_t accel_y_1   : 1;
+        uint8_t accel_z_1   : 1;
         uint8_t home        : 1;
     } __attribute__ ((__packed__));
 
@@ -58,6 +68,19 @@ namespace ams::controller {
         uint8_t z;
     } __attribute__ ((__packed__));
 
+    struct WiiAccelerometerCalibrationData {
+        WiiAccelerometerData zero_92;
+        uint8_t zero_z_10   : 2;
+        uint8_t zero_y_10   : 2;
+        uint8_t zero_x_10   : 2;
+        uint8_t             : 0;
+        WiiAccelerometerData one_g_92;
+        uint8_t one_g_z_10  : 2;
+        uint8_t one_g_y_10  : 2;
+        uint8_t one_g_x_10  : 2;
+        uint8_t             : 0;
+    } __attribute__ ((__packed__));
+
     struct WiiClassicControllerButtonData {
         uint8_t             : 1;
         uint8_t R           : 1;
@@ -92,6 +115,24 @@ namespace ams::controller {
         uint8_t accel_z_10 : 2; 
     } __attribute__ ((__packed__));
 
+    struct WiiMotionPlusExtensionData {
+        uint8_t yaw_speed_70;
+        uint8_t roll_speed_70;
+        uint8_t pitch_speed_70;
+
+        uint8_t pitch_slow_mode     : 1;
+        uint8_t yaw_slow_mode       : 1;
+        uint8_t yaw_speed_138       : 6;
+
+        uint8_t extension_connected : 1;
+        uint8_t roll_slow_mode      : 1;
+        uint8_t roll_speed_138      : 6;
+
+        uint8_t                     : 1;
+        uint8_t motionplus_data     : 1;
+        uint8_t pitch_speed_138     : 6;
+    } __attribute__ ((__packed__));
+
     struct WiiUProButtonData {
         uint8_t             : 1;
         uint8_t R           : 1;
@@ -198,57 +239,70 @@ namespace ams::controller {
         uint8_t         _pad[2];
         uint8_t         battery;
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x20) == 0x06);
 
     struct WiiInputReport0x21 {
         WiiButtonData buttons;
-        uint8_t       size  : 4;
         uint8_t       error : 4;
+        uint8_t       size  : 4;    // Bytes read minus one
         uint16_t      address;
         uint8_t       data[16];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x21) == 0x15);
+    static_assert(offsetof(WiiInputReport0x21, address) == 0x03);
+    static_assert(offsetof(WiiInputReport0x21, data) == 0x05);
 
     struct WiiInputReport0x22 {
         WiiButtonData   buttons;
         uint8_t         report_id;
         uint8_t         error;
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x22) == 0x04);
 
     struct WiiInputReport0x30 {
         WiiButtonData   buttons;
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x30) == 0x02);
 
     struct WiiInputReport0x31 {
         WiiButtonData           buttons;
         WiiAccelerometerData    accel;
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x31) == 0x05);
 
     struct WiiInputReport0x32 {
         WiiButtonData   buttons;
         uint8_t         extension[8];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x32) == 0x0a);
 
     struct WiiInputReport0x33 {
         WiiButtonData           buttons;
         WiiAccelerometerData    accel;
         uint8_t                 ir[12];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x33) == 0x11);
 
     struct WiiInputReport0x34 {
         WiiButtonData           buttons;
         uint8_t                 extension[19];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x34) == 0x15);
 
     struct WiiInputReport0x35 {
         WiiButtonData           buttons;
         WiiAccelerometerData    accel;
         uint8_t                 extension[16];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x35) == 0x15);
+    static_assert(offsetof(WiiInputReport0x35, extension) == 0x05);
 
     struct WiiInputReport0x36 {
         WiiButtonData   buttons;
         uint8_t         ir[10];
         uint8_t         extension[9];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x36) == 0x15);
 
     struct WiiInputReport0x37 {
         WiiButtonData           buttons;
@@ -256,10 +310,14 @@ namespace ams::controller {
         uint8_t                 ir[10];
         uint8_t                 extension[6];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x37) == 0x15);
+    static_assert(offsetof(WiiInputReport0x37, ir) == 0x05);
+    static_assert(offsetof(WiiInputReport0x37, extension) == 0x0f);
 
     struct WiiInputReport0x3d {
         uint8_t extension[21];
     } __attribute__ ((__packed__));
+    static_assert(sizeof(WiiInputReport0x3d) == 0x15);
 
     struct WiiReportData {
         uint8_t id;
@@ -288,6 +346,15 @@ namespace ams::controller {
         };
     } __attribute__ ((__packed__));
 
+    struct WiiOutputCommand {
+        size_t size;
+        WiiReportData report;
+    };
+
+    // Nominal 10-bit accelerometer calibration, used until the controller's own has been read from EEPROM
+    constexpr int16_t WiiAccelDefaultZero        = 0x200;
+    constexpr int32_t WiiAccelDefaultScaleFactor = AccelScaleFactor(0x68);
+
     class WiiController : public EmulatedSwitchController {
 
         public:
@@ -299,9 +366,20 @@ namespace ams::controller {
             WiiController(const bluetooth::Address *address, HardwareID id)
             : EmulatedSwitchController(address, id)
             , m_extension(WiiExtensionController_None)
-            , m_rumble_state(0) { }
+            , m_extension_unverified(false)
+            , m_motion_plus_status(WiiMotionPlusStatus_Unknown)
+            , m_rumble_state(0)
+            , m_accel_zero{WiiAccelDefaultZero, WiiAccelDefaultZero, WiiAccelDefaultZero}
+            , m_accel_scale_factor{WiiAccelDefaultScaleFactor, WiiAccelDefaultScaleFactor, WiiAccelDefaultScaleFactor}
+            , m_accel{0, 0, 0}
+            , m_gyro{0, 0, 0}
+            , m_command_queue_head(0)
+            , m_command_queue_count(0)
+            , m_command_in_flight(false)
+            , m_command_retries(0) { }
 
             Result Initialize(void);
+            void SetReady(void);
             Result SetVibration(const SwitchRumbleData *rumble_data);
             Result CancelVibration(void);
             Result SetPlayerLed(uint8_t led_mask);
@@ -315,6 +393,8 @@ namespace ams::controller {
             void HandleInputReport0x31(const WiiReportData *src);
             void HandleInputReport0x32(const WiiReportData *src);
             void HandleInputReport0x34(const WiiReportData *src);
+            void HandleInputReport0x35(const WiiReportData *src);
+            void HandleInputReport0x37(const WiiReportData *src);
 
             void MapButtonsHorizontalOrientation(const WiiButtonData *buttons);
             void MapButtonsVerticalOrientation(const WiiButtonData *buttons);
@@ -324,6 +404,15 @@ namespace ams::controller {
             void MapClassicControllerExtension(const uint8_t ext[]);
             void MapWiiUProControllerExtension(const uint8_t ext[]);
             void MapTaTaConExtension(const uint8_t ext[]);
+            void MapMotionPlusExtension(const uint8_t ext[]);
+
+            void MapAccelerometerData(const WiiButtonData *buttons, const WiiAccelerometerData *accel);
+            void MapAccelerometerCalibration(const WiiAccelerometerCalibrationData *calib);
+            void PushMotionData(void);
+
+            uint8_t GetExtensionReportMode(void);
+            Result ProbeMotionPlus(void);
+            Result ActivateMotionPlus(void);
 
             Result WriteMemory(uint32_t write_addr, const uint8_t *data, uint8_t size);
             Result ReadMemory(uint32_t read_addr, uint16_t size);
@@ -331,8 +420,34 @@ namespace ams::controller {
             Result SetReportMode(uint8_t mode);
             Result QueryStatus(void);
 
+            Result SendOutputReport(const WiiReportData *report, size_t size);
+
+            Result QueueCommand(const WiiReportData *report, size_t size);
+            void CompleteCommand(uint8_t id, uint16_t address, uint8_t error);
+            void ProcessCommandQueue(void);
+            void FlushCommandQueue(void);
+            void HandleCommandFailure(const WiiReportData *report);
+
             WiiExtensionController m_extension;
+            bool m_extension_unverified;
+            WiiMotionPlusStatus m_motion_plus_status;
             bool m_rumble_state;
+
+            int16_t m_accel_zero[3];
+            int32_t m_accel_scale_factor[3];
+
+            // Latest motion readings in the Wii Remote's frame of reference
+            int16_t m_accel[3];
+            int16_t m_gyro[3];
+
+            // Memory accesses are sent one at a time and retried until acknowledged, so extension initialisation can't be lost
+            os::SdkMutex m_command_lock;
+            WiiOutputCommand m_command_queue[8];
+            size_t m_command_queue_head;
+            size_t m_command_queue_count;
+            bool m_command_in_flight;
+            unsigned int m_command_retries;
+            os::Tick m_command_tick;
     };
 
 }
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "xbox_one_controller.hpp"
+#include "report_view.hpp"
 #include <stratosphere.hpp>
 #include <cstring>
 
@@ -44,20 +45,39 @@ namespace ams::controller {
 
         switch(xbox_report->id) {
             case 0x01:
-                this->HandleInputReport0x01(xbox_report, report->size >= sizeof(XboxOneInputReport0x01) + 1);
+                if (m_input_report0x01_format == XboxOneReportFormat_Unknown) {
+                    if (report->size >= sizeof(XboxOneInputReport0x01) + 1) {
+                        m_input_report0x01_format = XboxOneReportFormat_Current;
+                        m_input_report0x01_size = sizeof(XboxOneInputReport0x01) + 1;
+                    }
+                    else if (report->size >= XboxOneInputReport0x01OldSize + 1) {
+                        m_input_report0x01_format = XboxOneReportFormat_Old;
+                        m_input_report0x01_size = XboxOneInputReport0x01OldSize + 1;
+                    }
+                }
+
+                if (report->size < m_input_report0x01_size)
+                    break;
+
+                if (m_input_report0x01_format == XboxOneReportFormat_Current)
+                    this->HandleInputReport0x01(xbox_report);
+                else
+                    this->HandleInputReport0x01Old(xbox_report);
                 break;
             case 0x02:
-                this->HandleInputReport0x02(xbox_report);
+                if (auto src = GetReportView<XboxOneReportData, XboxOneInputReport0x02>(report))
+                    this->HandleInputReport0x02(src);
                 break;
             case 0x04:
-                this->HandleInputReport0x04(xbox_report);
+                if (auto src = GetReportView<XboxOneReportData, XboxOneInputReport0x04>(report))
+                    this->HandleInputReport0x04(src);
                 break;
             default:
                 break;
         }
     }
 
-    void XboxOneController::HandleInputReport0x01(const XboxOneReportData *src, bool new_format) {
+    void XboxOneController::HandleInputReport0x01Analog(const XboxOneReportData *src) {
         m_left_stick.SetData(
             static_cast<uint16_t>(stick_scale_factor * src->input0x01.left_stick.x) & 0xfff,
             static_cast<uint16_t>(stick_scale_factor * (UINT16_MAX - src->input0x01.left_stick.y)) & 0xfff
@@ -69,65 +89,70 @@ namespace ams::controller {
 
         m_buttons.ZR = src->input0x01.right_trigger > 0;
         m_buttons.ZL = src->input0x01.left_trigger > 0;
+    }
 
-        if (new_format) {
-            m_buttons.dpad_down  = (src->input0x01.buttons.dpad == XboxOneDPad_S)  ||
-                                   (src->input0x01.buttons.dpad == XboxOneDPad_SE) ||
-                                   (src->input0x01.buttons.dpad == XboxOneDPad_SW);
-            m_buttons.dpad_up    = (src->input0x01.buttons.dpad == XboxOneDPad_N)  ||
-                                   (src->input0x01.buttons.dpad == XboxOneDPad_NE) ||
-                                   (src->input0x01.buttons.dpad == XboxOneDPad_NW);
-            m_buttons.dpad_right = (src->input0x01.buttons.dpad == XboxOneDPad_E)  ||
-                                   (src->input0x01.buttons.dpad == XboxOneDPad_NE) ||
-                                   (src->input0x01.buttons.dpad == XboxOneDPad_SE);
-            m_buttons.dpad_left  = (src->input0x01.buttons.dpad == XboxOneDPad_W)  ||
-                                   (src->input0x01.buttons.dpad == XboxOneDPad_NW) ||
-                                   (src->input0x01.buttons.dpad == XboxOneDPad_SW);
-
-            m_buttons.A = src->input0x01.buttons.B;
-            m_buttons.B = src->input0x01.buttons.A;
-            m_buttons.X = src->input0x01.buttons.Y;
-            m_buttons.Y = src->input0x01.buttons.X;
-
-            m_buttons.R = src->input0x01.buttons.RB;
-            m_buttons.L = src->input0x01.buttons.LB;
-
-            m_buttons.minus = src->input0x01.buttons.view;
-            m_buttons.plus  = src->input0x01.buttons.menu;
-
-            m_buttons.lstick_press = src->input0x01.buttons.lstick_press;
-            m_buttons.rstick_press = src->input0x01.buttons.rstick_press;
-
-            m_buttons.home = src->input0x01.buttons.guide;
-        }
-        else {
-            m_buttons.dpad_down  = (src->input0x01.old.buttons.dpad == XboxOneDPad_S)  ||
-                                   (src->input0x01.old.buttons.dpad == XboxOneDPad_SE) ||
-                                   (src->input0x01.old.buttons.dpad == XboxOneDPad_SW);
-            m_buttons.dpad_up    = (src->input0x01.old.buttons.dpad == XboxOneDPad_N)  ||
-                                   (src->input0x01.old.buttons.dpad == XboxOneDPad_NE) ||
-                                   (src->input0x01.old.buttons.dpad == XboxOneDPad_NW);
-            m_buttons.dpad_right = (src->input0x01.old.buttons.dpad == XboxOneDPad_E)  ||
-                                   (src->input0x01.old.buttons.dpad == XboxOneDPad_NE) ||
-                                   (src->input0x01.old.buttons.dpad == XboxOneDPad_SE);
-            m_buttons.dpad_left  = (src->input0x01.old.buttons.dpad == XboxOneDPad_W)  ||
-                                   (src->input0x01.old.buttons.dpad == XboxOneDPad_NW) ||
-                                   (src->input0x01.old.buttons.dpad == XboxOneDPad_SW);
-
-            m_buttons.A = src->input0x01.old.buttons.B;
-            m_buttons.B = src->input0x01.old.buttons.A;
-            m_buttons.X = src->input0x01.old.buttons.Y;
-            m_buttons.Y = src->input0x01.old.buttons.X;
-
-            m_buttons.R = src->input0x01.old.buttons.RB;
-            m_buttons.L = src->input0x01.old.buttons.LB;
-
-            m_buttons.minus = src->input0x01.old.buttons.view;
-            m_buttons.plus  = src->input0x01.old.buttons.menu;
-
-            m_buttons.lstick_press = src->input0x01.old.buttons.lstick_press;
-            m_buttons.rstick_press = src->input0x01.old.buttons.rstick_press;
-        }
+    void XboxOneController::HandleInputReport0x01(const XboxOneReportData *src) {
+        this->HandleInputReport0x01Analog(src);
+
+        m_buttons.dpad_down  = (src->input0x01.buttons.dpad == XboxOneDPad_S)  ||
+                               (src->input0x01.buttons.dpad == XboxOneDPad_SE) ||
+                               (src->input0x01.buttons.dpad == XboxOneDPad_SW);
+        m_buttons.dpad_up    = (src->input0x01.buttons.dpad == XboxOneDPad_N)  ||
+                               (src->input0x01.buttons.dpad == XboxOneDPad_NE) ||
+                               (src->input0x01.buttons.dpad == XboxOneDPad_NW);
+        m_buttons.dpad_right = (src->input0x01.buttons.dpad == XboxOneDPad_E)  ||
+                               (src->input0x01.buttons.dpad == XboxOneDPad_NE) ||
+                               (src->input0x01.buttons.dpad == XboxOneDPad_SE);
+        m_buttons.dpad_left  = (src->input0x01.buttons.dpad == XboxOneDPad_W)  ||
+                               (src->input0x01.buttons.dpad == XboxOneDPad_NW) ||
+                               (src->input0x01.buttons.dpad == XboxOneDPad_SW);
+
+        m_buttons.A = src->input0x01.buttons.B;
+        m_buttons.B = src->input0x01.buttons.A;
+        m_buttons.X = src->input0x01.buttons.Y;
+        m_buttons.Y = src->input0x01.buttons.X;
+
+        m_buttons.R = src->input0x01.buttons.RB;
+        m_buttons.L = src->input0x01.buttons.LB;
+
+        m_buttons.minus = src->input0x01.buttons.view;
+        m_buttons.plus  = src->input0x01.buttons.menu;
+
+        m_buttons.lstick_press = src->input0x01.buttons.lstick_press;
+        m_buttons.rstick_press = src->input0x01.buttons.rstick_press;
+
+        m_buttons.home = src->input0x01.buttons.guide;
+    }
+
+    void XboxOneController::HandleInputReport0x01Old(const XboxOneReportData *src) {
+        this->HandleInputReport0x01Analog(src);
+
+        m_buttons.dpad_down  = (src->input0x01.old.buttons.dpad == XboxOneDPad_S)  ||
+                               (src->input0x01.old.buttons.dpad == XboxOneDPad_SE) ||
+                               (src->input0x01.old.buttons.dpad == XboxOneDPad_SW);
+        m_buttons.dpad_up    = (src->input0x01.old.buttons.dpad == XboxOneDPad_N)  ||
+                               (src->input0x01.old.buttons.dpad == XboxOneDPad_NE) ||
+                               (src->input0x01.old.buttons.dpad == XboxOneDPad_NW);
+        m_buttons.dpad_right = (src->input0x01.old.buttons.dpad == XboxOneDPad_E)  ||
+                               (src->input0x01.old.buttons.dpad == XboxOneDPad_NE) ||
+                               (src->input0x01.old.buttons.dpad == XboxOneDPad_SE);
+        m_buttons.dpad_left  = (src->input0x01.old.buttons.dpad == XboxOneDPad_W)  ||
+                               (src->input0x01.old.buttons.dpad == XboxOneDPad_NW) ||
+                               (src->input0x01.old.buttons.dpad == XboxOneDPad_SW);
+
+        m_buttons.A = src->input0x01.old.buttons.B;
+        m_buttons.B = src->input0x01.old.buttons.A;
+        m_buttons.X = src->input0x01.old.buttons.Y;
+        m_buttons.Y = src->input0x01.old.buttons.X;
+
+        m_buttons.R = src->input0x01.old.buttons.RB;
+        m_buttons.L = src->input0x01.old.buttons.LB;
+
+        m_buttons.minus = src->input0x01.old.buttons.view;
+        m_buttons.plus  = src->input0x01.old.buttons.menu;
+
+        m_buttons.lstick_press = src->input0x01.old.buttons.lstick_press;
+        m_buttons.rstick_press = src->input0x01.old.buttons.rstick_press;
     }
 
     void XboxOneController::HandleInputReport0x02(const XboxOneReportData *src) {
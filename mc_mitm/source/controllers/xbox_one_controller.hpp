@@ -108,11 +108,18 @@ namespace ams::controller {
             } old;
         };
     } __attribute__ ((__packed__));
+    static_assert(sizeof(XboxOneInputReport0x01) == 0x10);
+    static_assert(offsetof(XboxOneInputReport0x01, left_trigger) == 0x08);
+    static_assert(offsetof(XboxOneInputReport0x01, buttons) == 0x0c);
+
+    // Reports from older firmware end after the shorter button data
+    constexpr size_t XboxOneInputReport0x01OldSize = sizeof(XboxOneInputReport0x01) - sizeof(XboxOneButtonData) + sizeof(XboxOneButtonDataOld);
 
     struct XboxOneInputReport0x02{
         uint8_t guide   : 1;
         uint8_t         : 0; 
     } __attribute__ ((__packed__));
+    static_assert(sizeof(XboxOneInputReport0x02) == 0x01);
 
     struct XboxOneInputReport0x04 {
         uint8_t capacity : 2;
@@ -121,6 +128,7 @@ namespace ams::controller {
         uint8_t          : 2;
         uint8_t online   : 1;
     } __attribute__ ((__packed__));
+    static_assert(sizeof(XboxOneInputReport0x04) == 0x01);
  
     struct XboxOneReportData {
         uint8_t id;
@@ -132,6 +140,12 @@ namespace ams::controller {
         };
     } __attribute__ ((__packed__));
 
+    enum XboxOneReportFormat : uint8_t {
+        XboxOneReportFormat_Unknown,
+        XboxOneReportFormat_Old,
+        XboxOneReportFormat_Current
+    };
+
     class XboxOneController : public EmulatedSwitchController {
 
         public:
@@ -144,7 +158,9 @@ namespace ams::controller {
             };  
 
             XboxOneController(const bluetooth::Address *address, HardwareID id) 
-            : EmulatedSwitchController(address, id) { }
+            : EmulatedSwitchController(address, id)
+            , m_input_report0x01_format(XboxOneReportFormat_Unknown)
+            , m_input_report0x01_size(UINT16_MAX) { }
 
             bool SupportsSetTsiCommand(void) { return false; }
 
@@ -152,10 +168,18 @@ namespace ams::controller {
             void UpdateControllerState(const bluetooth::HidReport *report);
 
         private:
-            void HandleInputReport0x01(const XboxOneReportData *src, bool new_format);
+            void HandleInputReport0x01(const XboxOneReportData *src);
+            void HandleInputReport0x01Old(const XboxOneReportData *src);
+            void HandleInputReport0x01Analog(const XboxOneReportData *src);
             void HandleInputReport0x02(const XboxOneReportData *src);
             void HandleInputReport0x04(const XboxOneReportData *src);
 
+            // The button layout of report 0x01 depends on the controller firmware, and is told apart by the report length.
+            // This is worked out from the first report long enough for either layout and kept for the rest of the connection.
+            // Until then the size is too large for any report, so that a single length check drops what can't be decoded.
+            XboxOneReportFormat m_input_report0x01_format;
+            uint16_t m_input_report0x01_size;
+
     };
 
 }
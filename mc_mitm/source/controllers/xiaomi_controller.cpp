@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "xiaomi_controller.hpp"
+#include "report_view.hpp"
 #include "controller_utils.hpp"
 #include <stratosphere.hpp>
 
@@ -40,7 +41,8 @@ namespace ams::controller {
 
         switch(xiaomi_report->id) {
             case 0x04:
-                this->HandleInputReport0x04(xiaomi_report);
+                if (auto src = GetReportView<XiaomiReportData, XiaomiInputReport0x04>(report))
+                    this->HandleInputReport0x04(src);
                 break;
             default:
                 break;
@@ -73,6 +73,7 @@ namespace ams::controller {
         uint8_t  home   : 1;
         uint8_t         : 0;
     } __attribute__((packed));
+    static_assert(sizeof(XiaomiInputReport0x04) == 0x14);
 
     struct XiaomiReportData {
         uint8_t id;
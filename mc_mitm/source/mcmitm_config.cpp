@@ -16,6 +16,7 @@
 #include <stratosphere.hpp>
 #include <cstring>
 #include "mcmitm_config.hpp"
+#include "mcmitm_io.hpp"
 
 namespace ams::mitm {
 
@@ -29,7 +30,8 @@ namespace ams::mitm {
                 .enable_motion = true
             },
             .misc = {
-                .disable_sony_leds = false
+                .disable_sony_leds = false,
+                .report_redirect_timeout = 16
             }
         };
 
@@ -40,6 +42,13 @@ namespace ams::mitm {
                 *out = false; 
         }
 
+        void ParseInteger(const char *value, uint32_t *out) {
+            char *end;
+            auto result = std::strtoul(value, &end, 10);
+            if ((end != value) && (*end == '\0'))
+                *out = static_cast<uint32_t>(result);
+        }
+
         void ParseBluetoothAddress(const char *value, bluetooth::Address *out) {
             // Check length of address string is correct
             if (std::strlen(value) != 3*sizeof(bluetooth::Address) - 1) return;
@@ -78,6 +87,8 @@ namespace ams::mitm {
             else if (strcasecmp(section, "misc") == 0) {
                 if (strcasecmp(name, "disable_sony_leds") == 0)
                     ParseBoolean(value, &config->misc.disable_sony_leds);
+                else if (strcasecmp(name, "report_redirect_timeout") == 0)
+                    ParseInteger(value, &config->misc.report_redirect_timeout);
             }
             else {
                 return 0;
@@ -86,6 +97,24 @@ namespace ams::mitm {
             return 1;
         }
 
+        Result ParseIniConfigFunction(void *data) {
+            AMS_UNUSED(data);
+
+            /* Open the file. */
+            fs::FileHandle file;
+            {
+                if (R_FAILED(fs::OpenFile(std::addressof(file), config_file_location, fs::OpenMode_Read))) {
+                    return ams::ResultSuccess();
+                }
+            }
+            ON_SCOPE_EXIT { fs::CloseFile(file); };
+
+            /* Parse the config. */
+            util::ini::ParseFile(file, &g_global_config, ConfigIniHandler);
+
+            return ams::ResultSuccess();
+        }
+
     }
 
     MissionControlConfig *GetGlobalConfig(void) {
@@ -93,17 +122,7 @@ namespace ams::mitm {
     }
 
     void ParseIniConfig(void) {
-        /* Open the file. */
-        fs::FileHandle file;
-        {
-            if (R_FAILED(fs::OpenFile(std::addressof(file), config_file_location, fs::OpenMode_Read))) {
-                return;
-            }
-        }
-        ON_SCOPE_EXIT { fs::CloseFile(file); };
-
-        /* Parse the config. */
-        util::ini::ParseFile(file, &g_global_config, ConfigIniHandler);
+        R_ABORT_UNLESS(io::Execute(ParseIniConfigFunction, nullptr));
     }
 
 }
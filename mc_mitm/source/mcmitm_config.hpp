@@ -30,6 +30,7 @@ namespace ams::mitm {
 
         struct {
             bool disable_sony_leds;
+            uint32_t report_redirect_timeout;
         } misc;
     };
 
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mcmitm_heap.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace ams::mitm {
+
+    namespace {
+
+        // Sizes from allocations seen in practice: shared_ptr and vector storage, profile paths and I/O bookkeeping at the small end, controllers well above the largest class
+        struct SlabClassConfig {
+            size_t block_size;
+            size_t block_count;
+        };
+
+        constexpr SlabClassConfig slab_class_configs[SlabClassCount] = {
+            { 0x20,  128 },
+            { 0x40,  64  },
+            { 0x80,  32  },
+            { 0x100, 16  },
+        };
+
+        constexpr size_t GetSlabMemorySize(void) {
+            size_t size = 0;
+            for (auto &config : slab_class_configs)
+                size += config.block_size * config.block_count;
+            return size;
+        }
+
+        constexpr size_t SlabMemorySize   = GetSlabMemorySize();
+        constexpr size_t FsHeapSize       = 16_KB;
+        constexpr size_t GeneralHeapSize  = 64_KB - SlabMemorySize - FsHeapSize;
+
+        class SlabClass {
+
+            public:
+                constexpr SlabClass(void) : m_lock(), m_start(0), m_end(0), m_block_size(0), m_block_count(0), m_free_list(nullptr), m_used(0), m_used_max(0), m_allocations(0), m_overflows(0) { }
+
+                void Initialize(uint8_t *memory, size_t block_size, size_t block_count) {
+                    m_start = reinterpret_cast<uintptr_t>(memory);
+                    m_end = m_start + block_size * block_count;
+                    m_block_size = block_size;
+                    m_block_count = block_count;
+
+                    for (size_t i = block_count; i > 0; --i) {
+                        auto block = reinterpret_cast<FreeBlock *>(memory + (i - 1) * block_size);
+                        block->next = m_free_list;
+                        m_free_list = block;
+                    }
+                }
+
+                size_t BlockSize(void) const { return m_block_size; }
+
+                bool Contains(const void *p) const {
+                    auto address = reinterpret_cast<uintptr_t>(p);
+                    return (address >= m_start) && (address < m_end);
+                }
+
+                void *Allocate(void) {
+                    std::scoped_lock lk(m_lock);
+
+                    if (!m_free_list) {
+                        m_overflows++;
+                        return nullptr;
+                    }
+
+                    auto block = m_free_list;
+                    m_free_list = block->next;
+
+                    m_allocations++;
+                    m_used_max = std::max(++m_used, m_used_max);
+
+                    return block;
+                }
+
+                void Free(void *p) {
+                    std::scoped_lock lk(m_lock);
+
+                    auto block = reinterpret_cast<FreeBlock *>(p);
+                    block->next = m_free_list;
+                    m_free_list = block;
+
+                    m_used--;
+                }
+
+                void GetStatistics(SlabClassStatistics *stats) {
+                    std::scoped_lock lk(m_lock);
+
+                    stats->block_size  = m_block_size;
+                    stats->block_count = m_block_count;
+                    stats->used        = m_used;
+                    stats->used_max    = m_used_max;
+                    stats->allocations = m_allocations;
+                    stats->overflows   = m_overflows;
+                }
+
+            private:
+                struct FreeBlock {
+                    FreeBlock *next;
+                };
+
+                os::SdkMutex m_lock;
+                uintptr_t m_start;
+                uintptr_t m_end;
+                uint32_t m_block_size;
+                uint32_t m_block_count;
+                FreeBlock *m_free_list;
+                uint32_t m_used;
+                uint32_t m_used_max;
+                uint64_t m_allocations;
+                uint64_t m_overflows;
+
+        };
+
+        // Exp heap with usage counters. Sizes are those of the blocks handed out, so include the allocator's rounding.
+        class HeapArena {
+
+            public:
+                constexpr HeapArena(void) : m_handle(), m_size(0), m_used(0), m_used_max(0), m_allocations(0), m_failed_allocations(0) { }
+
+                void Initialize(void *memory, size_t size) {
+                    m_handle = lmem::CreateExpHeap(memory, size, lmem::CreateOption_ThreadSafe);
+                    m_size = size;
+                }
+
+                void *Allocate(size_t size) {
+                    void *p = lmem::AllocateFromExpHeap(m_handle, size);
+                    if (AMS_UNLIKELY(p == nullptr)) {
+                        m_failed_allocations++;
+                        return nullptr;
+                    }
+
+                    m_allocations++;
+
+                    size_t used = m_used += lmem::GetExpHeapMemoryBlockSize(p);
+                    size_t used_max = m_used_max.load();
+                    while ((used > used_max) && !m_used_max.compare_exchange_weak(used_max, used));
+
+                    return p;
+                }
+
+                void Free(void *p) {
+                    m_used -= lmem::GetExpHeapMemoryBlockSize(p);
+                    lmem::FreeToExpHeap(m_handle, p);
+                }
+
+                void GetStatistics(HeapArenaStatistics *stats) {
+                    stats->size               = m_size;
+                    stats->used               = m_used;
+                    stats->used_max           = m_used_max;
+                    stats->allocations        = m_allocations;
+                    stats->failed_allocations = m_failed_allocations;
+                }
+
+            private:
+                lmem::HeapHandle m_handle;
+                size_t m_size;
+                std::atomic<size_t> m_used;
+                std::atomic<size_t> m_used_max;
+                std::atomic<uint64_t> m_allocations;
+                std::atomic<uint64_t> m_failed_allocations;
+
+        };
+
+        alignas(0x40) constinit u8 g_slab_memory[SlabMemorySize];
+        alignas(0x40) constinit u8 g_fs_heap_memory[FsHeapSize];
+        alignas(0x40) constinit u8 g_general_heap_memory[GeneralHeapSize];
+
+        constinit SlabClass g_slab_classes[SlabClassCount];
+        constinit HeapArena g_fs_heap;
+        constinit HeapArena g_general_heap;
+
+        constinit bool g_heap_initialized;
+        constinit os::SdkMutex g_heap_init_mutex;
+
+        // Static constructors allocate before main runs, so everything is set up on first use
+        void EnsureInitialized(void) {
+            if (AMS_UNLIKELY(!g_heap_initialized)) {
+                std::scoped_lock lk(g_heap_init_mutex);
+
+                if (AMS_LIKELY(!g_heap_initialized)) {
+                    uint8_t *slab_memory = g_slab_memory;
+                    for (size_t i = 0; i < SlabClassCount; ++i) {
+                        g_slab_classes[i].Initialize(slab_memory, slab_class_configs[i].block_size, slab_class_configs[i].block_count);
+                        slab_memory += slab_class_configs[i].block_size * slab_class_configs[i].block_count;
+                    }
+
+                    g_fs_heap.Initialize(g_fs_heap_memory, sizeof(g_fs_heap_memory));
+                    g_general_heap.Initialize(g_general_heap_memory, sizeof(g_general_heap_memory));
+
+                    g_heap_initialized = true;
+                }
+            }
+        }
+
+    }
+
+    void *Allocate(size_t size) {
+        EnsureInitialized();
+
+        for (auto &slab : g_slab_classes) {
+            if (size <= slab.BlockSize()) {
+                if (void *p = slab.Allocate(); p != nullptr)
+                    return p;
+                break;
+            }
+        }
+
+        return g_general_heap.Allocate(size);
+    }
+
+    void Deallocate(void *p, size_t size) {
+        AMS_UNUSED(size);
+
+        if (p == nullptr)
+            return;
+
+        for (auto &slab : g_slab_classes) {
+            if (slab.Contains(p)) {
+                slab.Free(p);
+                return;
+            }
+        }
+
+        g_general_heap.Free(p);
+    }
+
+    void *AllocateForFs(size_t size) {
+        EnsureInitialized();
+        return g_fs_heap.Allocate(size);
+    }
+
+    void DeallocateForFs(void *p, size_t size) {
+        AMS_UNUSED(size);
+
+        if (p == nullptr)
+            return;
+
+        g_fs_heap.Free(p);
+    }
+
+    void GetHeapStatistics(HeapArenaStatistics *general, HeapArenaStatistics *fs) {
+        EnsureInitialized();
+
+        g_general_heap.GetStatistics(general);
+        g_fs_heap.GetStatistics(fs);
+    }
+
+    void GetSlabStatistics(SlabClassStatistics *stats, size_t count) {
+        EnsureInitialized();
+
+        for (size_t i = 0; i < std::min(count, SlabClassCount); ++i) {
+            g_slab_classes[i].GetStatistics(&stats[i]);
+        }
+    }
+
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stratosphere.hpp>
+
+namespace ams::mitm {
+
+    constexpr size_t SlabClassCount = 4;
+
+    struct HeapArenaStatistics {
+        uint64_t size;
+        uint64_t used;
+        uint64_t used_max;
+        uint64_t allocations;
+        uint64_t failed_allocations;
+    };
+
+    struct SlabClassStatistics {
+        uint32_t block_size;
+        uint32_t block_count;
+        uint32_t used;
+        uint32_t used_max;
+        uint64_t allocations;
+        uint64_t overflows;     // Allocations passed on to the general heap because the class was full
+    };
+
+    // Small allocations are served from fixed size slab classes, anything larger or overflowing from the general heap
+    void *Allocate(size_t size);
+    void Deallocate(void *p, size_t size);
+
+    // fs gets its own arena so that its allocations can't fragment the one used for controllers
+    void *AllocateForFs(size_t size);
+    void DeallocateForFs(void *p, size_t size);
+
+    void GetHeapStatistics(HeapArenaStatistics *general, HeapArenaStatistics *fs);
+    void GetSlabStatistics(SlabClassStatistics *stats, size_t count);
+
+}
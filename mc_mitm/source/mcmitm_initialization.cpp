@@ -17,6 +17,7 @@
 #include <switch.h>
 #include "mcmitm_initialization.hpp"
 #include "mcmitm_config.hpp"
+#include "mcmitm_thread_stack.hpp"
 #include "bluetooth_mitm/btdrv_mitm_service.hpp"
 #include "bluetooth_mitm/bluetoothmitm_module.hpp"
 #include "btm_mitm/btmmitm_module.hpp"
@@ -24,6 +25,7 @@
 #include "bluetooth_mitm/bluetooth/bluetooth_core.hpp"
 #include "bluetooth_mitm/bluetooth/bluetooth_hid.hpp"
 #include "bluetooth_mitm/bluetooth/bluetooth_ble.hpp"
+#include "controllers/controller_management.hpp"
 
 namespace ams::mitm {
 
@@ -37,6 +39,9 @@ namespace ams::mitm {
         os::Event g_init_event(os::EventClearMode_ManualClear);
 
         void InitializeThreadFunc(void *) {
+            // Start controller attach thread
+            R_ABORT_UNLESS(ams::controller::Initialize());
+
             // Start bluetooth event handling thread
             ams::bluetooth::events::Initialize();
 
@@ -84,6 +89,7 @@ namespace ams::mitm {
     }
 
     void StartInitialize(void) {
+        PaintThreadStack("initialize", g_initialize_thread_stack, sizeof(g_initialize_thread_stack));
         R_ABORT_UNLESS(os::CreateThread(&g_initialize_thread,
             InitializeThreadFunc,
             nullptr,
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mcmitm_io.hpp"
+#include "mcmitm_thread_stack.hpp"
+#include "mcmitm_trace.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <cstring>
+
+namespace ams::mitm::io {
+
+    namespace {
+
+        constexpr size_t IoThreadStackSize = 0x2000;
+        constexpr s32 IoThreadPriority = 24;
+        constexpr size_t IoQueueSize = 32;
+
+        struct IoRequest {
+            IoFunction function;
+            IoCallback callback;
+            os::Tick submit_tick;
+            alignas(std::max_align_t) uint8_t data[IoRequestDataSize];
+        };
+
+        struct ExecuteContext {
+            IoFunction function;
+            void *data;
+            Result result;
+            os::Event *event;
+        };
+
+        os::ThreadType g_io_thread;
+        alignas(os::ThreadStackAlignment) uint8_t g_io_thread_stack[IoThreadStackSize];
+
+        os::Mutex g_queue_lock(false);
+        os::Event g_request_event(os::EventClearMode_AutoClear);
+
+        IoRequest g_requests[IoQueueSize];
+        size_t g_queue_head;
+        size_t g_queue_count;
+
+        IoStatistics g_statistics;
+
+        Result ExecuteFunction(void *data) {
+            auto context = *reinterpret_cast<ExecuteContext **>(data);
+            return context->function(context->data);
+        }
+
+        void ExecuteCallback(Result result, void *data) {
+            auto context = *reinterpret_cast<ExecuteContext **>(data);
+            context->result = result;
+            context->event->Signal();
+        }
+
+        void IoThreadFunc(void *) {
+            while (true) {
+                g_request_event.Wait();
+
+                while (true) {
+                    IoRequest *request;
+                    {
+                        std::scoped_lock lk(g_queue_lock);
+                        if (g_queue_count == 0)
+                            break;
+
+                        // The slot stays reserved until the request has completed, so producers never write over it
+                        request = &g_requests[g_queue_head];
+                    }
+
+                    auto start_tick = os::GetSystemTick();
+                    Result rc = request->function(request->data);
+                    if (request->callback)
+                        request->callback(rc, request->data);
+                    auto end_tick = os::GetSystemTick();
+
+                    uint64_t wait_time = os::ConvertToTimeSpan(start_tick - request->submit_tick).GetMicroSeconds();
+                    uint64_t service_time = os::ConvertToTimeSpan(end_tick - start_tick).GetMicroSeconds();
+
+                    std::scoped_lock lk(g_queue_lock);
+                    g_queue_head = (g_queue_head + 1) % IoQueueSize;
+                    --g_queue_count;
+
+                    g_statistics.queue_depth = g_queue_count;
+                    g_statistics.completed++;
+                    g_statistics.wait_time_total_us += wait_time;
+                    g_statistics.wait_time_max_us = std::max(g_statistics.wait_time_max_us, wait_time);
+                    g_statistics.service_time_total_us += service_time;
+                    g_statistics.service_time_max_us = std::max(g_statistics.service_time_max_us, service_time);
+                }
+            }
+        }
+
+    }
+
+    Result Initialize(void) {
+        PaintThreadStack("io", g_io_thread_stack, sizeof(g_io_thread_stack));
+        R_TRY(os::CreateThread(&g_io_thread,
+            IoThreadFunc,
+            nullptr,
+            g_io_thread_stack,
+            sizeof(g_io_thread_stack),
+            IoThreadPriority
+        ));
+
+        os::StartThread(&g_io_thread);
+
+        return ams::ResultSuccess();
+    }
+
+    bool Submit(IoFunction function, IoCallback callback, const void *data, size_t size) {
+        AMS_ABORT_UNLESS(size <= IoRequestDataSize);
+
+        {
+            std::scoped_lock lk(g_queue_lock);
+
+            if (g_queue_count == IoQueueSize) {
+                trace::Record(trace::TraceEvent_IoQueueOverflow, IoQueueSize);
+                g_statistics.rejected++;
+                return false;
+            }
+
+            auto request = &g_requests[(g_queue_head + g_queue_count) % IoQueueSize];
+            request->function = function;
+            request->callback = callback;
+            request->submit_tick = os::GetSystemTick();
+            std::memcpy(request->data, data, size);
+
+            ++g_queue_count;
+
+            g_statistics.queue_depth = g_queue_count;
+            g_statistics.queue_depth_max = std::max<uint32_t>(g_statistics.queue_depth_max, g_queue_count);
+            g_statistics.submitted++;
+        }
+
+        g_request_event.Signal();
+
+        return true;
+    }
+
+    Result Execute(IoFunction function, void *data) {
+        // Waiting on ourselves would never return
+        if (os::GetCurrentThread() == &g_io_thread)
+            return function(data);
+
+        os::Event event(os::EventClearMode_AutoClear);
+        ExecuteContext context = { function, data, ams::ResultSuccess(), &event };
+        auto context_ptr = &context;
+
+        // Blocking callers are expected to wait their turn, even if the queue is currently full
+        while (!Submit(ExecuteFunction, ExecuteCallback, &context_ptr, sizeof(context_ptr))) {
+            os::SleepThread(TimeSpan::FromMilliSeconds(1));
+        }
+
+        event.Wait();
+
+        return context.result;
+    }
+
+    void GetStatistics(IoStatistics *stats) {
+        std::scoped_lock lk(g_queue_lock);
+        *stats = g_statistics;
+    }
+
+}
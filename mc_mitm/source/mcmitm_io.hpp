@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stratosphere.hpp>
+
+namespace ams::mitm::io {
+
+    // Maximum size of the data copied into a queued request
+    constexpr size_t IoRequestDataSize = 0x60;
+
+    // Both run on the I/O thread. The data pointer refers to the request's own copy of the submitted data.
+    typedef Result (*IoFunction)(void *data);
+    typedef void (*IoCallback)(Result result, void *data);
+
+    struct IoStatistics {
+        uint32_t queue_depth;
+        uint32_t queue_depth_max;
+        uint64_t submitted;
+        uint64_t completed;
+        uint64_t rejected;
+        uint64_t wait_time_total_us;
+        uint64_t wait_time_max_us;
+        uint64_t service_time_total_us;
+        uint64_t service_time_max_us;
+    };
+
+    Result Initialize(void);
+
+    // Queue a request without waiting on it. Returns false if the queue is full.
+    bool Submit(IoFunction function, IoCallback callback, const void *data, size_t size);
+
+    // Run a function on the I/O thread and wait for its result. Only for threads that can afford to block on the SD card.
+    Result Execute(IoFunction function, void *data);
+
+    void GetStatistics(IoStatistics *stats);
+
+}
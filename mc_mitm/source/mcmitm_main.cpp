@@ -17,51 +17,20 @@
 #include <stratosphere.hpp>
 #include "mcmitm_initialization.hpp"
 #include "mcmitm_config.hpp"
+#include "mcmitm_io.hpp"
+#include "mcmitm_heap.hpp"
+#include "mcmitm_thread_stack.hpp"
+#include "mcmitm_trace.hpp"
 
 namespace ams {
 
-    namespace mitm {
-
-        namespace {
-
-            alignas(0x40) constinit u8 g_heap_memory[64_KB];
-            constinit lmem::HeapHandle g_heap_handle;
-            constinit bool g_heap_initialized;
-            constinit os::SdkMutex g_heap_init_mutex;
-
-            lmem::HeapHandle GetHeapHandle() {
-                if (AMS_UNLIKELY(!g_heap_initialized)) {
-                    std::scoped_lock lk(g_heap_init_mutex);
-
-                    if (AMS_LIKELY(!g_heap_initialized)) {
-                        g_heap_handle = lmem::CreateExpHeap(g_heap_memory, sizeof(g_heap_memory), lmem::CreateOption_ThreadSafe);
-                        g_heap_initialized = true;
-                    }
-                }
-
-                return g_heap_handle;
-            }
-
-            void *Allocate(size_t size) {
-                return lmem::AllocateFromExpHeap(GetHeapHandle(), size);
-            }
-
-            void Deallocate(void *p, size_t size) {
-                AMS_UNUSED(size);
-                return lmem::FreeToExpHeap(GetHeapHandle(), p);
-            }
-
-        }
-
-    }
-
     namespace init {
 
         void InitializeSystemModule() {
             R_ABORT_UNLESS(sm::Initialize());
 
             fs::InitializeForSystem();
-            fs::SetAllocator(mitm::Allocate, mitm::Deallocate);
+            fs::SetAllocator(mitm::AllocateForFs, mitm::DeallocateForFs);
             fs::SetEnabledAutoAbort(false);
 
             R_ABORT_UNLESS(pmdmntInitialize());
@@ -77,6 +46,15 @@ namespace ams {
     }
 
     void Main() {
+        // Paint the rest of our own stack so peak usage can be queried alongside the threads we create
+        mitm::PaintCurrentThreadStack("main");
+
+        // Dump the trace ring to the sd card if we abort
+        mitm::trace::Initialize();
+
+        // Start SD card I/O thread
+        R_ABORT_UNLESS(mitm::io::Initialize());
+
         // Parse global module settings ini from sd card
         mitm::ParseIniConfig();
 
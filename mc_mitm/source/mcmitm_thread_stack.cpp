@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mcmitm_thread_stack.hpp"
+#include <algorithm>
+#include <mutex>
+#include <cstring>
+
+namespace ams::mitm {
+
+    namespace {
+
+        constexpr uint32_t StackPaintPattern = 0x5354434b; // STCK
+
+        // Leave the frames of the thread painting its own stack alone
+        constexpr size_t CurrentStackPaintMargin = 0x100;
+
+        struct PaintedStack {
+            const char *name;
+            uint32_t *stack;
+            size_t size;
+        };
+
+        os::SdkMutex g_painted_stacks_lock;
+        PaintedStack g_painted_stacks[MaxPaintedThreadStacks];
+        size_t g_painted_stack_count;
+
+        void RegisterPaintedStack(const char *name, void *stack, size_t size) {
+            std::scoped_lock lk(g_painted_stacks_lock);
+
+            if (g_painted_stack_count < MaxPaintedThreadStacks) {
+                g_painted_stacks[g_painted_stack_count++] = { name, reinterpret_cast<uint32_t *>(stack), size };
+            }
+        }
+
+        void FillPattern(void *start, size_t size) {
+            auto words = reinterpret_cast<uint32_t *>(start);
+            std::fill(words, words + size / sizeof(uint32_t), StackPaintPattern);
+        }
+
+        // Stacks grow down, so untouched pattern words are counted up from the bottom
+        size_t ScanStackUsage(const PaintedStack *stack) {
+            size_t word_count = stack->size / sizeof(uint32_t);
+
+            size_t untouched = 0;
+            while ((untouched < word_count) && (stack->stack[untouched] == StackPaintPattern))
+                ++untouched;
+
+            return stack->size - untouched * sizeof(uint32_t);
+        }
+
+    }
+
+    void PaintThreadStack(const char *name, void *stack, size_t size) {
+        FillPattern(stack, size);
+        RegisterPaintedStack(name, stack, size);
+    }
+
+    void PaintCurrentThreadStack(const char *name) {
+        auto thread = os::GetCurrentThread();
+        auto stack = reinterpret_cast<uintptr_t>(thread->stack);
+        auto frame = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+
+        if ((frame > stack + CurrentStackPaintMargin) && (frame <= stack + thread->stack_size)) {
+            FillPattern(thread->stack, util::AlignDown(frame - CurrentStackPaintMargin - stack, sizeof(uint32_t)));
+        }
+
+        RegisterPaintedStack(name, thread->stack, thread->stack_size);
+    }
+
+    size_t GetThreadStackUsage(ThreadStackUsage *usage, size_t count) {
+        std::scoped_lock lk(g_painted_stacks_lock);
+
+        size_t written = std::min(count, g_painted_stack_count);
+        for (size_t i = 0; i < written; ++i) {
+            std::strncpy(usage[i].name, g_painted_stacks[i].name, sizeof(usage[i].name) - 1);
+            usage[i].name[sizeof(usage[i].name) - 1] = '\0';
+            usage[i].size = g_painted_stacks[i].size;
+            usage[i].used_max = ScanStackUsage(&g_painted_stacks[i]);
+        }
+
+        return written;
+    }
+
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stratosphere.hpp>
+
+namespace ams::mitm {
+
+    constexpr size_t MaxPaintedThreadStacks = 12;
+
+    struct ThreadStackUsage {
+        char name[0x10];
+        uint32_t size;
+        uint32_t used_max;
+    };
+
+    // Fill a stack with a known pattern and register it for scanning. Must be called before the thread using it is started.
+    void PaintThreadStack(const char *name, void *stack, size_t size);
+
+    // Paint the unused part of the calling thread's stack, for threads whose stacks we don't create ourselves
+    void PaintCurrentThreadStack(const char *name);
+
+    // Peak usage is found by scanning each stack for the deepest overwritten part of the pattern. Returns the number of entries written.
+    size_t GetThreadStackUsage(ThreadStackUsage *usage, size_t count);
+
+}
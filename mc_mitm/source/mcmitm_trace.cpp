@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mcmitm_trace.hpp"
+#include <atomic>
+#include <cstring>
+
+namespace ams::mitm::trace {
+
+    namespace {
+
+        constexpr const char *trace_file_location = "sdmc:/config/MissionControl/trace.bin";
+
+        constexpr size_t TraceRecordCount = 256;
+        static_assert(util::IsPowerOfTwo(TraceRecordCount));
+
+        // Records copied per write when dumping
+        constexpr size_t DumpChunkRecordCount = 16;
+
+        // A record's sequence is zeroed while it is being written and set to its write index + 1 once complete.
+        // Dumping never blocks writers; records that change while being copied are skipped.
+        TraceRecord g_records[TraceRecordCount];
+        std::atomic<uint32_t> g_write_index;
+
+        os::SdkMutex g_dump_lock;
+
+        diag::AbortObserverHolder g_abort_observer;
+
+        inline std::atomic_ref<uint32_t> RecordSequence(TraceRecord *record) {
+            return std::atomic_ref<uint32_t>(record->sequence);
+        }
+
+        bool ReadRecord(uint32_t index, TraceRecord *out) {
+            auto record = &g_records[index % TraceRecordCount];
+
+            uint32_t sequence = RecordSequence(record).load(std::memory_order_acquire);
+            if (sequence != index + 1)
+                return false;
+
+            std::memcpy(out, record, sizeof(TraceRecord));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            return RecordSequence(record).load(std::memory_order_relaxed) == sequence;
+        }
+
+        // Caller must hold g_dump_lock
+        Result WriteDump(void) {
+            uint32_t end = g_write_index.load(std::memory_order_acquire);
+            uint32_t start = end > TraceRecordCount ? end - TraceRecordCount : 0;
+
+            // Records skipped while dumping leave unused space at the end of the file. The header holds the real count.
+            fs::DeleteFile(trace_file_location);
+            R_TRY(fs::CreateFile(trace_file_location, sizeof(TraceFileHeader) + (end - start) * sizeof(TraceRecord)));
+
+            fs::FileHandle file;
+            R_TRY(fs::OpenFile(std::addressof(file), trace_file_location, fs::OpenMode_Write));
+            ON_SCOPE_EXIT { fs::CloseFile(file); };
+
+            TraceFileHeader header = {
+                .magic          = TraceFileMagic,
+                .version        = TraceFileVersion,
+                .record_size    = sizeof(TraceRecord),
+                .record_count   = 0,
+                .reserved       = 0,
+                .tick_frequency = static_cast<uint64_t>(os::GetSystemTickFrequency()),
+                .dump_tick      = static_cast<uint64_t>(os::GetSystemTick().GetInt64Value())
+            };
+            R_TRY(fs::WriteFile(file, 0, &header, sizeof(header), fs::WriteOption::None));
+
+            TraceRecord chunk[DumpChunkRecordCount];
+            size_t chunk_count = 0;
+            s64 offset = sizeof(header);
+            for (uint32_t index = start; index != end; ++index) {
+                if (ReadRecord(index, &chunk[chunk_count]))
+                    ++chunk_count;
+
+                if ((chunk_count == DumpChunkRecordCount) || (index + 1 == end)) {
+                    R_TRY(fs::WriteFile(file, offset, chunk, chunk_count * sizeof(TraceRecord), fs::WriteOption::None));
+                    offset += chunk_count * sizeof(TraceRecord);
+                    header.record_count += chunk_count;
+                    chunk_count = 0;
+                }
+            }
+
+            R_TRY(fs::WriteFile(file, 0, &header, sizeof(header), fs::WriteOption::Flush));
+
+            return ams::ResultSuccess();
+        }
+
+        void AbortObserver(const diag::AbortInfo &info) {
+            Record(TraceEvent_Abort, info.result.GetValue());
+
+            // The abort may have come from a thread already dumping, possibly from within the filesystem, so waiting on the lock
+            // could hang forever. The dump in progress is left to finish on its own instead.
+            if (!g_dump_lock.TryLock())
+                return;
+            ON_SCOPE_EXIT { g_dump_lock.Unlock(); };
+
+            WriteDump();
+        }
+
+    }
+
+    void Initialize(void) {
+        diag::InitializeAbortObserverHolder(&g_abort_observer, AbortObserver);
+        diag::RegisterAbortObserver(&g_abort_observer);
+    }
+
+    void Record(TraceEvent event, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+        uint32_t index = g_write_index.fetch_add(1, std::memory_order_relaxed);
+        auto record = &g_records[index % TraceRecordCount];
+
+        RecordSequence(record).store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        record->event     = event;
+        record->tick      = os::GetSystemTick().GetInt64Value();
+        record->thread_id = os::GetThreadId(os::GetCurrentThread());
+        record->args[0]   = arg0;
+        record->args[1]   = arg1;
+        record->args[2]   = arg2;
+
+        RecordSequence(record).store(index + 1, std::memory_order_release);
+    }
+
+    void RecordAddress(TraceEvent event, const uint8_t address[6], uint32_t arg) {
+        Record(event,
+            (address[0] << 16) | (address[1] << 8) | address[2],
+            (address[3] << 16) | (address[4] << 8) | address[5],
+            arg
+        );
+    }
+
+    Result Dump(void) {
+        std::scoped_lock lk(g_dump_lock);
+        return WriteDump();
+    }
+
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stratosphere.hpp>
+
+namespace ams::mitm::trace {
+
+    enum TraceEvent : uint16_t {
+        TraceEvent_None                  = 0,
+        TraceEvent_HidConnectionOpened   = 1,  // address
+        TraceEvent_HidConnectionClosed   = 2,  // address
+        TraceEvent_SubCmd                = 3,  // address, subcommand id
+        TraceEvent_EventQueueOverflow    = 4,  // event type, queue capacity
+        TraceEvent_IoQueueOverflow       = 5,  // queue capacity
+        TraceEvent_ReportReadTimeout     = 6,  // timeout (ms)
+        TraceEvent_WiiCommandTimeout     = 7,  // address, output report id
+        TraceEvent_Abort                 = 8,  // result
+    };
+
+    // Records are written to a static ring with a handful of stores, so tracing is safe on the report path and from any thread
+    struct TraceRecord {
+        uint32_t sequence;
+        uint16_t event;
+        uint16_t reserved;
+        uint64_t tick;
+        uint32_t thread_id;
+        uint32_t args[3];
+    };
+    static_assert(sizeof(TraceRecord) == 0x20);
+
+    // Layout of the dump file. Records follow the header, oldest first.
+    struct TraceFileHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t record_size;
+        uint32_t record_count;
+        uint32_t reserved;
+        uint64_t tick_frequency;
+        uint64_t dump_tick;
+    } __attribute__ ((__packed__));
+    static_assert(sizeof(TraceFileHeader) == 0x20);
+
+    constexpr uint32_t TraceFileMagic = 0x5254434d; // MCTR
+    constexpr uint16_t TraceFileVersion = 1;
+
+    void Initialize(void);
+
+    void Record(TraceEvent event, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0);
+
+    // Bluetooth addresses are split over the first two arguments, three bytes each
+    void RecordAddress(TraceEvent event, const uint8_t address[6], uint32_t arg = 0);
+
+    // Write the ring out to the sd card. Blocks on the filesystem, so must not be called from the report path.
+    Result Dump(void);
+
+}
@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "controllers/controller_management.hpp"
+#include "controllers/controller_profile.hpp"
+#include "host_fs.hpp"
+#include "host_mitm.hpp"
+#include "test.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Replays the raw reports under fixtures/ through each driver and checks the buttons and sticks of the Switch report that comes out
+// against the values recorded alongside them, bit for bit. Also times how long each driver takes per report.
+//
+// A fixture file holds any number of controllers, each started by a line naming the driver and the hardware id it connects as
+//
+//   controller dualshock4 054c:09cc
+//   descriptor 05 01 09 05 ...         report descriptor handed to the next controller through the pairing database
+//   report 11 c0 00 80 80 00*70        raw input report, as hex bytes. xx*n repeats a byte n times.
+//   expect buttons=A,ZL left=800,800 right=fff,000
+//
+// An expect line checks the Switch report produced by the report before it. Running with --update rewrites every expect line with
+// the current output, for recording a new fixture or a deliberate change of mapping. Review the diff before committing it.
+namespace {
+
+    using namespace ams;
+    using namespace ams::controller;
+
+    constexpr bluetooth::Address fixture_address = {{ 0x98, 0xb6, 0xe9, 0xf0, 0x22, 0x02 }};
+
+    struct Driver {
+        const char *name;
+        ControllerType type;
+        std::unique_ptr<SwitchController> (*create)(const bluetooth::Address *address, HardwareID id);
+    };
+
+    template<typename T>
+    std::unique_ptr<SwitchController> CreateController(const bluetooth::Address *address, HardwareID id) {
+        return std::make_unique<T>(address, id);
+    }
+
+    constexpr Driver drivers[] = {
+        { "switch",         ControllerType_Switch,          CreateController<SwitchController>       },
+        { "wii",            ControllerType_Wii,             CreateController<WiiController>          },
+        { "dualshock4",     ControllerType_Dualshock4,      CreateController<Dualshock4Controller>   },
+        { "dualsense",      ControllerType_Dualsense,       CreateController<DualsenseController>    },
+        { "xboxone",        ControllerType_XboxOne,         CreateController<XboxOneController>      },
+        { "ouya",           ControllerType_Ouya,            CreateController<OuyaController>         },
+        { "gamestick",      ControllerType_Gamestick,       CreateController<GamestickController>    },
+        { "gembox",         ControllerType_Gembox,          CreateController<GemboxController>       },
+        { "ipega",          ControllerType_Ipega,           CreateController<IpegaController>        },
+        { "xiaomi",         ControllerType_Xiaomi,          CreateController<XiaomiController>       },
+        { "gamesir",        ControllerType_Gamesir,         CreateController<GamesirController>      },
+        { "steelseries",    ControllerType_Steelseries,     CreateController<SteelseriesController>  },
+        { "nvidia_shield",  ControllerType_NvidiaShield,    CreateController<NvidiaShieldController> },
+        { "8bitdo",         ControllerType_8BitDo,          CreateController<EightBitDoController>   },
+        { "powera",         ControllerType_PowerA,          CreateController<PowerAController>       },
+        { "madcatz",        ControllerType_MadCatz,         CreateController<MadCatzController>      },
+        { "mocute",         ControllerType_Mocute,          CreateController<MocuteController>       },
+        { "razer",          ControllerType_Razer,           CreateController<RazerController>        },
+        { "icade",          ControllerType_ICade,           CreateController<ICadeController>        },
+        { "lanshen",        ControllerType_LanShen,         CreateController<LanShenController>      },
+        { "atgames",        ControllerType_AtGames,         CreateController<AtGamesController>      },
+        { "hyperkin",       ControllerType_Hyperkin,        CreateController<HyperkinController>     },
+        { "unknown",        ControllerType_Unknown,         CreateController<UnknownController>      },
+    };
+
+    const Driver *FindDriver(const std::string &name) {
+        for (auto &driver : drivers) {
+            if (name == driver.name)
+                return &driver;
+        }
+        return nullptr;
+    }
+
+    struct ButtonName {
+        const char *name;
+        uint32_t mask;
+    };
+
+    constexpr ButtonName button_names[] = {
+        { "Y",          SwitchButtonMask_Y           },
+        { "X",          SwitchButtonMask_X           },
+        { "B",          SwitchButtonMask_B           },
+        { "A",          SwitchButtonMask_A           },
+        { "R",          SwitchButtonMask_R           },
+        { "ZR",         SwitchButtonMask_ZR          },
+        { "minus",      SwitchButtonMask_Minus       },
+        { "plus",       SwitchButtonMask_Plus        },
+        { "rstick",     SwitchButtonMask_RStickPress },
+        { "lstick",     SwitchButtonMask_LStickPress },
+        { "home",       SwitchButtonMask_Home        },
+        { "capture",    SwitchButtonMask_Capture     },
+        { "down",       SwitchButtonMask_DpadDown    },
+        { "up",         SwitchButtonMask_DpadUp      },
+        { "right",      SwitchButtonMask_DpadRight   },
+        { "left",       SwitchButtonMask_DpadLeft    },
+        { "L",          SwitchButtonMask_L           },
+        { "ZL",         SwitchButtonMask_ZL          },
+    };
+
+    // The parts of a Switch input report that a driver maps
+    struct MappedState {
+        uint32_t buttons;
+        uint16_t left_stick[2];
+        uint16_t right_stick[2];
+
+        bool operator==(const MappedState &) const = default;
+    };
+
+    std::string FormatState(const MappedState &state) {
+        std::string buttons;
+        for (auto &button : button_names) {
+            if (state.buttons & button.mask)
+                buttons += (buttons.empty() ? "" : ",") + std::string(button.name);
+        }
+
+        // Bits with no name, such as the joycon SL and SR, are written as a mask so that nothing goes unchecked
+        uint32_t unnamed = state.buttons;
+        for (auto &button : button_names)
+            unnamed &= ~button.mask;
+        if (unnamed) {
+            char mask[0x10];
+            std::snprintf(mask, sizeof(mask), "0x%06x", unnamed);
+            buttons += (buttons.empty() ? "" : ",") + std::string(mask);
+        }
+
+        char sticks[0x40];
+        std::snprintf(sticks, sizeof(sticks), " left=%03x,%03x right=%03x,%03x", state.left_stick[0], state.left_stick[1], state.right_stick[0], state.right_stick[1]);
+        return "buttons=" + (buttons.empty() ? std::string("none") : buttons) + sticks;
+    }
+
+    bool ParseButtons(const std::string &text, uint32_t *buttons) {
+        *buttons = 0;
+        if (text == "none")
+            return true;
+
+        std::stringstream names(text);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            auto button = std::find_if(std::begin(button_names), std::end(button_names), [&](auto &b) { return name == b.name; });
+            if (button != std::end(button_names))
+                *buttons |= button->mask;
+            else if (name.starts_with("0x"))
+                *buttons |= std::stoul(name, nullptr, 16);
+            else
+                return false;
+        }
+        return true;
+    }
+
+    bool ParseStick(const std::string &text, uint16_t *stick) {
+        unsigned int x, y;
+        if (std::sscanf(text.c_str(), "%x,%x", &x, &y) != 2)
+            return false;
+
+        stick[0] = x;
+        stick[1] = y;
+        return true;
+    }
+
+    bool ParseState(std::istream &fields, MappedState *state) {
+        bool have_buttons = false, have_left = false, have_right = false;
+
+        std::string field;
+        while (fields >> field) {
+            auto separator = field.find('=');
+            if (separator == std::string::npos)
+                return false;
+
+            auto key = field.substr(0, separator);
+            auto value = field.substr(separator + 1);
+            if (key == "buttons")
+                have_buttons = ParseButtons(value, &state->buttons);
+            else if (key == "left")
+                have_left = ParseStick(value, state->left_stick);
+            else if (key == "right")
+                have_right = ParseStick(value, state->right_stick);
+            else
+                return false;
+        }
+
+        return have_buttons && have_left && have_right;
+    }
+
+    bool ParseBytes(std::istream &fields, std::vector<uint8_t> *bytes) {
+        std::string field;
+        while (fields >> field) {
+            char *end;
+            unsigned long value = std::strtoul(field.c_str(), &end, 16);
+            unsigned long count = 1;
+            if (*end == '*')
+                count = std::strtoul(end + 1, &end, 10);
+
+            if ((end == field.c_str()) || (*end != '\0') || (value > UINT8_MAX))
+                return false;
+
+            bytes->insert(bytes->end(), count, value);
+        }
+        return !bytes->empty();
+    }
+
+    bool GetMappedState(MappedState *state) {
+        auto report = &test::GetHidReports()->last_input;
+        if ((report->size < sizeof(SwitchInputReport0x30) + 1) || (report->data[0] != 0x30))
+            return false;
+
+        SwitchInputReport0x30 input;
+        std::memcpy(&input, &report->data[1], sizeof(input));
+
+        auto buttons = reinterpret_cast<const uint8_t *>(&input.buttons);
+        state->buttons = buttons[0] | (buttons[1] << 8) | (buttons[2] << 16);
+        state->left_stick[0]  = input.left_stick.GetX();
+        state->left_stick[1]  = input.left_stick.GetY();
+        state->right_stick[0] = input.right_stick.GetX();
+        state->right_stick[1] = input.right_stick.GetY();
+        return true;
+    }
+
+    // Everything in one fixture file needed to replay a controller's reports again for timing
+    struct FixtureController {
+        const Driver *driver;
+        HardwareID id;
+        std::vector<uint8_t> descriptor;
+        std::vector<bluetooth::HidReport> reports;
+    };
+
+    // Each controller starts from nothing stored, as on its first connection
+    std::unique_ptr<SwitchController> StartController(const FixtureController &fixture) {
+        test::ClearFileSystem();
+        test::ClearPairedDevices();
+        if (!fixture.descriptor.empty()) {
+            SetSysBluetoothDevicesSettings device = { .addr = fixture_address, .vid = fixture.id.vid, .pid = fixture.id.pid };
+            std::memcpy(device.descriptor, fixture.descriptor.data(), std::min(fixture.descriptor.size(), sizeof(device.descriptor)));
+            device.descriptor_length = std::min(fixture.descriptor.size(), sizeof(device.descriptor));
+            test::SetPairedDevice(&device);
+        }
+
+        ControllerProfile profile;
+        InitializeControllerProfile(&profile, fixture.driver->type, fixture.id.vid, fixture.id.pid);
+
+        auto controller = fixture.driver->create(&fixture_address, fixture.id);
+        controller->SetProfile(&profile);
+        if (!TEST_CHECK(R_SUCCEEDED(controller->Initialize())))
+            return nullptr;
+        controller->SetReady();
+
+        test::ClearHidReports();
+        return controller;
+    }
+
+    // Returns the number of expect lines checked, or rewritten when updating
+    unsigned int RunFixture(const std::filesystem::path &path, bool update, std::vector<FixtureController> *controllers) {
+        std::ifstream file(path);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(file, line); )
+            lines.push_back(line);
+
+        std::unique_ptr<SwitchController> controller;
+        std::vector<uint8_t> descriptor;
+        bool have_output = false;
+        unsigned int expect_count = 0;
+
+        for (size_t i = 0; i < lines.size(); ++i) {
+            std::stringstream fields(lines[i]);
+            std::string directive;
+            if (!(fields >> directive) || directive.starts_with("#"))
+                continue;
+
+            if (directive == "controller") {
+                std::string name;
+                unsigned int vid, pid;
+                char separator;
+                fields >> name >> std::hex >> vid >> separator >> pid;
+
+                auto driver = FindDriver(name);
+                if (!test::Check(driver && fields && (separator == ':'), "controller line names a driver and hardware id", path.c_str(), i + 1))
+                    return expect_count;
+
+                controllers->push_back({ driver, { static_cast<uint16_t>(vid), static_cast<uint16_t>(pid) }, descriptor, {} });
+                controller = StartController(controllers->back());
+                descriptor.clear();
+                have_output = false;
+                if (!controller)
+                    return expect_count;
+            } else if (directive == "descriptor") {
+                if (!ParseBytes(fields, &descriptor))
+                    test::Check(false, "descriptor bytes", path.c_str(), i + 1);
+            } else if (directive == "report") {
+                bluetooth::HidReport report = {};
+                std::vector<uint8_t> bytes;
+                if (!controller || !ParseBytes(fields, &bytes) || (bytes.size() > sizeof(report.data))) {
+                    test::Check(false, "report bytes after a controller line", path.c_str(), i + 1);
+                    continue;
+                }
+
+                report.size = bytes.size();
+                std::memcpy(report.data, bytes.data(), bytes.size());
+                controllers->back().reports.push_back(report);
+
+                auto input_count = test::GetHidReports()->input_count;
+                controller->HandleIncomingReport(&report);
+                have_output = test::GetHidReports()->input_count != input_count;
+            } else if (directive == "expect") {
+                MappedState actual;
+                if (!test::Check(have_output && GetMappedState(&actual), "report before expect produced a 0x30 report", path.c_str(), i + 1))
+                    continue;
+
+                expect_count++;
+                if (update) {
+                    lines[i] = "expect " + FormatState(actual);
+                    continue;
+                }
+
+                MappedState expected = {};
+                if (!test::Check(ParseState(fields, &expected), "expect line parses", path.c_str(), i + 1))
+                    continue;
+
+                if (!test::Check(actual == expected, "mapped state matches", path.c_str(), i + 1)) {
+                    std::fprintf(stderr, "  expected %s\n", FormatState(expected).c_str());
+                    std::fprintf(stderr, "  actual   %s\n", FormatState(actual).c_str());
+                }
+            } else {
+                test::Check(false, "known directive", path.c_str(), i + 1);
+            }
+        }
+
+        if (update) {
+            std::ofstream out(path, std::ios::trunc);
+            for (auto &line : lines)
+                out << line << '\n';
+        }
+
+        return expect_count;
+    }
+
+    void TestConformance(const std::filesystem::path &dir, bool update, std::vector<FixtureController> *controllers) {
+        std::vector<std::filesystem::path> paths;
+        for (auto &entry : std::filesystem::directory_iterator(dir)) {
+            if (entry.path().extension() == ".txt")
+                paths.push_back(entry.path());
+        }
+        std::sort(paths.begin(), paths.end());
+        TEST_CHECK(!paths.empty());
+
+        for (auto &path : paths) {
+            size_t first = controllers->size();
+            unsigned int expect_count = RunFixture(path, update, controllers);
+            std::printf("  %-20s %zu controller(s), %u expected reports%s\n", path.filename().c_str(), controllers->size() - first, expect_count, update ? " updated" : "");
+            TEST_CHECK(expect_count > 0);
+        }
+    }
+
+    void MeasureCostPerReport(const std::vector<FixtureController> &controllers) {
+        constexpr unsigned int ReportCount = 100'000;
+
+        for (auto &fixture : controllers) {
+            if (fixture.reports.empty())
+                continue;
+
+            auto controller = StartController(fixture);
+            if (!controller)
+                continue;
+
+            // The whole sequence is replayed in order, so drivers that track state across reports see what they would from a device
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < ReportCount; ++i)
+                controller->HandleIncomingReport(&fixture.reports[i % fixture.reports.size()]);
+            double ns = test::NanoSecondsSince(start) / ReportCount;
+
+            std::printf("  cost: %-14s %04x:%04x %7.1fns per report\n", fixture.driver->name, fixture.id.vid, fixture.id.pid, ns);
+
+            // Includes building the Switch report and handing it on, so is generous enough for any host while still catching a driver gone badly wrong
+            if constexpr (ams::test::EnforceTimingBudgets)
+                TEST_CHECK(ns < 2000.0);
+        }
+    }
+
+}
+
+int main(int argc, char **argv) {
+    bool update = false;
+    std::filesystem::path dir = "fixtures";
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--update") == 0)
+            update = true;
+        else
+            dir = argv[i];
+    }
+
+    std::vector<FixtureController> controllers;
+    TestConformance(dir, update, &controllers);
+    if (!update)
+        MeasureCostPerReport(controllers);
+
+    return ams::test::Finish("controller_golden_test");
+}
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "controllers/controller_management.hpp"
+#include "controllers/controller_profile.hpp"
+#include "controllers/hid_report_descriptor.hpp"
+#include "host_mitm.hpp"
+#include "host_os.hpp"
+#include <sanitizer/asan_interface.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+// Fuzz targets for everything that parses data from the radio: the input report handling of every driver, each subcommand
+// handled by EmulatedSwitchController, rumble, and the HID descriptor compiler behind UnknownController.
+// A binary runs one target, chosen with -target=<name>. -list_targets=1 prints them all.
+//
+// Driver inputs are a sequence of reports, each a flags byte (bit 0 set for a report to the device), a size byte and the report data.
+// The bytes of a report buffer past its size are poisoned, so reading beyond what the device actually sent is caught as well.
+namespace {
+
+    using namespace ams;
+    using namespace ams::controller;
+
+    constexpr bluetooth::Address fuzz_address = {{ 0x98, 0xb6, 0xe9, 0xf0, 0x22, 0x01 }};
+
+    class FuzzInput {
+
+        public:
+            FuzzInput(const uint8_t *data, size_t size) : m_data(data), m_size(size) { }
+
+            bool Empty(void) const { return m_size == 0; }
+
+            uint8_t ReadByte(void) {
+                if (m_size == 0)
+                    return 0;
+
+                m_size--;
+                return *m_data++;
+            }
+
+            // Up to size bytes, fewer if the input runs out first
+            const uint8_t *Take(size_t size, size_t *taken) {
+                auto data = m_data;
+                *taken = std::min(size, m_size);
+                m_data += *taken;
+                m_size -= *taken;
+                return data;
+            }
+
+        private:
+            const uint8_t *m_data;
+            size_t m_size;
+
+    };
+
+    // Placed so that the end of the report data is 8 byte aligned, which lets ASan poison exactly the bytes past the report's size
+    class FuzzReport {
+
+        public:
+            FuzzReport(void) : m_report(reinterpret_cast<bluetooth::HidReport *>(m_storage + ReportOffset)) { }
+
+            ~FuzzReport() {
+                ASAN_UNPOISON_MEMORY_REGION(m_report->data, sizeof(m_report->data));
+            }
+
+            const bluetooth::HidReport *Set(const uint8_t *data, size_t size) {
+                size = std::min(size, sizeof(m_report->data));
+
+                ASAN_UNPOISON_MEMORY_REGION(m_report->data, sizeof(m_report->data));
+                m_report->size = size;
+                std::memcpy(m_report->data, data, size);
+                ASAN_POISON_MEMORY_REGION(m_report->data + size, sizeof(m_report->data) - size);
+
+                return m_report;
+            }
+
+        private:
+            static constexpr size_t ReportOffset = 8 - offsetof(bluetooth::HidReport, data);
+            static_assert(sizeof(bluetooth::HidReport::data) % 8 == 0);
+
+            alignas(8) uint8_t m_storage[ReportOffset + sizeof(bluetooth::HidReport)];
+            bluetooth::HidReport *m_report;
+
+    };
+
+    void StartController(SwitchController *controller, ControllerType type, HardwareID id) {
+        ControllerProfile profile;
+        InitializeControllerProfile(&profile, type, id.vid, id.pid);
+        controller->SetProfile(&profile);
+
+        controller->Initialize();
+        controller->SetReady();
+    }
+
+    void ReplayReports(SwitchController *controller, FuzzInput *input) {
+        FuzzReport report;
+
+        while (!input->Empty()) {
+            uint8_t flags = input->ReadByte();
+            size_t size;
+            auto data = input->Take(input->ReadByte(), &size);
+
+            if (flags & 1)
+                controller->HandleOutgoingReport(report.Set(data, size));
+            else
+                controller->HandleIncomingReport(report.Set(data, size));
+        }
+    }
+
+    template<typename T, ControllerType Type>
+    void FuzzDriver(FuzzInput *input) {
+        auto id = T::hardware_ids[0];
+        auto controller = std::make_unique<T>(&fuzz_address, id);
+        StartController(controller.get(), Type, id);
+        ReplayReports(controller.get(), input);
+    }
+
+    // The report descriptor comes first, as a size byte and the descriptor, and is handed to the driver through the pairing database
+    void FuzzUnknownDriver(FuzzInput *input) {
+        SetSysBluetoothDevicesSettings device = { .addr = fuzz_address, .vid = 0x1234, .pid = 0x5678 };
+
+        size_t size;
+        auto descriptor = input->Take(std::min<size_t>(input->ReadByte(), sizeof(device.descriptor)), &size);
+        std::memcpy(device.descriptor, descriptor, size);
+        device.descriptor_length = size;
+        test::SetPairedDevice(&device);
+
+        HardwareID id = { device.vid, device.pid };
+        auto controller = std::make_unique<UnknownController>(&fuzz_address, id);
+        StartController(controller.get(), ControllerType_Unknown, id);
+        ReplayReports(controller.get(), input);
+    }
+
+    // A report count, then the contents of the state ring as written by the client, past its magic, version and entry count
+    void FuzzVirtualDriver(FuzzInput *input) {
+        auto controller = std::make_unique<VirtualController>(&fuzz_address);
+        if (R_FAILED(controller->InitializeStateRing()))
+            return;
+        StartController(controller.get(), ControllerType_Virtual, VirtualController::hardware_id);
+
+        unsigned int report_count = input->ReadByte() % 16;
+
+        auto ring = reinterpret_cast<uint8_t *>(test::GetMappedSharedMemory(controller->GetSharedMemoryHandle()));
+        constexpr size_t header_size = offsetof(VirtualControllerStateRingHeader, write_sequence);
+        size_t size;
+        auto data = input->Take(sizeof(VirtualControllerStateRing) - header_size, &size);
+        std::memcpy(ring + header_size, data, size);
+
+        for (unsigned int i = 0; i < report_count; ++i)
+            controller->HandleIncomingReport(nullptr);
+    }
+
+    // Subcommands all go to one controller, so that state left behind in its virtual spi flash by one input is seen by later ones
+    EmulatedSwitchController *GetSubCmdController(void) {
+        static auto controller = [] {
+            HardwareID id = { 0x057e, 0x2009 };
+            auto controller = new EmulatedSwitchController(&fuzz_address, id);
+            StartController(controller, ControllerType_Dualshock4, id);
+            return controller;
+        }();
+
+        return controller;
+    }
+
+    // The input is the subcommand's arguments. The report is only as long as the input.
+    template<uint8_t SubCmd>
+    void FuzzSubCmd(FuzzInput *input) {
+        constexpr size_t subcmd_id_offset = sizeof(uint8_t) + offsetof(SwitchOutputReport0x01, subcmd);
+
+        uint8_t data[sizeof(bluetooth::HidReport::data)] = { 0x01, 0x00, 0x00, 0x01, 0x40, 0x40, 0x00, 0x01, 0x40, 0x40, SubCmd };
+
+        size_t size;
+        auto args = input->Take(sizeof(data) - subcmd_id_offset - 1, &size);
+        std::memcpy(data + subcmd_id_offset + 1, args, size);
+
+        FuzzReport report;
+        GetSubCmdController()->HandleOutgoingReport(report.Set(data, subcmd_id_offset + 1 + size));
+    }
+
+    // Any sequence of reports to the controller, subcommands and rumble alike. Each is a size byte and the report.
+    void FuzzOutputReports(FuzzInput *input) {
+        FuzzReport report;
+
+        while (!input->Empty()) {
+            size_t size;
+            auto data = input->Take(input->ReadByte(), &size);
+            GetSubCmdController()->HandleOutgoingReport(report.Set(data, size));
+        }
+    }
+
+    void DecodeReports(const HidDescriptorPlan *plan, FuzzInput *input) {
+        SwitchButtonData buttons = {};
+        SwitchAnalogStick left_stick = {}, right_stick = {};
+        FuzzReport report;
+
+        while (!input->Empty()) {
+            size_t size;
+            auto data = input->Take(input->ReadByte(), &size);
+            auto hid_report = report.Set(data, size);
+            DecodeHidReport(plan, hid_report->data, hid_report->size, &buttons, &left_stick, &right_stick);
+        }
+    }
+
+    // A descriptor as a size byte and its contents, then reports to decode with whatever plan it compiles to
+    void FuzzHidDescriptor(FuzzInput *input) {
+        size_t size;
+        auto descriptor = input->Take(input->ReadByte(), &size);
+
+        auto plan = std::make_unique<HidDescriptorPlan>();
+        if (R_FAILED(CompileHidReportDescriptor(descriptor, size, plan.get())))
+            return;
+
+        DecodeReports(plan.get(), input);
+    }
+
+    // A plan as read back from hid_plan.bin, then reports to decode with it if it validates. Random bytes would
+    // almost never get past the header, so only the counts and the used reports and fields are taken from the input.
+    void FuzzHidPlan(FuzzInput *input) {
+        auto plan = std::make_unique<HidDescriptorPlan>();
+        plan->magic = HidPlanMagic;
+        plan->version = HidPlanVersion;
+        plan->report_count = input->ReadByte();
+        plan->uses_report_ids = input->ReadByte() & 1;
+
+        for (size_t i = 0; i < std::min<size_t>(plan->report_count, HidPlanMaxReports); ++i) {
+            auto report = &plan->reports[i];
+            report->id = input->ReadByte();
+            report->field_count = input->ReadByte();
+            report->size = input->ReadByte() | (input->ReadByte() << 8);
+
+            for (size_t j = 0; j < std::min<size_t>(report->field_count, HidPlanMaxFields); ++j) {
+                size_t size;
+                auto data = input->Take(sizeof(HidReportField), &size);
+                std::memcpy(&report->fields[j], data, size);
+            }
+        }
+
+        if (!ValidateHidDescriptorPlan(plan.get()))
+            return;
+
+        DecodeReports(plan.get(), input);
+    }
+
+    struct FuzzTarget {
+        const char *name;
+        void (*run)(FuzzInput *input);
+    };
+
+    constexpr FuzzTarget fuzz_targets[] = {
+        { "driver_switch",              FuzzDriver<SwitchController,       ControllerType_Switch>        },
+        { "driver_wii",                 FuzzDriver<WiiController,          ControllerType_Wii>           },
+        { "driver_dualshock4",          FuzzDriver<Dualshock4Controller,   ControllerType_Dualshock4>    },
+        { "driver_dualsense",           FuzzDriver<DualsenseController,    ControllerType_Dualsense>     },
+        { "driver_xboxone",             FuzzDriver<XboxOneController,      ControllerType_XboxOne>       },
+        { "driver_ouya",                FuzzDriver<OuyaController,         ControllerType_Ouya>          },
+        { "driver_gamestick",           FuzzDriver<GamestickController,    ControllerType_Gamestick>     },
+        { "driver_gembox",              FuzzDriver<GemboxController,       ControllerType_Gembox>        },
+        { "driver_ipega",               FuzzDriver<IpegaController,        ControllerType_Ipega>         },
+        { "driver_xiaomi",              FuzzDriver<XiaomiController,       ControllerType_Xiaomi>        },
+        { "driver_gamesir",             FuzzDriver<GamesirController,      ControllerType_Gamesir>       },
+        { "driver_steelseries",         FuzzDriver<SteelseriesController,  ControllerType_Steelseries>   },
+        { "driver_nvidia_shield",       FuzzDriver<NvidiaShieldController, ControllerType_NvidiaShield>  },
+        { "driver_8bitdo",              FuzzDriver<EightBitDoController,   ControllerType_8BitDo>        },
+        { "driver_powera",              FuzzDriver<PowerAController,       ControllerType_PowerA>        },
+        { "driver_madcatz",             FuzzDriver<MadCatzController,      ControllerType_MadCatz>       },
+        { "driver_mocute",              FuzzDriver<MocuteController,       ControllerType_Mocute>        },
+        { "driver_razer",               FuzzDriver<RazerController,        ControllerType_Razer>         },
+        { "driver_icade",               FuzzDriver<ICadeController,        ControllerType_ICade>         },
+        { "driver_lanshen",             FuzzDriver<LanShenController,      ControllerType_LanShen>       },
+        { "driver_atgames",             FuzzDriver<AtGamesController,      ControllerType_AtGames>       },
+        { "driver_hyperkin",            FuzzDriver<HyperkinController,     ControllerType_Hyperkin>      },
+        { "driver_unknown",             FuzzUnknownDriver },
+        { "driver_virtual",             FuzzVirtualDriver },
+
+        { "subcmd_request_device_info", FuzzSubCmd<SubCmd_RequestDeviceInfo>   },
+        { "subcmd_set_input_report_mode", FuzzSubCmd<SubCmd_SetInputReportMode> },
+        { "subcmd_triggers_elapsed_time", FuzzSubCmd<SubCmd_TriggersElapsedTime> },
+        { "subcmd_reset_pairing_info",  FuzzSubCmd<SubCmd_ResetPairingInfo>     },
+        { "subcmd_set_ship_power_state", FuzzSubCmd<SubCmd_SetShipPowerState>  },
+        { "subcmd_spi_flash_read",      FuzzSubCmd<SubCmd_SpiFlashRead>         },
+        { "subcmd_spi_flash_write",     FuzzSubCmd<SubCmd_SpiFlashWrite>        },
+        { "subcmd_spi_sector_erase",    FuzzSubCmd<SubCmd_SpiSectorErase>       },
+        { "subcmd_set_mcu_config",      FuzzSubCmd<SubCmd_SetMcuConfig>         },
+        { "subcmd_set_mcu_state",       FuzzSubCmd<SubCmd_SetMcuState>          },
+        { "subcmd_0x24",                FuzzSubCmd<SubCmd_0x24>                 },
+        { "subcmd_0x25",                FuzzSubCmd<SubCmd_0x25>                 },
+        { "subcmd_set_player_leds",     FuzzSubCmd<SubCmd_SetPlayerLeds>        },
+        { "subcmd_get_player_leds",     FuzzSubCmd<SubCmd_GetPlayerLeds>        },
+        { "subcmd_set_home_led",        FuzzSubCmd<SubCmd_SetHomeLed>           },
+        { "subcmd_enable_imu",          FuzzSubCmd<SubCmd_EnableImu>            },
+        { "subcmd_enable_vibration",    FuzzSubCmd<SubCmd_EnableVibration>      },
+        { "output_reports",             FuzzOutputReports },
+
+        { "hid_descriptor",             FuzzHidDescriptor },
+        { "hid_plan",                   FuzzHidPlan },
+    };
+
+    const FuzzTarget *g_target;
+
+    const FuzzTarget *FindTarget(const char *name) {
+        for (auto &target : fuzz_targets) {
+            if (std::strcmp(target.name, name) == 0)
+                return &target;
+        }
+        return nullptr;
+    }
+
+}
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    const char *name = std::getenv("FUZZ_TARGET");
+
+    for (int i = 1; i < *argc; ++i) {
+        const char *arg = (*argv)[i];
+        if (std::strncmp(arg, "-target=", 8) == 0) {
+            name = arg + 8;
+        } else if (std::strcmp(arg, "-list_targets=1") == 0) {
+            for (auto &target : fuzz_targets)
+                std::printf("%s\n", target.name);
+            std::exit(0);
+        }
+    }
+
+    g_target = name ? FindTarget(name) : nullptr;
+    if (g_target == nullptr) {
+        std::fprintf(stderr, "Choose a target with -target=<name> or FUZZ_TARGET. -list_targets=1 lists them.\n");
+        std::exit(1);
+    }
+
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    FuzzInput input(data, size);
+    g_target->run(&input);
+    return 0;
+}
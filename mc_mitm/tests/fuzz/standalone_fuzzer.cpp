@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <sanitizer/common_interface_defs.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Stands in for libFuzzer where only gcc is available. The code under test is built with -fsanitize-coverage=trace-pc,
+// and inputs that reach a new edge, or an edge a new number of times, are kept in the corpus to be mutated further.
+// Takes the libFuzzer options that matter here and prints progress in the same form, exec/s included.
+//
+//   controller_fuzzer -target=<name> [-runs=N] [-max_total_time=S] [-max_len=N] [-seed=N] [corpus dir or file ...]
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv);
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+namespace {
+
+    constexpr size_t CoverageMapSize = 1 << 16;
+
+    // Hit counts for each edge during the current input, and the hit count buckets already seen for each edge
+    uint8_t g_coverage[CoverageMapSize];
+    uint8_t g_seen[CoverageMapSize];
+    uintptr_t g_previous_location;
+
+    std::vector<uint8_t> g_current_input;
+    std::string g_artifact_prefix = "./";
+
+    using Clock = std::chrono::steady_clock;
+
+    // Counts of 1, 2, 3, 4-7, 8-15, 16-31, 32-127 and 128+ are told apart, as AFL does
+    uint8_t GetHitBucket(uint8_t count) {
+        if (count <= 3) return count ? 1 << (count - 1) : 0;
+        if (count <= 7) return 1 << 3;
+        if (count <= 15) return 1 << 4;
+        if (count <= 31) return 1 << 5;
+        if (count <= 127) return 1 << 6;
+        return 1 << 7;
+    }
+
+    bool RunInput(const std::vector<uint8_t> &input, size_t *features) {
+        std::memset(g_coverage, 0, sizeof(g_coverage));
+        g_previous_location = 0;
+        g_current_input = input;
+
+        // Copied so that reads past the end of the input are caught
+        std::unique_ptr<uint8_t[]> data(new uint8_t[input.size()]);
+        std::copy(input.begin(), input.end(), data.get());
+        LLVMFuzzerTestOneInput(data.get(), input.size());
+
+        // Most of the map is untouched by any one input, so it's scanned a word at a time
+        bool interesting = false;
+        for (size_t word = 0; word < CoverageMapSize; word += sizeof(uint64_t)) {
+            uint64_t hits;
+            std::memcpy(&hits, &g_coverage[word], sizeof(hits));
+            if (hits == 0)
+                continue;
+
+            for (size_t i = word; i < word + sizeof(uint64_t); ++i) {
+                uint8_t bucket = GetHitBucket(g_coverage[i]);
+                if (bucket & ~g_seen[i]) {
+                    if (g_seen[i] == 0)
+                        (*features)++;
+                    g_seen[i] |= bucket;
+                    interesting = true;
+                }
+            }
+        }
+        return interesting;
+    }
+
+    void WriteFile(const std::string &path, const std::vector<uint8_t> &data) {
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char *>(data.data()), data.size());
+    }
+
+    // Names inputs by their contents, so that repeated sessions in one corpus directory don't overwrite each other's entries
+    std::string GetInputName(const std::vector<uint8_t> &data) {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (auto byte : data)
+            hash = (hash ^ byte) * 0x100000001b3;
+
+        char name[0x20];
+        std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+        return name;
+    }
+
+    // Written by the sanitizers on their way out, so the failing input can be replayed by passing it as the corpus
+    void WriteCrashInput(void) {
+        auto path = "crash-" + GetInputName(g_current_input);
+        WriteFile(g_artifact_prefix + path, g_current_input);
+        std::fprintf(stderr, "==%d== Test unit written to %s%s\n", getpid(), g_artifact_prefix.c_str(), path.c_str());
+    }
+
+    class Mutator {
+
+        public:
+            Mutator(uint32_t seed, size_t max_len) : m_rng(seed), m_max_len(max_len) { }
+
+            void Mutate(std::vector<uint8_t> *data, const std::vector<std::vector<uint8_t>> &corpus) {
+                unsigned int count = 1 << this->Below(4);
+                for (unsigned int i = 0; i < count; ++i)
+                    this->MutateOnce(data, corpus);
+
+                if (data->size() > m_max_len)
+                    data->resize(m_max_len);
+            }
+
+            size_t Below(size_t n) {
+                return n ? std::uniform_int_distribution<size_t>(0, n - 1)(m_rng) : 0;
+            }
+
+        private:
+            void MutateOnce(std::vector<uint8_t> *data, const std::vector<std::vector<uint8_t>> &corpus) {
+                static constexpr uint8_t interesting_values[] = { 0x00, 0x01, 0x02, 0x7f, 0x80, 0xfe, 0xff, 0x10, 0x20, 0x40 };
+
+                if (data->empty()) {
+                    data->push_back(static_cast<uint8_t>(this->Below(256)));
+                    return;
+                }
+
+                size_t pos = this->Below(data->size());
+                switch (this->Below(8)) {
+                    case 0:
+                        (*data)[pos] ^= 1 << this->Below(8);
+                        break;
+                    case 1:
+                        (*data)[pos] = static_cast<uint8_t>(this->Below(256));
+                        break;
+                    case 2:
+                        (*data)[pos] = interesting_values[this->Below(std::size(interesting_values))];
+                        break;
+                    case 3:
+                        (*data)[pos] += static_cast<uint8_t>(this->Below(33)) - 16;
+                        break;
+                    case 4:
+                        data->insert(data->begin() + pos, 1 + this->Below(8), static_cast<uint8_t>(this->Below(256)));
+                        break;
+                    case 5:
+                        data->erase(data->begin() + pos, data->begin() + pos + std::min(data->size() - pos, 1 + this->Below(8)));
+                        break;
+                    case 6: {
+                        // Repeat a run of bytes, which tends to produce more reports of the same shape
+                        size_t size = 1 + this->Below(std::min<size_t>(data->size() - pos, 64));
+                        std::vector<uint8_t> run(data->begin() + pos, data->begin() + pos + size);
+                        data->insert(data->begin() + this->Below(data->size() + 1), run.begin(), run.end());
+                        break;
+                    }
+                    default: {
+                        // Splice in part of another corpus entry
+                        auto &other = corpus[this->Below(corpus.size())];
+                        if (other.empty())
+                            break;
+                        size_t from = this->Below(other.size());
+                        size_t size = 1 + this->Below(other.size() - from);
+                        data->insert(data->begin() + pos, other.begin() + from, other.begin() + from + size);
+                        break;
+                    }
+                }
+            }
+
+            std::mt19937 m_rng;
+            size_t m_max_len;
+
+    };
+
+    bool ReadFile(const std::filesystem::path &path, std::vector<uint8_t> *out) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        out->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    double SecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+}
+
+// Called at every basic block of the instrumented code. Edges are hashed from the previous and current block as in AFL.
+extern "C" void __sanitizer_cov_trace_pc(void) {
+    auto location = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+    location = (location >> 4) ^ (location << 8);
+    g_coverage[(location ^ g_previous_location) & (CoverageMapSize - 1)]++;
+    g_previous_location = location >> 1;
+}
+
+int main(int argc, char **argv) {
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    long long runs = -1;
+    double max_total_time = 0;
+    size_t max_len = 512;
+    uint32_t seed = std::random_device()();
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](const char *name) -> const char * {
+            size_t length = std::strlen(name);
+            return (arg.compare(0, length, name) == 0) ? arg.c_str() + length : nullptr;
+        };
+
+        if (auto v = value("-runs=")) runs = std::atoll(v);
+        else if (auto v = value("-max_total_time=")) max_total_time = std::atof(v);
+        else if (auto v = value("-max_len=")) max_len = std::atoll(v);
+        else if (auto v = value("-seed=")) seed = std::strtoul(v, nullptr, 0);
+        else if (auto v = value("-artifact_prefix=")) g_artifact_prefix = v;
+        else if (arg[0] != '-') inputs.push_back(arg);
+    }
+
+    __sanitizer_set_death_callback(WriteCrashInput);
+    std::printf("INFO: Seed: %u\n", seed);
+
+    // Everything named on the command line is run, and the first directory receives new corpus entries
+    std::vector<std::vector<uint8_t>> corpus;
+    std::string corpus_dir;
+    size_t features = 0;
+    for (auto &input : inputs) {
+        std::vector<std::filesystem::path> paths;
+        if (std::filesystem::is_directory(input)) {
+            if (corpus_dir.empty())
+                corpus_dir = input;
+            for (auto &entry : std::filesystem::directory_iterator(input))
+                paths.push_back(entry.path());
+            std::sort(paths.begin(), paths.end());
+        } else if (std::filesystem::exists(input)) {
+            paths.push_back(input);
+        } else {
+            std::fprintf(stderr, "ERROR: %s doesn't exist\n", input.c_str());
+            return 1;
+        }
+
+        for (auto &path : paths) {
+            std::vector<uint8_t> data;
+            if (ReadFile(path, &data)) {
+                RunInput(data, &features);
+                corpus.push_back(std::move(data));
+            }
+        }
+    }
+
+    if (corpus.empty()) {
+        corpus.emplace_back();
+        RunInput(corpus.back(), &features);
+    }
+
+    auto start = Clock::now();
+    std::printf("#%zu\tINITED cov: %zu corp: %zu\n", corpus.size(), features, corpus.size());
+
+    Mutator mutator(seed, max_len);
+    long long run = 0;
+    long long next_pulse = 1;
+    for (; (runs < 0) || (run < runs); ++run) {
+        if ((max_total_time > 0) && ((run & 0xff) == 0) && (SecondsSince(start) >= max_total_time))
+            break;
+
+        auto data = corpus[mutator.Below(corpus.size())];
+        mutator.Mutate(&data, corpus);
+
+        if (RunInput(data, &features)) {
+            std::printf("#%lld\tNEW    cov: %zu corp: %zu exec/s: %.0f\n", run + 1, features, corpus.size() + 1, (run + 1) / SecondsSince(start));
+            if (!corpus_dir.empty())
+                WriteFile(corpus_dir + "/" + GetInputName(data), data);
+            corpus.push_back(std::move(data));
+        } else if (run + 1 == next_pulse) {
+            std::printf("#%lld\tpulse  cov: %zu corp: %zu exec/s: %.0f\n", run + 1, features, corpus.size(), (run + 1) / SecondsSince(start));
+        }
+
+        if (run + 1 == next_pulse)
+            next_pulse *= 2;
+    }
+
+    double seconds = SecondsSince(start);
+    std::printf("Done %lld runs in %.1f second(s)\n", run, seconds);
+    std::printf("stat::number_of_executed_units: %lld\n", run);
+    std::printf("stat::exec_per_sec: %.0f\n", seconds > 0 ? run / seconds : 0.0);
+    std::printf("stat::coverage_features: %zu\n", features);
+    return 0;
+}
@@ -0,0 +1,509 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mcmitm_heap.hpp"
+#include "controllers/controller_management.hpp"
+#include "host_lmem.hpp"
+#include "test.hpp"
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Replays a day of controllers connecting and disconnecting through the allocations mc.mitm makes for them, against the
+// real slab classes and arenas on top of a host exp heap. Whenever every controller is gone again the general and fs
+// arenas must be back to a single free block of their full size: churn mustn't leave fragmentation behind.
+// The same replay is run against a single 64KB exp heap, as used before the split, for comparison.
+namespace {
+
+    using namespace ams;
+    using namespace ams::controller;
+
+    struct HeapDesign {
+        const char *name;
+        void *(*allocate)(size_t size);
+        void (*deallocate)(void *p, size_t size);
+        void *(*allocate_fs)(size_t size);
+        void (*deallocate_fs)(void *p, size_t size);
+    };
+
+    constinit const HeapDesign *g_design;
+
+    // Stands in for the global operator new and delete of the sysmodule, which forward to mitm::Allocate
+    template<typename T>
+    struct DesignAllocator {
+        using value_type = T;
+
+        DesignAllocator(void) = default;
+
+        template<typename U>
+        DesignAllocator(const DesignAllocator<U> &) { }
+
+        T *allocate(size_t count) {
+            void *p = g_design->allocate(count * sizeof(T));
+            if (p == nullptr)
+                throw std::bad_alloc();
+            return static_cast<T *>(p);
+        }
+
+        void deallocate(T *p, size_t count) {
+            g_design->deallocate(p, count * sizeof(T));
+        }
+
+        template<typename U>
+        bool operator==(const DesignAllocator<U> &) const { return true; }
+    };
+
+    using String = std::basic_string<char, std::char_traits<char>, DesignAllocator<char>>;
+    using ControllerRef = std::shared_ptr<void>;
+
+    // Same size and alignment as the driver object, so make_shared asks for exactly what it would on the console
+    template<size_t Size, size_t Alignment>
+    struct ControllerStorage {
+        alignas(Alignment) u8 data[Size];
+    };
+
+    template<typename T>
+    ControllerRef CreateController(void) {
+        return std::allocate_shared<ControllerStorage<sizeof(T), alignof(T)>>(DesignAllocator<T>());
+    }
+
+    struct DriverModel {
+        const char *name;
+        ControllerRef (*create)(void);
+        bool emulated;          // Has a virtual spi flash file held open while connected
+        bool descriptor_plan;   // Loads a compiled HID descriptor plan
+        unsigned int weight;
+    };
+
+    constexpr DriverModel driver_models[] = {
+        { "switch",         CreateController<SwitchController>,       false, false, 6 },
+        { "dualshock4",     CreateController<Dualshock4Controller>,   true,  false, 6 },
+        { "dualsense",      CreateController<DualsenseController>,    true,  false, 4 },
+        { "xboxone",        CreateController<XboxOneController>,      true,  false, 4 },
+        { "wii",            CreateController<WiiController>,          true,  false, 3 },
+        { "8bitdo",         CreateController<EightBitDoController>,   true,  false, 2 },
+        { "steelseries",    CreateController<SteelseriesController>,  true,  false, 1 },
+        { "nvidia_shield",  CreateController<NvidiaShieldController>, true,  false, 1 },
+        { "icade",          CreateController<ICadeController>,        true,  false, 1 },
+        { "unknown",        CreateController<UnknownController>,      true,  true,  1 },
+    };
+
+    // The fs library's own allocations, as approximated here: a path buffer for the duration of each call, and an accessor for as long as a file is open
+    constexpr size_t FsPathBufferSize = 0x301;
+    constexpr size_t FsFileAccessorSize = 0x60;
+
+    constexpr unsigned int DeviceCount = 8;
+    constexpr int64_t ReplaySeconds = 24 * 60 * 60;
+    constexpr int64_t WindowSeconds = 6 * 60 * 60;
+
+    struct WindowStatistics {
+        unsigned int connects;
+        unsigned int peak_connected;
+        double worst_busy_fragmentation;
+        size_t min_busy_largest_block;
+        unsigned int quiescent_points;
+        size_t max_quiescent_free_blocks;
+    };
+
+    struct ExpHeapCheck {
+        lmem::HeapHandle handle;
+        test::ExpHeapState initial;
+    };
+
+    double GetFragmentation(const test::ExpHeapState *state) {
+        return state->free_size ? 1.0 - static_cast<double>(state->largest_free_block) / state->free_size : 0.0;
+    }
+
+    // Finds the exp heap behind an allocation function by allocating from it
+    lmem::HeapHandle FindHeap(void *(*allocate)(size_t), void (*deallocate)(void *, size_t), size_t size) {
+        void *p = allocate(size);
+        auto handle = test::FindExpHeap(p);
+        deallocate(p, size);
+        return handle;
+    }
+
+    class ChurnReplay {
+
+        public:
+            ChurnReplay(const HeapDesign *design) : m_rng(2021), m_windows(), m_controllers(), m_pending_controllers(), m_devices(), m_session_end(-1), m_quiescent_mismatches(0) {
+                g_design = design;
+
+                // 0x200 bytes is too big for any slab class, so comes from the general heap
+                m_general.handle = FindHeap(design->allocate, design->deallocate, 0x200);
+                m_fs.handle = FindHeap(design->allocate_fs, design->deallocate_fs, FsPathBufferSize);
+                test::GetExpHeapState(m_general.handle, &m_general.initial);
+                test::GetExpHeapState(m_fs.handle, &m_fs.initial);
+
+                std::vector<unsigned int> weights;
+                for (auto &model : driver_models)
+                    weights.push_back(model.weight);
+                std::discrete_distribution<unsigned int> pick_driver(weights.begin(), weights.end());
+
+                for (unsigned int i = 0; i < DeviceCount; ++i) {
+                    auto &device = m_devices[i];
+                    device.model = &driver_models[pick_driver(m_rng)];
+                    device.address = { 0x98, 0xb6, 0xe9, 0x00, 0x10, static_cast<u8>(i) };
+                    device.connect_at = -1;
+                    device.disconnect_at = -1;
+                }
+            }
+
+            ~ChurnReplay() {
+                m_controllers.clear();
+                m_controllers.shrink_to_fit();
+                m_pending_controllers.shrink_to_fit();
+            }
+
+            void Run(void) {
+                for (int64_t now = 0; now < ReplaySeconds; ++now) {
+                    this->Step(now);
+                }
+
+                // Wind down whatever is still connected at the end of the day
+                for (auto &device : m_devices) {
+                    if (device.controller)
+                        this->Disconnect(&device);
+                }
+                this->CheckQuiescent(ReplaySeconds - 1);
+            }
+
+            void Print(void) const {
+                std::printf("  %s:\n", g_design->name);
+                for (int64_t i = 0; i < ReplaySeconds / WindowSeconds; ++i) {
+                    auto &window = m_windows[i];
+                    std::printf("    %02lld-%02lldh: %3u connects, peak %u connected, busy: worst fragmentation %4.1f%% min largest block %5zu, idle: %u times, at most %zu free blocks\n",
+                        (long long)(i * WindowSeconds / 3600), (long long)((i + 1) * WindowSeconds / 3600), window.connects, window.peak_connected,
+                        window.worst_busy_fragmentation * 100.0, window.min_busy_largest_block, window.quiescent_points, window.max_quiescent_free_blocks);
+                }
+            }
+
+            // Times an idle heap wasn't back to how it started
+            unsigned int GetQuiescentMismatches(void) const {
+                return m_quiescent_mismatches;
+            }
+
+            unsigned int GetQuiescentPoints(void) const {
+                unsigned int count = 0;
+                for (auto &window : m_windows)
+                    count += window.quiescent_points;
+                return count;
+            }
+
+        private:
+            struct Device {
+                const DriverModel *model;
+                bluetooth::Address address;
+                bool has_directory;
+                ControllerRef controller;
+                void *spi_flash_file;
+                int64_t connect_at;
+                int64_t disconnect_at;
+            };
+
+            struct PendingController {
+                ControllerRef controller;
+                ControllerType type;
+            };
+
+            WindowStatistics *GetWindow(int64_t now) {
+                return &m_windows[now / WindowSeconds];
+            }
+
+            bool Chance(double probability) {
+                return std::uniform_real_distribution<double>(0.0, 1.0)(m_rng) < probability;
+            }
+
+            int64_t Uniform(int64_t min, int64_t max) {
+                return std::uniform_int_distribution<int64_t>(min, max)(m_rng);
+            }
+
+            unsigned int ConnectedCount(void) const {
+                return std::count_if(std::begin(m_devices), std::end(m_devices), [](auto &device) { return device.controller != nullptr; });
+            }
+
+            bool Busy(void) const {
+                return std::any_of(std::begin(m_devices), std::end(m_devices), [](auto &device) { return (device.controller != nullptr) || (device.connect_at >= 0); });
+            }
+
+            void Step(int64_t now) {
+                if (m_session_end < 0) {
+                    // Somebody picks up a controller every 40 minutes or so, for a session of up to three hours with one to four players
+                    if ((now < ReplaySeconds - 3600) && this->Chance(1.0 / (40 * 60))) {
+                        m_session_end = now + this->Uniform(20 * 60, 3 * 60 * 60);
+
+                        std::vector<unsigned int> order(DeviceCount);
+                        std::iota(order.begin(), order.end(), 0);
+                        std::shuffle(order.begin(), order.end(), m_rng);
+                        for (unsigned int i = 0; i < this->Uniform(1, 4); ++i)
+                            m_devices[order[i]].connect_at = now + this->Uniform(0, 120);
+                    }
+                } else if (now == m_session_end) {
+                    for (auto &device : m_devices) {
+                        device.connect_at = -1;
+                        if (device.controller)
+                            device.disconnect_at = now + this->Uniform(0, 30);
+                    }
+                } else if (now < m_session_end) {
+                    for (auto &device : m_devices) {
+                        if (!device.controller || (device.disconnect_at >= 0))
+                            continue;
+
+                        if (this->Chance(1.0 / (25 * 60))) {
+                            // Dropped by the radio or the controller's power saving, and woken straight back up
+                            device.disconnect_at = now;
+                            device.connect_at = now + this->Uniform(2, 90);
+                        } else if (this->Chance(1.0 / (2 * 60 * 60))) {
+                            // Swapped for a different controller
+                            device.disconnect_at = now;
+                            for (auto &other : m_devices) {
+                                if (!other.controller && (other.connect_at < 0)) {
+                                    other.connect_at = now + this->Uniform(5, 30);
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                for (auto &device : m_devices) {
+                    if (device.disconnect_at == now) {
+                        device.disconnect_at = -1;
+                        this->Disconnect(&device);
+                    }
+                    if (device.connect_at == now) {
+                        device.connect_at = -1;
+                        this->Connect(&device, now);
+                    }
+                }
+
+                if (m_session_end >= 0) {
+                    if ((now > m_session_end) && !this->Busy()) {
+                        m_session_end = -1;
+                        this->CheckQuiescent(now);
+                    } else {
+                        this->SampleBusy(now);
+                    }
+                }
+            }
+
+            String GetControllerDirectory(const bluetooth::Address *address) {
+                char path[0x100];
+                util::SNPrintf(path, sizeof(path), "sdmc:/config/MissionControl/controllers/%02x%02x%02x%02x%02x%02x",
+                    address->address[0], address->address[1], address->address[2], address->address[3], address->address[4], address->address[5]);
+                return String(path);
+            }
+
+            void FsCall(void) {
+                g_design->deallocate_fs(g_design->allocate_fs(FsPathBufferSize), FsPathBufferSize);
+            }
+
+            void *FsOpenFile(void) {
+                this->FsCall();
+                return g_design->allocate_fs(FsFileAccessorSize);
+            }
+
+            void FsCloseFile(void *file) {
+                g_design->deallocate_fs(file, FsFileAccessorSize);
+            }
+
+            // Reading or writing a small file by path: profile.bin, combos.ini and the like
+            void FsUseFile(const bluetooth::Address *address, const char *name) {
+                String path = this->GetControllerDirectory(address) + name;
+                this->FsCloseFile(this->FsOpenFile());
+            }
+
+            // Dropping the last reference from behind the I/O queue, as ReleaseController does
+            void ReleaseController(ControllerRef controller) {
+                DesignAllocator<ControllerRef> allocator;
+                auto ref = allocator.allocate(1);
+                std::construct_at(ref, std::move(controller));
+                std::destroy_at(ref);
+                allocator.deallocate(ref, 1);
+            }
+
+            // RegisterController, then the attach thread's InitializeController
+            void Connect(Device *device, int64_t now) {
+                auto model = device->model;
+                auto address = &device->address;
+
+                m_controllers.push_back(model->create());
+                m_pending_controllers.push_back({ m_controllers.back(), ControllerType_Switch });
+
+                PendingController pending = std::move(m_pending_controllers.front());
+                m_pending_controllers.erase(m_pending_controllers.begin());
+
+                this->FsUseFile(address, "/profile.bin");
+                this->FsUseFile(address, "/settsi_disable.flag");
+
+                if (model->descriptor_plan)
+                    this->FsUseFile(address, "/hid_plan.bin");
+
+                if (model->emulated) {
+                    this->FsUseFile(address, "/sticks.ini");
+                    this->FsUseFile(address, "/combos.ini");
+
+                    String path = this->GetControllerDirectory(address);
+                    if (device->has_directory) {
+                        String spi_flash_path = path + "/spi_flash.bin";
+                        device->spi_flash_file = this->FsOpenFile();
+                    } else {
+                        // First connection creates the directory and the virtual spi flash, then saves the profile
+                        this->FsCall();
+                        path += "/spi_flash.bin";
+                        this->FsCall();
+                        this->FsCall();
+                        this->FsCloseFile(this->FsOpenFile());
+                        device->spi_flash_file = this->FsOpenFile();
+                        this->FsCall();
+                        this->FsUseFile(address, "/profile.bin");
+                        device->has_directory = true;
+                    }
+                }
+
+                device->controller = pending.controller;
+                this->ReleaseController(std::move(pending.controller));
+
+                auto window = this->GetWindow(now);
+                window->connects++;
+                window->peak_connected = std::max(window->peak_connected, this->ConnectedCount());
+            }
+
+            void Disconnect(Device *device) {
+                auto controller = std::move(device->controller);
+
+                for (auto it = m_controllers.begin(); it < m_controllers.end(); ++it) {
+                    if (*it == controller) {
+                        m_controllers.erase(it);
+                        break;
+                    }
+                }
+
+                if (device->model->emulated)
+                    this->FsCloseFile(device->spi_flash_file);
+
+                this->ReleaseController(std::move(controller));
+            }
+
+            void SampleBusy(int64_t now) {
+                test::ExpHeapState state;
+                test::GetExpHeapState(m_general.handle, &state);
+
+                auto window = this->GetWindow(now);
+                window->worst_busy_fragmentation = std::max(window->worst_busy_fragmentation, GetFragmentation(&state));
+                window->min_busy_largest_block = window->min_busy_largest_block ? std::min(window->min_busy_largest_block, state.largest_free_block) : state.largest_free_block;
+            }
+
+            void CheckQuiescent(int64_t now) {
+                auto window = this->GetWindow(now);
+                window->quiescent_points++;
+
+                for (auto heap : { &m_general, &m_fs }) {
+                    test::ExpHeapState state;
+                    test::GetExpHeapState(heap->handle, &state);
+                    window->max_quiescent_free_blocks = std::max(window->max_quiescent_free_blocks, state.free_block_count);
+
+                    if ((state.free_block_count != heap->initial.free_block_count) || (state.largest_free_block != heap->initial.largest_free_block))
+                        m_quiescent_mismatches++;
+                }
+            }
+
+            std::mt19937 m_rng;
+            WindowStatistics m_windows[ReplaySeconds / WindowSeconds];
+
+            // Live for the whole day, like the sysmodule's own controller lists
+            std::vector<ControllerRef, DesignAllocator<ControllerRef>> m_controllers;
+            std::vector<PendingController, DesignAllocator<PendingController>> m_pending_controllers;
+
+            Device m_devices[DeviceCount];
+            int64_t m_session_end;
+
+            ExpHeapCheck m_general;
+            ExpHeapCheck m_fs;
+            unsigned int m_quiescent_mismatches;
+
+    };
+
+    // One exp heap for everything, fs included
+    alignas(0x40) constinit u8 g_single_heap_memory[64_KB];
+    constinit lmem::HeapHandle g_single_heap;
+
+    void *AllocateFromSingleHeap(size_t size) {
+        return lmem::AllocateFromExpHeap(g_single_heap, size);
+    }
+
+    void FreeToSingleHeap(void *p, size_t size) {
+        AMS_UNUSED(size);
+        lmem::FreeToExpHeap(g_single_heap, p);
+    }
+
+    constexpr HeapDesign split_heap_design = {
+        "slab classes, general and fs arenas",
+        mitm::Allocate, mitm::Deallocate, mitm::AllocateForFs, mitm::DeallocateForFs,
+    };
+
+    constexpr HeapDesign single_heap_design = {
+        "single exp heap",
+        AllocateFromSingleHeap, FreeToSingleHeap, AllocateFromSingleHeap, FreeToSingleHeap,
+    };
+
+    void TestSplitHeap(void) {
+        ChurnReplay replay(&split_heap_design);
+        try {
+            replay.Run();
+        } catch (const std::bad_alloc &) {
+            TEST_CHECK(!"allocation failed");
+        }
+        replay.Print();
+
+        TEST_CHECK(replay.GetQuiescentPoints() > 1);
+        TEST_CHECK(replay.GetQuiescentMismatches() == 0);
+
+        mitm::HeapArenaStatistics general, fs;
+        mitm::GetHeapStatistics(&general, &fs);
+        TEST_CHECK(general.failed_allocations == 0);
+        TEST_CHECK(fs.failed_allocations == 0);
+
+        // Everything small enough for a slab class should have found room in one
+        mitm::SlabClassStatistics slabs[mitm::SlabClassCount];
+        mitm::GetSlabStatistics(slabs, mitm::SlabClassCount);
+        for (auto &slab : slabs) {
+            std::printf("    slab 0x%03x: %6llu allocations, peak %3u of %3u blocks\n", slab.block_size, (unsigned long long)slab.allocations, slab.used_max, slab.block_count);
+            TEST_CHECK(slab.overflows == 0);
+        }
+    }
+
+    void MeasureSingleHeap(void) {
+        g_single_heap = lmem::CreateExpHeap(g_single_heap_memory, sizeof(g_single_heap_memory), lmem::CreateOption_ThreadSafe);
+        {
+            ChurnReplay replay(&single_heap_design);
+            try {
+                replay.Run();
+            } catch (const std::bad_alloc &) {
+                std::printf("  %s: allocation failed\n", single_heap_design.name);
+            }
+            replay.Print();
+            std::printf("    idle heap differed from its initial state %u of %u times\n", replay.GetQuiescentMismatches(), replay.GetQuiescentPoints() * 2);
+        }
+        lmem::DestroyExpHeap(g_single_heap);
+    }
+
+}
+
+int main(void) {
+    TestSplitHeap();
+    MeasureSingleHeap();
+
+    return ams::test::Finish("heap_churn_test");
+}
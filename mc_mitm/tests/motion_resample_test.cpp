@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "controllers/switch_motion.hpp"
+#include "test.hpp"
+#include <cmath>
+#include <random>
+
+// Feeds SwitchMotionSampleBuffer known signals at the rates of the controllers that produce motion, and checks each
+// of the three resampled Switch slots against the signal's true value at the slot time. Also times a report's worth of work.
+namespace {
+
+    using namespace ams;
+    using namespace ams::controller;
+
+    constexpr double Pi = 3.14159265358979323846;
+
+    // Value of one axis of a test signal at a given time in seconds
+    typedef double (*MotionSignal)(double t, unsigned int axis);
+
+    double RampSignal(double t, unsigned int axis) {
+        return -12000.0 + 1500.0 * axis + (2000.0 + 1000.0 * axis) * t;
+    }
+
+    double SineSignal(double t, unsigned int axis) {
+        // Roughly a controller being waved about at 2Hz, at a different phase on each axis
+        return 8000.0 * std::sin(2.0 * Pi * 2.0 * t + axis);
+    }
+
+    int16_t Quantise(double value) {
+        return static_cast<int16_t>(std::clamp(std::lround(value), long(INT16_MIN), long(INT16_MAX)));
+    }
+
+    double TickToSeconds(os::Tick tick) {
+        return static_cast<double>(tick.GetInt64Value()) / os::GetSystemTickFrequency();
+    }
+
+    os::Tick MicroSecondsToTick(int64_t us) {
+        return os::ConvertToTick(TimeSpan::FromMicroSeconds(us));
+    }
+
+    void PushSignal(SwitchMotionSampleBuffer *buffer, MotionSignal signal, os::Tick tick) {
+        double t = TickToSeconds(tick);
+        Switch6AxisData sample = {
+            .accel_x = Quantise(signal(t, 0)),
+            .accel_y = Quantise(signal(t, 1)),
+            .accel_z = Quantise(signal(t, 2)),
+            .gyro_1  = Quantise(signal(t, 3)),
+            .gyro_2  = Quantise(signal(t, 4)),
+            .gyro_3  = Quantise(signal(t, 5)),
+        };
+        buffer->Push(tick, &sample);
+    }
+
+    int16_t GetAxis(const Switch6AxisData *sample, unsigned int axis) {
+        const int16_t axes[] = { sample->accel_x, sample->accel_y, sample->accel_z, sample->gyro_1, sample->gyro_2, sample->gyro_3 };
+        return axes[axis];
+    }
+
+    struct ResampleError {
+        double max_error;
+        unsigned int reports;
+    };
+
+    // Pushes samples interval_us apart, with up to jitter_us of random timing error on each, and checks every report once 10ms of history exists
+    ResampleError MeasureResampleError(MotionSignal signal, int64_t interval_us, int64_t jitter_us) {
+        SwitchMotionSampleBuffer buffer;
+        std::mt19937 rng(interval_us);
+        std::uniform_int_distribution<int64_t> jitter(-jitter_us, jitter_us);
+
+        ResampleError error = {};
+
+        // Two seconds of samples, which keeps the ramp within range
+        const int64_t start_us = 1'000'000;
+        for (int64_t n = 0; n < 2'000'000 / interval_us; ++n) {
+            int64_t sample_us = start_us + n * interval_us + jitter(rng);
+            os::Tick newest = MicroSecondsToTick(sample_us);
+            PushSignal(&buffer, signal, newest);
+
+            if (sample_us - start_us < 10'000 + jitter_us)
+                continue;
+
+            Switch6AxisData samples[3];
+            if (!TEST_CHECK(buffer.Resample(samples)))
+                break;
+
+            // Slots are 10, 5 and 0ms before the newest sample, oldest first
+            for (unsigned int slot = 0; slot < 3; ++slot) {
+                double t = TickToSeconds(newest - os::ConvertToTick(TimeSpan::FromMilliSeconds(5 * (2 - slot))));
+                for (unsigned int axis = 0; axis < 6; ++axis) {
+                    error.max_error = std::max(error.max_error, std::abs(GetAxis(&samples[slot], axis) - signal(t, axis)));
+                }
+            }
+            error.reports++;
+        }
+
+        return error;
+    }
+
+    void TestRampAccuracy(void) {
+        // A straight line is reproduced exactly by linear interpolation, leaving only rounding of the samples and the Q15 weight
+        const int64_t intervals_us[] = { 10'000, 4'000, 1'000 };    // Wii Remote, 250Hz and 1000Hz (DualShock 4) sources
+        for (auto interval_us : intervals_us) {
+            for (int64_t jitter_us : { int64_t(0), interval_us / 4 }) {
+                auto error = MeasureResampleError(RampSignal, interval_us, jitter_us);
+                std::printf("  ramp   %5lldus +/- %4lldus: max error %.2f LSB over %u reports\n", (long long)interval_us, (long long)jitter_us, error.max_error, error.reports);
+                TEST_CHECK(error.reports > 0);
+                TEST_CHECK(error.max_error <= 2.0);
+            }
+        }
+    }
+
+    void TestSineAccuracy(void) {
+        // Linear interpolation of a sine is off by at most A * w^2 * h^2 / 8 between samples h apart
+        const int64_t intervals_us[] = { 10'000, 4'000, 1'000 };
+        for (auto interval_us : intervals_us) {
+            double h = interval_us / 1e6;
+            double w = 2.0 * Pi * 2.0;
+            double bound = 8000.0 * w * w * h * h / 8.0 + 2.0;
+
+            auto error = MeasureResampleError(SineSignal, interval_us, 0);
+            std::printf("  sine   %5lldus: max error %.2f LSB (bound %.2f) over %u reports\n", (long long)interval_us, error.max_error, bound, error.reports);
+            TEST_CHECK(error.reports > 0);
+            TEST_CHECK(error.max_error <= bound);
+        }
+    }
+
+    void TestClamping(void) {
+        SwitchMotionSampleBuffer buffer;
+        Switch6AxisData samples[3];
+
+        TEST_CHECK(!buffer.Resample(samples));
+
+        // With a single sample every slot takes its value
+        const Switch6AxisData first = { 100, -200, 300, -400, 500, -600 };
+        buffer.Push(MicroSecondsToTick(50'000), &first);
+        TEST_CHECK(buffer.Resample(samples));
+        for (auto &sample : samples)
+            TEST_CHECK(std::memcmp(&sample, &first, sizeof(sample)) == 0);
+
+        // Slots older than the oldest sample are held at it rather than extrapolated
+        const Switch6AxisData second = { 200, -100, 400, -300, 600, -500 };
+        buffer.Push(MicroSecondsToTick(52'000), &second);
+        TEST_CHECK(buffer.Resample(samples));
+        TEST_CHECK(std::memcmp(&samples[0], &first, sizeof(first)) == 0);
+        TEST_CHECK(std::memcmp(&samples[1], &first, sizeof(first)) == 0);
+        TEST_CHECK(std::memcmp(&samples[2], &second, sizeof(second)) == 0);
+
+        buffer.Clear();
+        TEST_CHECK(!buffer.Resample(samples));
+    }
+
+    void TestFullScaleInterpolation(void) {
+        // The largest possible step between samples must interpolate without overflowing
+        SwitchMotionSampleBuffer buffer;
+        const Switch6AxisData low  = { INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX };
+        const Switch6AxisData high = { INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN };
+
+        buffer.Push(MicroSecondsToTick(0), &low);
+        buffer.Push(MicroSecondsToTick(7'000), &high);
+        buffer.Push(MicroSecondsToTick(14'000), &low);
+
+        Switch6AxisData samples[3];
+        TEST_CHECK(buffer.Resample(samples));
+        for (unsigned int axis = 0; axis < 6; ++axis) {
+            // Slots at 4, 9 and 14ms
+            TEST_CHECK(std::abs(GetAxis(&samples[0], axis) - (GetAxis(&low, axis) * 3.0 / 7.0 + GetAxis(&high, axis) * 4.0 / 7.0)) <= 2.0);
+            TEST_CHECK(std::abs(GetAxis(&samples[1], axis) - (GetAxis(&low, axis) * 2.0 / 7.0 + GetAxis(&high, axis) * 5.0 / 7.0)) <= 2.0);
+            TEST_CHECK(GetAxis(&samples[2], axis) == GetAxis(&low, axis));
+        }
+    }
+
+    void MeasureCostPerReport(void) {
+        // A DualShock 4 delivers around 1000Hz of motion, so each 15ms Switch report has about 15 new samples behind it
+        constexpr unsigned int ReportCount = 200'000;
+        constexpr unsigned int SamplesPerReport = 15;
+
+        SwitchMotionSampleBuffer buffer;
+        Switch6AxisData sample = { 1, 2, 3, 4, 5, 6 };
+        Switch6AxisData samples[3];
+        int64_t sample_us = 0;
+        int64_t checksum = 0;
+
+        double push_ns = 0;
+        double resample_ns = 0;
+        for (unsigned int report = 0; report < ReportCount; ++report) {
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < SamplesPerReport; ++i) {
+                sample.accel_x = static_cast<int16_t>(sample_us);
+                buffer.Push(MicroSecondsToTick(sample_us += 1'000), &sample);
+            }
+            push_ns += ams::test::NanoSecondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            buffer.Resample(samples);
+            resample_ns += ams::test::NanoSecondsSince(start);
+
+            checksum += samples[0].accel_x;
+        }
+
+        push_ns /= ReportCount;
+        resample_ns /= ReportCount;
+        std::printf("  cost: %.1fns to push %u samples, %.1fns to resample, per report (checksum %lld)\n", push_ns, SamplesPerReport, resample_ns, (long long)checksum);
+
+        // Generous enough for any host, while still catching an accidental change in complexity
+        if constexpr (ams::test::EnforceTimingBudgets)
+            TEST_CHECK(resample_ns < 1000.0);
+    }
+
+}
+
+int main(void) {
+    TestRampAccuracy();
+    TestSineAccuracy();
+    TestClamping();
+    TestFullScaleInterpolation();
+    MeasureCostPerReport();
+
+    return ams::test::Finish("motion_resample_test");
+}
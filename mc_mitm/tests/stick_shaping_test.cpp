@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "controllers/stick_shaping.hpp"
+#include "test.hpp"
+#include <cstdlib>
+
+// Sweeps a stick from centre to full deflection through StickShaper and checks the deadzones where they're configured:
+// nothing comes out inside the inner deadzone, at least the anti-deadzone just outside it, and full deflection past the outer one.
+namespace {
+
+    using namespace ams;
+    using namespace ams::controller;
+
+    constexpr int32_t StickMax = STICK_ZERO - 1;
+
+    StickShapingConfig MakeConfig(StickDeadzoneMode mode, uint8_t inner, uint8_t outer, uint8_t anti, uint16_t curve) {
+        return {
+            .enable = true,
+            .deadzone_mode = mode,
+            .inner_deadzone = inner,
+            .outer_deadzone = outer,
+            .anti_deadzone = anti,
+            .response_curve = curve,
+            .scale_x = 100,
+            .scale_y = 100
+        };
+    }
+
+    // Output deflection along x for a deflection along x, or along the diagonal when diagonal is set
+    int32_t Shape(const StickShaper &shaper, int32_t deflection, bool diagonal = false) {
+        SwitchAnalogStick stick;
+        if (diagonal) {
+            int32_t axis = (deflection * 181) >> 8;     // deflection / sqrt(2)
+            stick.SetData(STICK_ZERO + axis, STICK_ZERO + axis);
+        } else {
+            stick.SetData(STICK_ZERO + deflection, STICK_ZERO);
+        }
+
+        shaper.Apply(&stick);
+
+        if (diagonal)
+            return ((stick.GetX() - STICK_ZERO) * 362) >> 8;   // back to a magnitude
+        return stick.GetX() - STICK_ZERO;
+    }
+
+    int32_t Percent(double percent) {
+        return static_cast<int32_t>(percent * STICK_ZERO / 100.0);
+    }
+
+    void TestSweep(StickDeadzoneMode mode, uint8_t inner, uint8_t outer, uint8_t anti, uint16_t curve) {
+        auto config = MakeConfig(mode, inner, outer, anti, curve);
+        StickShaper shaper;
+        shaper.Configure(&config);
+        TEST_CHECK(shaper.IsEnabled());
+
+        int32_t inner_edge = (inner * STICK_ZERO) / 100;
+        int32_t outer_edge = STICK_ZERO - (outer * STICK_ZERO) / 100;
+        int32_t anti_floor = (anti * StickMax) / 100;
+
+        unsigned int failures = 0;
+        int32_t previous = 0;
+        for (int32_t deflection = 0; deflection <= StickMax; ++deflection) {
+            int32_t output = Shape(shaper, deflection);
+
+            bool ok = (output >= previous) && (output <= StickMax);
+            if (deflection <= inner_edge)
+                ok &= (output == 0);
+            else
+                ok &= (output >= anti_floor);
+            if (deflection >= outer_edge)
+                ok &= (output == StickMax);
+
+            if (!ok && (failures++ < 4))
+                std::fprintf(stderr, "  mode %u inner %u%% outer %u%% anti %u%% curve %u: %d in gives %d out\n", mode, inner, outer, anti, curve, deflection, output);
+            previous = output;
+        }
+        TEST_CHECK(failures == 0);
+
+        std::printf("  sweep  %-6s inner %2u%% outer %2u%% anti %2u%% curve %3u: %d just outside the deadzone\n",
+            mode == StickDeadzoneMode_Axial ? "axial" : "radial", inner, outer, anti, curve, Shape(shaper, inner_edge + 1));
+    }
+
+    void TestDeadzoneEdges(void) {
+        StickShaper shaper;
+
+        // Stick drift inside the deadzone must not leak through, and the anti-deadzone is a step rather than a ramp
+        auto config = MakeConfig(StickDeadzoneMode_Radial, 5, 0, 30, 100);
+        shaper.Configure(&config);
+        TEST_CHECK(Shape(shaper, Percent(3.5)) == 0);
+        TEST_CHECK(Shape(shaper, Percent(4.5)) == 0);
+        TEST_CHECK(Shape(shaper, Percent(3.5), true) == 0);
+        TEST_CHECK(Shape(shaper, Percent(5.5)) >= Percent(30));
+        TEST_CHECK(Shape(shaper, Percent(5.5), true) >= Percent(30) - 4);
+
+        config = MakeConfig(StickDeadzoneMode_Radial, 10, 0, 25, 100);
+        shaper.Configure(&config);
+        int32_t output = Shape(shaper, Percent(11));
+        TEST_CHECK((output >= Percent(25)) && (output <= Percent(27)));
+
+        // With no deadzones and a linear curve the stick is left as it was
+        config = MakeConfig(StickDeadzoneMode_Axial, 0, 0, 0, 100);
+        shaper.Configure(&config);
+        unsigned int failures = 0;
+        for (int32_t deflection = -STICK_ZERO; deflection <= StickMax; ++deflection) {
+            SwitchAnalogStick stick;
+            stick.SetData(STICK_ZERO + deflection, STICK_ZERO);
+            shaper.Apply(&stick);
+            failures += std::abs(int32_t(stick.GetX() - STICK_ZERO) - deflection) > 1;
+        }
+        TEST_CHECK(failures == 0);
+    }
+
+    void TestInvalidConfig(void) {
+        StickShaper shaper;
+
+        auto config = MakeConfig(StickDeadzoneMode_Radial, 60, 40, 0, 100);
+        shaper.Configure(&config);
+        TEST_CHECK(!shaper.IsEnabled());
+
+        config = MakeConfig(StickDeadzoneMode_Radial, 10, 10, 0, 0);
+        shaper.Configure(&config);
+        TEST_CHECK(!shaper.IsEnabled());
+    }
+
+    void MeasureCostPerReport(void) {
+        constexpr unsigned int ReportCount = 1'000'000;
+
+        auto config = MakeConfig(StickDeadzoneMode_Radial, 8, 5, 20, 150);
+        StickShaper shaper;
+        shaper.Configure(&config);
+
+        // Both sticks of a report, swept around the whole range
+        uint32_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < ReportCount; ++i) {
+            SwitchAnalogStick left, right;
+            left.SetData(i & 0xfff, (i >> 3) & 0xfff);
+            right.SetData((i * 7) & 0xfff, (i >> 5) & 0xfff);
+            shaper.Apply(&left);
+            shaper.Apply(&right);
+            checksum += left.GetX() + right.GetY();
+        }
+        double ns = test::NanoSecondsSince(start) / ReportCount;
+
+        std::printf("  cost: %.1fns to shape both sticks, per report (checksum %u)\n", ns, checksum);
+
+        // Radial mode takes an integer square root per stick, which dominates. Generous, but catches a per report table rebuild.
+        if constexpr (ams::test::EnforceTimingBudgets)
+            TEST_CHECK(ns < 500.0);
+    }
+
+}
+
+int main(void) {
+    for (auto mode : { StickDeadzoneMode_Radial, StickDeadzoneMode_Axial }) {
+        TestSweep(mode, 5, 0, 30, 100);
+        TestSweep(mode, 10, 0, 25, 100);
+        TestSweep(mode, 8, 10, 20, 200);
+        TestSweep(mode, 15, 5, 0, 50);
+        TestSweep(mode, 0, 0, 10, 100);
+        TestSweep(mode, 0, 0, 0, 100);
+    }
+    TestDeadzoneEdges();
+    TestInvalidConfig();
+    MeasureCostPerReport();
+
+    return ams::test::Finish("stick_shaping_test");
+}
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// Host stand-in for the parts of libstratosphere used by the sources built into the tests.
+// Interfaces follow libstratosphere closely enough that those sources build unmodified. Implementations live under ../support.
+#include <switch.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#define AMS_UNUSED(...)         ::ams::impl::UnusedImpl(__VA_ARGS__)
+#define AMS_LIKELY(expr)        __builtin_expect(!!(expr), 1)
+#define AMS_UNLIKELY(expr)      __builtin_expect(!!(expr), 0)
+#define AMS_ASSERT(...)         ((void)0)
+#define AMS_ABORT(...)          ::std::abort()
+#define AMS_ABORT_UNLESS(expr)  do { if (AMS_UNLIKELY(!(expr))) ::std::abort(); } while (0)
+
+#define R_SUCCEEDED(res)        (static_cast<::ams::Result>(res).IsSuccess())
+#define R_FAILED(res)           (static_cast<::ams::Result>(res).IsFailure())
+#define R_TRY(res_expr)         do { const ::ams::Result _tmp_r_try_rc = (res_expr); if (R_FAILED(_tmp_r_try_rc)) { return _tmp_r_try_rc; } } while (0)
+#define R_ABORT_UNLESS(res_expr) AMS_ABORT_UNLESS(R_SUCCEEDED(res_expr))
+
+#define AMS_CONCATENATE_IMPL(s1, s2) s1##s2
+#define AMS_CONCATENATE(s1, s2)      AMS_CONCATENATE_IMPL(s1, s2)
+#define ON_SCOPE_EXIT           auto AMS_CONCATENATE(scope_exit_guard_, __LINE__) = ::ams::impl::ScopeGuardOnExit() + [&]() ALWAYS_INLINE_LAMBDA
+#define ALWAYS_INLINE_LAMBDA
+
+namespace ams {
+
+    namespace impl {
+
+        template<typename... ArgTypes>
+        constexpr void UnusedImpl(ArgTypes &&...) { }
+
+        template<class F>
+        class ScopeGuard {
+            public:
+                explicit ScopeGuard(F f) : m_f(std::move(f)) { }
+                ~ScopeGuard() { m_f(); }
+            private:
+                F m_f;
+        };
+
+        struct ScopeGuardOnExit {
+            template<class F>
+            ScopeGuard<F> operator+(F &&f) { return ScopeGuard<F>(std::forward<F>(f)); }
+        };
+
+    }
+
+    class Result {
+        public:
+            constexpr Result(void) : m_value(0) { }
+            constexpr Result(u32 value) : m_value(value) { }
+
+            constexpr bool IsSuccess(void) const { return m_value == 0; }
+            constexpr bool IsFailure(void) const { return m_value != 0; }
+            constexpr u32 GetValue(void) const { return m_value; }
+
+        private:
+            u32 m_value;
+    };
+
+    constexpr Result ResultSuccess(void) { return Result(); }
+
+    class TimeSpan {
+        public:
+            constexpr TimeSpan(void) : m_ns(0) { }
+
+            static constexpr TimeSpan FromNanoSeconds(s64 ns)  { return TimeSpan(ns); }
+            static constexpr TimeSpan FromMicroSeconds(s64 us) { return TimeSpan(us * 1000); }
+            static constexpr TimeSpan FromMilliSeconds(s64 ms) { return TimeSpan(ms * 1000 * 1000); }
+            static constexpr TimeSpan FromSeconds(s64 s)       { return TimeSpan(s * 1000 * 1000 * 1000); }
+
+            constexpr s64 GetNanoSeconds(void) const  { return m_ns; }
+            constexpr s64 GetMicroSeconds(void) const { return m_ns / 1000; }
+            constexpr s64 GetMilliSeconds(void) const { return m_ns / (1000 * 1000); }
+            constexpr s64 GetSeconds(void) const      { return m_ns / (1000 * 1000 * 1000); }
+
+            friend constexpr auto operator<=>(const TimeSpan &lhs, const TimeSpan &rhs) = default;
+            friend constexpr TimeSpan operator+(const TimeSpan &lhs, const TimeSpan &rhs) { return TimeSpan(lhs.m_ns + rhs.m_ns); }
+            friend constexpr TimeSpan operator-(const TimeSpan &lhs, const TimeSpan &rhs) { return TimeSpan(lhs.m_ns - rhs.m_ns); }
+
+        private:
+            constexpr explicit TimeSpan(s64 ns) : m_ns(ns) { }
+
+            s64 m_ns;
+    };
+
+    constexpr size_t operator ""_KB(unsigned long long size) { return size * 1024; }
+    constexpr size_t operator ""_MB(unsigned long long size) { return size * 1024 * 1024; }
+
+    namespace util {
+
+        template<typename T>
+        constexpr T SwapBytes(T value) {
+            if constexpr (sizeof(T) == 2)
+                return static_cast<T>(__builtin_bswap16(value));
+            else if constexpr (sizeof(T) == 4)
+                return static_cast<T>(__builtin_bswap32(value));
+            else
+                return static_cast<T>(__builtin_bswap64(value));
+        }
+
+        template<typename T>
+        constexpr T AlignUp(T value, size_t alignment) {
+            return static_cast<T>((value + alignment - 1) & ~(alignment - 1));
+        }
+
+        template<typename T>
+        constexpr T AlignDown(T value, size_t alignment) {
+            return static_cast<T>(value & ~(alignment - 1));
+        }
+
+        template<typename T>
+        constexpr bool IsPowerOfTwo(T value) {
+            return (value > 0) && ((value & (value - 1)) == 0);
+        }
+
+        int SNPrintf(char *dst, size_t dst_size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    }
+
+    namespace os {
+
+        using NativeHandle = u32;
+        using ThreadId = u64;
+
+        constexpr NativeHandle InvalidNativeHandle = 0;
+        constexpr size_t MemoryPageSize = 0x1000;
+        constexpr size_t ThreadStackAlignment = 0x1000;
+
+        enum MemoryPermission {
+            MemoryPermission_None      = 0,
+            MemoryPermission_ReadOnly  = 1,
+            MemoryPermission_ReadWrite = 3,
+        };
+
+        enum EventClearMode {
+            EventClearMode_ManualClear,
+            EventClearMode_AutoClear,
+        };
+
+        class Tick {
+            public:
+                constexpr explicit Tick(s64 tick = 0) : m_tick(tick) { }
+
+                constexpr s64 GetInt64Value(void) const { return m_tick; }
+
+                friend constexpr auto operator<=>(const Tick &lhs, const Tick &rhs) = default;
+                friend constexpr Tick operator+(const Tick &lhs, const Tick &rhs) { return Tick(lhs.m_tick + rhs.m_tick); }
+                friend constexpr Tick operator-(const Tick &lhs, const Tick &rhs) { return Tick(lhs.m_tick - rhs.m_tick); }
+                constexpr Tick &operator+=(const Tick &rhs) { m_tick += rhs.m_tick; return *this; }
+                constexpr Tick &operator-=(const Tick &rhs) { m_tick -= rhs.m_tick; return *this; }
+
+            private:
+                s64 m_tick;
+        };
+
+        // Ticks run at the console's 19.2MHz, so that tick arithmetic behaves as it does on hardware
+        s64 GetSystemTickFrequency(void);
+        Tick GetSystemTick(void);
+        Tick ConvertToTick(TimeSpan time_span);
+        TimeSpan ConvertToTimeSpan(Tick tick);
+
+        class SdkMutex {
+            public:
+                constexpr SdkMutex(void) : m_mutex() { }
+
+                void Lock(void)    { m_mutex.lock(); }
+                bool TryLock(void) { return m_mutex.try_lock(); }
+                void Unlock(void)  { m_mutex.unlock(); }
+
+                void lock(void)     { this->Lock(); }
+                bool try_lock(void) { return this->TryLock(); }
+                void unlock(void)   { this->Unlock(); }
+
+            private:
+                std::mutex m_mutex;
+        };
+
+        class Mutex {
+            public:
+                explicit Mutex(bool recursive) : m_mutex() { AMS_UNUSED(recursive); }
+
+                void Lock(void)    { m_mutex.lock(); }
+                bool TryLock(void) { return m_mutex.try_lock(); }
+                void Unlock(void)  { m_mutex.unlock(); }
+
+                void lock(void)     { this->Lock(); }
+                bool try_lock(void) { return this->TryLock(); }
+                void unlock(void)   { this->Unlock(); }
+
+            private:
+                std::recursive_mutex m_mutex;
+        };
+
+        // Plain process memory, as nothing on the host shares it
+        class SharedMemory {
+            public:
+                SharedMemory(size_t size, MemoryPermission my_perm, MemoryPermission other_perm) : m_size(size), m_address(nullptr), m_handle(RegisterSharedMemory(this)) { AMS_UNUSED(my_perm, other_perm); }
+                ~SharedMemory() { UnregisterSharedMemory(m_handle); this->Unmap(); }
+
+                SharedMemory(const SharedMemory &) = delete;
+                SharedMemory &operator=(const SharedMemory &) = delete;
+
+                void *Map(MemoryPermission perm) {
+                    AMS_UNUSED(perm);
+                    if (m_address == nullptr)
+                        m_address = std::aligned_alloc(MemoryPageSize, util::AlignUp(m_size, MemoryPageSize));
+                    return m_address;
+                }
+
+                void Unmap(void) {
+                    std::free(m_address);
+                    m_address = nullptr;
+                }
+
+                void *GetMappedAddress(void) const { return m_address; }
+                size_t GetSize(void) const { return m_size; }
+                NativeHandle GetHandle(void) const { return m_handle; }
+
+            private:
+                // Handles can be looked up by the tests, standing in for a client mapping the memory
+                static NativeHandle RegisterSharedMemory(SharedMemory *shmem);
+                static void UnregisterSharedMemory(NativeHandle handle);
+
+                size_t m_size;
+                void *m_address;
+                NativeHandle m_handle;
+        };
+
+        // Only named by the headers of the sources built for the host
+        class SystemEvent;
+
+    }
+
+    namespace fs {
+
+        struct FileHandle {
+            void *handle;
+        };
+
+        enum OpenMode {
+            OpenMode_Read        = (1 << 0),
+            OpenMode_Write       = (1 << 1),
+            OpenMode_AllowAppend = (1 << 2),
+
+            OpenMode_ReadWrite   = (OpenMode_Read | OpenMode_Write),
+            OpenMode_All         = (OpenMode_ReadWrite | OpenMode_AllowAppend),
+        };
+
+        struct WriteOption {
+            int value;
+
+            static const WriteOption None;
+            static const WriteOption Flush;
+        };
+
+        inline const WriteOption WriteOption::None  = { 0 };
+        inline const WriteOption WriteOption::Flush = { 1 };
+
+        // Backed by an in-memory filesystem on the host
+        Result OpenFile(FileHandle *out, const char *path, int mode);
+        void CloseFile(FileHandle handle);
+        Result ReadFile(FileHandle handle, s64 offset, void *buffer, size_t size);
+        Result ReadFile(size_t *out, FileHandle handle, s64 offset, void *buffer, size_t size);
+        Result WriteFile(FileHandle handle, s64 offset, const void *buffer, size_t size, const WriteOption &option);
+        Result FlushFile(FileHandle handle);
+        Result GetFileSize(s64 *out, FileHandle handle);
+        Result CreateFile(const char *path, s64 size);
+        Result DeleteFile(const char *path);
+        Result HasFile(bool *out, const char *path);
+        Result EnsureDirectoryRecursively(const char *path);
+
+    }
+
+    namespace util::ini {
+
+        using Handler = int (*)(void *user_ctx, const char *section, const char *name, const char *value);
+
+        int ParseFile(fs::FileHandle file, void *user_ctx, Handler h);
+
+    }
+
+    namespace lmem {
+
+        struct HeapHead;
+        using HeapHandle = HeapHead *;
+
+        enum CreateOption {
+            CreateOption_None       = (0 << 0),
+            CreateOption_ZeroClear  = (1 << 0),
+            CreateOption_DebugFill  = (1 << 1),
+            CreateOption_ThreadSafe = (1 << 2),
+        };
+
+        HeapHandle CreateExpHeap(void *address, size_t size, u32 option);
+        void DestroyExpHeap(HeapHandle handle);
+        void *AllocateFromExpHeap(HeapHandle handle, size_t size);
+        void *AllocateFromExpHeap(HeapHandle handle, size_t size, s32 alignment);
+        void FreeToExpHeap(HeapHandle handle, void *block);
+        size_t GetExpHeapMemoryBlockSize(const void *memory_block);
+        size_t GetExpHeapTotalFreeSize(HeapHandle handle);
+        size_t GetExpHeapAllocatableSize(HeapHandle handle, s32 alignment);
+
+    }
+
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// Host stand-in for the parts of libnx used by the sources built into the tests.
+// Layouts match libnx wherever the code depends on them. Structures are trimmed to the fields the code uses.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+typedef u32 Handle;
+
+typedef struct {
+    u32 session;
+} Service;
+
+typedef struct {
+    u8 address[0x6];
+} BtdrvAddress;
+
+typedef struct {
+    u8 class_of_device[0x3];
+} BtdrvClassOfDevice;
+
+typedef struct {
+    char code[0x10];
+} BtdrvBluetoothPinCode;
+
+typedef struct {
+    u32 type;
+    u32 size;
+    u8 data[0x100];
+} BtdrvAdapterProperty;
+
+typedef struct {
+    u16 size;
+    u8 data[0x280];
+} BtdrvHidReport;
+
+typedef u32 BtdrvBluetoothHhReportType;
+
+typedef struct {
+    BtdrvAddress addr;
+    u16 vid;
+    u16 pid;
+    u16 descriptor_length;
+    u8 descriptor[0x80];
+} SetSysBluetoothDevicesSettings;
+
+typedef u32 BtdrvEventType;
+typedef u32 BtdrvHidEventType;
+typedef u32 BtdrvBleEventType;
+
+typedef struct { u8 data[0x400]; } BtdrvEventInfo;
+typedef struct { u8 data[0x480]; } BtdrvHidEventInfo;
+typedef struct { u8 data[0x400]; } BtdrvBleEventInfo;
+typedef struct { u8 data[0x480]; } BtdrvHidReportEventInfo;
+
+#ifdef __cplusplus
+namespace ams { class Result; }
+
+ams::Result btdrvGetPairedDeviceInfo(BtdrvAddress address, SetSysBluetoothDevicesSettings *settings);
+
+extern "C" {
+#endif
+
+u32 crc32Calculate(const void *src, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
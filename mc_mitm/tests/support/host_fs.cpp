@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "host_fs.hpp"
+#include <map>
+#include <set>
+#include <vector>
+
+// In-memory filesystem with the same failure behaviour as fs for the calls the sources make: opening missing files,
+// creating files that exist, reading past the end, and writing past the end without OpenMode_AllowAppend all fail.
+namespace ams::fs {
+
+    namespace {
+
+        struct OpenFileState {
+            std::string path;
+            int mode;
+        };
+
+        std::recursive_mutex g_fs_lock;
+        std::map<std::string, std::vector<u8>> g_files;
+        std::set<std::string> g_directories;
+
+        std::vector<u8> *GetFileData(FileHandle handle) {
+            auto state = reinterpret_cast<OpenFileState *>(handle.handle);
+            auto it = g_files.find(state->path);
+            return it != g_files.end() ? &it->second : nullptr;
+        }
+
+    }
+
+    Result OpenFile(FileHandle *out, const char *path, int mode) {
+        std::scoped_lock lk(g_fs_lock);
+
+        if (!g_files.contains(path))
+            return -1;
+
+        out->handle = new OpenFileState{path, mode};
+        return ResultSuccess();
+    }
+
+    void CloseFile(FileHandle handle) {
+        // Controllers close their spi flash file on destruction whether or not it was ever opened
+        delete reinterpret_cast<OpenFileState *>(handle.handle);
+    }
+
+    Result ReadFile(size_t *out, FileHandle handle, s64 offset, void *buffer, size_t size) {
+        std::scoped_lock lk(g_fs_lock);
+
+        auto data = GetFileData(handle);
+        if ((data == nullptr) || (offset < 0) || (static_cast<size_t>(offset) > data->size()))
+            return -1;
+
+        *out = std::min(size, data->size() - offset);
+        std::memcpy(buffer, data->data() + offset, *out);
+        return ResultSuccess();
+    }
+
+    Result ReadFile(FileHandle handle, s64 offset, void *buffer, size_t size) {
+        size_t read_size;
+        R_TRY(ReadFile(&read_size, handle, offset, buffer, size));
+        return read_size == size ? ResultSuccess() : Result(-1);
+    }
+
+    Result WriteFile(FileHandle handle, s64 offset, const void *buffer, size_t size, const WriteOption &option) {
+        AMS_UNUSED(option);
+        std::scoped_lock lk(g_fs_lock);
+
+        auto mode = reinterpret_cast<OpenFileState *>(handle.handle)->mode;
+        auto data = GetFileData(handle);
+        if ((data == nullptr) || !(mode & OpenMode_Write) || (offset < 0))
+            return -1;
+
+        if (offset + size > data->size()) {
+            if (!(mode & OpenMode_AllowAppend))
+                return -1;
+            data->resize(offset + size);
+        }
+
+        std::memcpy(data->data() + offset, buffer, size);
+        return ResultSuccess();
+    }
+
+    Result FlushFile(FileHandle handle) {
+        AMS_UNUSED(handle);
+        return ResultSuccess();
+    }
+
+    Result GetFileSize(s64 *out, FileHandle handle) {
+        std::scoped_lock lk(g_fs_lock);
+
+        auto data = GetFileData(handle);
+        if (data == nullptr)
+            return -1;
+
+        *out = data->size();
+        return ResultSuccess();
+    }
+
+    Result CreateFile(const char *path, s64 size) {
+        std::scoped_lock lk(g_fs_lock);
+
+        if (g_files.contains(path) || (size < 0))
+            return -1;
+
+        g_files.emplace(path, std::vector<u8>(size));
+        return ResultSuccess();
+    }
+
+    Result DeleteFile(const char *path) {
+        std::scoped_lock lk(g_fs_lock);
+        return g_files.erase(path) ? ResultSuccess() : Result(-1);
+    }
+
+    Result HasFile(bool *out, const char *path) {
+        std::scoped_lock lk(g_fs_lock);
+
+        *out = g_files.contains(path);
+        return ResultSuccess();
+    }
+
+    Result EnsureDirectoryRecursively(const char *path) {
+        std::scoped_lock lk(g_fs_lock);
+
+        g_directories.insert(path);
+        return ResultSuccess();
+    }
+
+}
+
+namespace ams::util::ini {
+
+    // Same rules as the inih parser behind libstratosphere's: [section] headers, name = value or name : value pairs,
+    // and ; or # comments. Returns 0, or the line number of the first line the handler rejected.
+    int ParseFile(fs::FileHandle file, void *user_ctx, Handler h) {
+        s64 size;
+        if (R_FAILED(fs::GetFileSize(&size, file)))
+            return -1;
+
+        std::string text(size, '\0');
+        if (R_FAILED(fs::ReadFile(file, 0, text.data(), text.size())))
+            return -1;
+
+        auto trim = [](std::string s) {
+            s.erase(0, s.find_first_not_of(" \t\r"));
+            s.erase(s.find_last_not_of(" \t\r") + 1);
+            return s;
+        };
+
+        std::string section;
+        int error = 0;
+        int line_number = 0;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos)
+                end = text.size();
+
+            std::string line = trim(text.substr(start, end - start));
+            start = end + 1;
+            line_number++;
+
+            if (line.empty() || (line[0] == ';') || (line[0] == '#'))
+                continue;
+
+            if (line[0] == '[') {
+                auto close = line.find(']');
+                if (close == std::string::npos) {
+                    error = error ? error : line_number;
+                    continue;
+                }
+                section = line.substr(1, close - 1);
+                continue;
+            }
+
+            auto separator = line.find_first_of("=:");
+            if (separator == std::string::npos) {
+                error = error ? error : line_number;
+                continue;
+            }
+
+            std::string name = trim(line.substr(0, separator));
+            std::string value = line.substr(separator + 1);
+            if (auto comment = value.find(" ;"); comment != std::string::npos)
+                value.erase(comment);
+            value = trim(value);
+
+            if (!h(user_ctx, section.c_str(), name.c_str(), value.c_str()))
+                error = error ? error : line_number;
+        }
+
+        return error;
+    }
+
+}
+
+namespace ams::test {
+
+    void ClearFileSystem(void) {
+        std::scoped_lock lk(fs::g_fs_lock);
+
+        fs::g_files.clear();
+        fs::g_directories.clear();
+    }
+
+    void WriteTestFile(const char *path, const void *data, size_t size) {
+        std::scoped_lock lk(fs::g_fs_lock);
+
+        auto bytes = static_cast<const u8 *>(data);
+        fs::g_files[path].assign(bytes, bytes + size);
+    }
+
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "host_lmem.hpp"
+#include <vector>
+
+// First fit exp heap in the style of lmem's. Every block carries a header in front of it, and free blocks are kept
+// in address order and merged with their neighbours when freed, so fragmentation behaves as it does on the console.
+namespace ams::lmem {
+
+    namespace {
+
+        constexpr size_t BlockAlignment = 8;
+
+        struct BlockHead {
+            HeapHead *heap;
+            size_t size;            // Usable size, not counting this header
+            BlockHead *next;        // Free blocks only
+            u64 reserved;
+        };
+
+        static_assert(sizeof(BlockHead) % BlockAlignment == 0);
+
+        // Left over space below this is given away with the block rather than split off
+        constexpr size_t MinimumSplitSize = sizeof(BlockHead) + BlockAlignment;
+
+        std::mutex g_heaps_lock;
+        std::vector<HeapHead *> g_heaps;
+
+        u8 *GetBlockStart(BlockHead *block) {
+            return reinterpret_cast<u8 *>(block + 1);
+        }
+
+        BlockHead *GetBlockHead(const void *p) {
+            return const_cast<BlockHead *>(reinterpret_cast<const BlockHead *>(p) - 1);
+        }
+
+    }
+
+    struct HeapHead {
+        std::recursive_mutex lock;
+        bool thread_safe;
+        uintptr_t start;
+        uintptr_t end;
+        BlockHead *free_list;
+        size_t used_block_count;
+    };
+
+    HeapHandle CreateExpHeap(void *address, size_t size, u32 option) {
+        auto start = util::AlignUp(reinterpret_cast<uintptr_t>(address), BlockAlignment);
+        auto end = util::AlignDown(reinterpret_cast<uintptr_t>(address) + size, BlockAlignment);
+        if (end < start + MinimumSplitSize)
+            return nullptr;
+
+        auto heap = new HeapHead;
+        heap->thread_safe = (option & CreateOption_ThreadSafe) != 0;
+        heap->start = start;
+        heap->end = end;
+        heap->used_block_count = 0;
+
+        heap->free_list = reinterpret_cast<BlockHead *>(start);
+        heap->free_list->heap = heap;
+        heap->free_list->size = end - start - sizeof(BlockHead);
+        heap->free_list->next = nullptr;
+
+        if (option & CreateOption_ZeroClear)
+            std::memset(GetBlockStart(heap->free_list), 0, heap->free_list->size);
+
+        std::scoped_lock lk(g_heaps_lock);
+        g_heaps.push_back(heap);
+        return heap;
+    }
+
+    void DestroyExpHeap(HeapHandle handle) {
+        {
+            std::scoped_lock lk(g_heaps_lock);
+            std::erase(g_heaps, handle);
+        }
+        delete handle;
+    }
+
+    void *AllocateFromExpHeap(HeapHandle handle, size_t size) {
+        return AllocateFromExpHeap(handle, size, BlockAlignment);
+    }
+
+    void *AllocateFromExpHeap(HeapHandle handle, size_t size, s32 alignment) {
+        // Blocks are only ever placed at the heap's own alignment
+        if (alignment > static_cast<s32>(BlockAlignment))
+            return nullptr;
+
+        std::unique_lock lk(handle->lock, std::defer_lock);
+        if (handle->thread_safe)
+            lk.lock();
+
+        size = util::AlignUp(std::max<size_t>(size, 1), BlockAlignment);
+
+        for (BlockHead **link = &handle->free_list; *link != nullptr; link = &(*link)->next) {
+            BlockHead *block = *link;
+            if (block->size < size)
+                continue;
+
+            if (block->size - size >= MinimumSplitSize) {
+                auto rest = reinterpret_cast<BlockHead *>(GetBlockStart(block) + size);
+                rest->heap = handle;
+                rest->size = block->size - size - sizeof(BlockHead);
+                rest->next = block->next;
+                block->size = size;
+                *link = rest;
+            } else {
+                *link = block->next;
+            }
+
+            block->next = nullptr;
+            handle->used_block_count++;
+            return GetBlockStart(block);
+        }
+
+        return nullptr;
+    }
+
+    void FreeToExpHeap(HeapHandle handle, void *block) {
+        std::unique_lock lk(handle->lock, std::defer_lock);
+        if (handle->thread_safe)
+            lk.lock();
+
+        BlockHead *freed = GetBlockHead(block);
+        AMS_ABORT_UNLESS(freed->heap == handle);
+
+        // Insert in address order, then merge with whichever neighbours it touches
+        BlockHead *prev = nullptr;
+        BlockHead *next = handle->free_list;
+        while ((next != nullptr) && (next < freed)) {
+            prev = next;
+            next = next->next;
+        }
+
+        freed->next = next;
+        if ((next != nullptr) && (GetBlockStart(freed) + freed->size == reinterpret_cast<u8 *>(next))) {
+            freed->size += sizeof(BlockHead) + next->size;
+            freed->next = next->next;
+        }
+
+        if (prev == nullptr) {
+            handle->free_list = freed;
+        } else if (GetBlockStart(prev) + prev->size == reinterpret_cast<u8 *>(freed)) {
+            prev->size += sizeof(BlockHead) + freed->size;
+            prev->next = freed->next;
+        } else {
+            prev->next = freed;
+        }
+
+        handle->used_block_count--;
+    }
+
+    size_t GetExpHeapMemoryBlockSize(const void *memory_block) {
+        return GetBlockHead(memory_block)->size;
+    }
+
+    size_t GetExpHeapTotalFreeSize(HeapHandle handle) {
+        std::scoped_lock lk(handle->lock);
+
+        size_t size = 0;
+        for (auto block = handle->free_list; block != nullptr; block = block->next)
+            size += block->size;
+        return size;
+    }
+
+    size_t GetExpHeapAllocatableSize(HeapHandle handle, s32 alignment) {
+        std::scoped_lock lk(handle->lock);
+
+        if (alignment > static_cast<s32>(BlockAlignment))
+            return 0;
+
+        size_t size = 0;
+        for (auto block = handle->free_list; block != nullptr; block = block->next)
+            size = std::max(size, block->size);
+        return size;
+    }
+
+}
+
+namespace ams::test {
+
+    lmem::HeapHandle FindExpHeap(const void *block) {
+        auto address = reinterpret_cast<uintptr_t>(block);
+
+        std::scoped_lock lk(lmem::g_heaps_lock);
+        for (auto heap : lmem::g_heaps) {
+            if ((address > heap->start) && (address < heap->end))
+                return heap;
+        }
+        return nullptr;
+    }
+
+    void GetExpHeapState(lmem::HeapHandle handle, ExpHeapState *out) {
+        std::scoped_lock lk(handle->lock);
+
+        *out = {
+            .size = handle->end - handle->start,
+            .free_size = 0,
+            .largest_free_block = 0,
+            .free_block_count = 0,
+            .used_block_count = handle->used_block_count,
+        };
+
+        for (auto block = handle->free_list; block != nullptr; block = block->next) {
+            out->free_size += block->size;
+            out->largest_free_block = std::max(out->largest_free_block, block->size);
+            out->free_block_count++;
+        }
+    }
+
+}
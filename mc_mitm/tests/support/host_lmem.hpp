@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stratosphere.hpp>
+
+// Inspection of the host exp heaps, which libstratosphere doesn't offer but the heap tests need to see fragmentation
+namespace ams::test {
+
+    struct ExpHeapState {
+        size_t size;
+        size_t free_size;
+        size_t largest_free_block;
+        size_t free_block_count;
+        size_t used_block_count;
+    };
+
+    // Heap a block was allocated from, or nullptr if it isn't from any live exp heap
+    lmem::HeapHandle FindExpHeap(const void *block);
+
+    void GetExpHeapState(lmem::HeapHandle handle, ExpHeapState *out);
+
+}
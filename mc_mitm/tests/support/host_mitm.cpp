@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "host_mitm.hpp"
+#include "mcmitm_io.hpp"
+#include "mcmitm_trace.hpp"
+#include "bluetooth_mitm/bluetooth/bluetooth_hid_report.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace ams::mitm {
+
+    namespace {
+
+        constinit MissionControlConfig g_global_config = {
+            .general = {
+                .enable_rumble = true,
+                .enable_motion = true,
+            },
+        };
+
+    }
+
+    MissionControlConfig *GetGlobalConfig(void) {
+        return &g_global_config;
+    }
+
+}
+
+// Requests run straight away on the calling thread, on a copy of their data as the I/O thread would have
+namespace ams::mitm::io {
+
+    bool Submit(IoFunction function, IoCallback callback, const void *data, size_t size) {
+        AMS_ABORT_UNLESS(size <= IoRequestDataSize);
+
+        alignas(std::max_align_t) u8 request_data[IoRequestDataSize];
+        std::memcpy(request_data, data, size);
+
+        Result result = function(request_data);
+        if (callback != nullptr)
+            callback(result, request_data);
+
+        return true;
+    }
+
+    Result Execute(IoFunction function, void *data) {
+        return function(data);
+    }
+
+}
+
+namespace ams::mitm::trace {
+
+    void Record(TraceEvent event, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+        AMS_UNUSED(event, arg0, arg1, arg2);
+    }
+
+    void RecordAddress(TraceEvent event, const uint8_t address[6], uint32_t arg) {
+        AMS_UNUSED(event, address, arg);
+    }
+
+}
+
+namespace ams::bluetooth::hid::report {
+
+    namespace {
+
+        constinit test::HidReportCapture g_capture;
+
+    }
+
+    Result WriteHidReportBuffer(const bluetooth::Address *address, const bluetooth::HidReport *report) {
+        AMS_UNUSED(address);
+
+        g_capture.input_count++;
+        g_capture.last_input.size = std::min<u16>(report->size, sizeof(report->data));
+        std::memcpy(g_capture.last_input.data, report->data, g_capture.last_input.size);
+        return ResultSuccess();
+    }
+
+    Result SendHidReport(const bluetooth::Address *address, const bluetooth::HidReport *report) {
+        AMS_UNUSED(address);
+
+        g_capture.output_count++;
+        g_capture.last_output.size = std::min<u16>(report->size, sizeof(report->data));
+        std::memcpy(g_capture.last_output.data, report->data, g_capture.last_output.size);
+        return ResultSuccess();
+    }
+
+}
+
+namespace {
+
+    std::vector<SetSysBluetoothDevicesSettings> g_paired_devices;
+
+}
+
+ams::Result btdrvGetPairedDeviceInfo(BtdrvAddress address, SetSysBluetoothDevicesSettings *settings) {
+    for (auto &device : g_paired_devices) {
+        if (std::memcmp(&device.addr, &address, sizeof(address)) == 0) {
+            *settings = device;
+            return ams::ResultSuccess();
+        }
+    }
+
+    return -1;
+}
+
+// CRC-32 as used by zlib and libnx
+u32 crc32Calculate(const void *src, size_t size) {
+    auto data = static_cast<const u8 *>(src);
+    u32 crc = 0xffffffff;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+namespace ams::test {
+
+    const HidReportCapture *GetHidReports(void) {
+        return &bluetooth::hid::report::g_capture;
+    }
+
+    void ClearHidReports(void) {
+        bluetooth::hid::report::g_capture = {};
+    }
+
+    void SetPairedDevice(const SetSysBluetoothDevicesSettings *device) {
+        for (auto &paired : g_paired_devices) {
+            if (std::memcmp(&paired.addr, &device->addr, sizeof(device->addr)) == 0) {
+                paired = *device;
+                return;
+            }
+        }
+
+        g_paired_devices.push_back(*device);
+    }
+
+    void ClearPairedDevices(void) {
+        g_paired_devices.clear();
+    }
+
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stratosphere.hpp>
+#include "mcmitm_config.hpp"
+
+// Control over the host stand-ins for the rest of mc.mitm that the controllers talk to
+namespace ams::test {
+
+    // Reports passed to the console, and sent to the device, since the last call to ClearHidReports
+    struct HidReportCapture {
+        unsigned int input_count;
+        unsigned int output_count;
+        bluetooth::HidReport last_input;
+        bluetooth::HidReport last_output;
+    };
+
+    const HidReportCapture *GetHidReports(void);
+    void ClearHidReports(void);
+
+    // Entry returned by btdrvGetPairedDeviceInfo for the device's address
+    void SetPairedDevice(const SetSysBluetoothDevicesSettings *device);
+    void ClearPairedDevices(void);
+
+}
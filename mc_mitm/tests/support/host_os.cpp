@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "host_os.hpp"
+#include <chrono>
+#include <map>
+
+namespace ams::os {
+
+    namespace {
+
+        constexpr s64 TickFrequency = 19'200'000;
+
+        std::mutex g_shared_memory_lock;
+        std::map<NativeHandle, SharedMemory *> g_shared_memory;
+        NativeHandle g_next_shared_memory_handle = 1;
+
+    }
+
+    s64 GetSystemTickFrequency(void) {
+        return TickFrequency;
+    }
+
+    Tick GetSystemTick(void) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        return ConvertToTick(TimeSpan::FromNanoSeconds(ns));
+    }
+
+    Tick ConvertToTick(TimeSpan time_span) {
+        // 19.2MHz is 12 ticks every 625ns
+        return Tick((static_cast<__int128>(time_span.GetNanoSeconds()) * 12) / 625);
+    }
+
+    TimeSpan ConvertToTimeSpan(Tick tick) {
+        return TimeSpan::FromNanoSeconds((static_cast<__int128>(tick.GetInt64Value()) * 625) / 12);
+    }
+
+    NativeHandle SharedMemory::RegisterSharedMemory(SharedMemory *shmem) {
+        std::scoped_lock lk(g_shared_memory_lock);
+
+        NativeHandle handle = g_next_shared_memory_handle++;
+        g_shared_memory[handle] = shmem;
+        return handle;
+    }
+
+    void SharedMemory::UnregisterSharedMemory(NativeHandle handle) {
+        std::scoped_lock lk(g_shared_memory_lock);
+        g_shared_memory.erase(handle);
+    }
+
+}
+
+namespace ams::util {
+
+    int SNPrintf(char *dst, size_t dst_size, const char *fmt, ...) {
+        std::va_list args;
+        va_start(args, fmt);
+        int length = std::vsnprintf(dst, dst_size, fmt, args);
+        va_end(args);
+        return length;
+    }
+
+}
+
+namespace ams::test {
+
+    void *GetMappedSharedMemory(os::NativeHandle handle) {
+        std::scoped_lock lk(os::g_shared_memory_lock);
+
+        auto it = os::g_shared_memory.find(handle);
+        return it != os::g_shared_memory.end() ? it->second->GetMappedAddress() : nullptr;
+    }
+
+}
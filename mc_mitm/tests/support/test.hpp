@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2020-2021 ndeadly
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <chrono>
+#include <cstdio>
+
+// Minimal checks for the host tests. A failed check is reported and counted, and the test carries on so that every failure shows up in one run.
+namespace ams::test {
+
+    inline unsigned int g_failure_count;
+
+    inline bool Check(bool condition, const char *expression, const char *file, int line) {
+        if (!condition) {
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+            ++g_failure_count;
+        }
+        return condition;
+    }
+
+    // Exit status for main
+    inline int Finish(const char *name) {
+        if (g_failure_count > 0) {
+            std::fprintf(stderr, "%s: %u check(s) failed\n", name, g_failure_count);
+            return 1;
+        }
+
+        std::printf("%s: passed\n", name);
+        return 0;
+    }
+
+    inline double NanoSecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Timing budgets only mean something for optimised builds without sanitizers
+    #if defined(__SANITIZE_ADDRESS__) || !defined(__OPTIMIZE__)
+    constexpr bool EnforceTimingBudgets = false;
+    #else
+    constexpr bool EnforceTimingBudgets = true;
+    #endif
+
+}
+
+#define TEST_CHECK(expr) ::ams::test::Check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020-2021 ndeadly
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms and conditions of the GNU General Public License,
+# version 2, as published by the Free Software Foundation.
+#
+# This program is distributed in the hope it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Decodes a trace dump written by mc.mitm to sdmc:/config/MissionControl/trace.bin
+
+import struct
+import sys
+
+TRACE_FILE_MAGIC = 0x5254434d
+TRACE_FILE_VERSION = 1
+
+HEADER_FORMAT = '<IHHIIQQ'
+RECORD_FORMAT = '<IHHQI3I'
+
+def format_address(args):
+    return '{:06x}{:06x}'.format(args[0], args[1])
+
+def format_address_arg(name):
+    return lambda args: '{} {}=0x{:02x}'.format(format_address(args), name, args[2])
+
+EVENTS = {
+    1: ('HidConnectionOpened', format_address),
+    2: ('HidConnectionClosed', format_address),
+    3: ('SubCmd',              format_address_arg('id')),
+    4: ('EventQueueOverflow',  lambda args: 'type={} capacity={}'.format(args[0], args[1])),
+    5: ('IoQueueOverflow',     lambda args: 'capacity={}'.format(args[0])),
+    6: ('ReportReadTimeout',   lambda args: 'timeout={}ms'.format(args[0])),
+    7: ('WiiCommandTimeout',   format_address_arg('report')),
+    8: ('Abort',               lambda args: 'result=0x{:x}'.format(args[0])),
+}
+
+def main():
+    if len(sys.argv) != 2:
+        print('usage: {} trace.bin'.format(sys.argv[0]))
+        return 1
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    header_size = struct.calcsize(HEADER_FORMAT)
+    magic, version, record_size, record_count, _, tick_frequency, dump_tick = struct.unpack_from(HEADER_FORMAT, data)
+    if magic != TRACE_FILE_MAGIC or version != TRACE_FILE_VERSION:
+        print('not a version {} trace dump'.format(TRACE_FILE_VERSION))
+        return 1
+
+    # Times are printed relative to when the dump was taken
+    for i in range(record_count):
+        sequence, event, _, tick, thread_id, *args = struct.unpack_from(RECORD_FORMAT, data, header_size + i * record_size)
+        name, format_args = EVENTS.get(event, ('Unknown({})'.format(event), lambda args: ' '.join(hex(a) for a in args)))
+        time_ms = (tick - dump_tick) * 1000.0 / tick_frequency
+        print('{:>8} {:>12.3f}ms thread={:<4} {:<20} {}'.format(sequence, time_ms, thread_id, name, format_args(args)))
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())